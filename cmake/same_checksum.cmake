@@ -0,0 +1,29 @@
+# runs the headless benchmark once per --threads value and fails unless every run ends on the
+# same heightfield checksum
+#   cmake -DHEADLESS=path -DARGS="--flag ..." -DTHREADS=1,2 -P same_checksum.cmake
+separate_arguments(run_args UNIX_COMMAND "${ARGS}")
+string(REPLACE "," ";" thread_counts "${THREADS}")
+
+set(expected "")
+foreach(threads IN LISTS thread_counts)
+    execute_process(
+        COMMAND ${HEADLESS} ${run_args} --threads=${threads}
+        OUTPUT_VARIABLE output
+        RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "--threads=${threads} run failed (${result}):\n${output}")
+    endif()
+    string(REGEX MATCH "Heightfield checksum: ([0-9a-f]+)" matched "${output}")
+    if(NOT matched)
+        message(FATAL_ERROR "--threads=${threads} run printed no checksum:\n${output}")
+    endif()
+    set(checksum "${CMAKE_MATCH_1}")
+    message(STATUS "--threads=${threads}: ${checksum}")
+    if(expected STREQUAL "")
+        set(expected "${checksum}")
+        set(expected_threads "${threads}")
+    elseif(NOT checksum STREQUAL expected)
+        message(FATAL_ERROR "--threads=${threads} ended on ${checksum}, "
+                            "--threads=${expected_threads} on ${expected}")
+    endif()
+endforeach()
@@ -0,0 +1,15 @@
+#version 330 core
+// bucket cube, drawn once for the whole fleet with glDrawElementsInstanced
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+// per instance: where this bucket sits
+layout(location = 2) in vec3 aOffset;
+out vec3 Normal;
+
+uniform mat4 viewProjection;
+uniform float scale;
+
+void main() {
+    gl_Position = viewProjection * vec4(aPos * scale + aOffset, 1.0);
+    Normal = aNormal;
+}
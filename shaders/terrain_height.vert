@@ -0,0 +1,28 @@
+#version 330 core
+// terrain vertices for --vertex-format=height: only the heights are uploaded,
+// position comes from the vertex index and the normal from the neighbouring heights
+out vec3 Normal;
+
+uniform samplerBuffer heights;
+uniform int gridSize;
+uniform int heightBase;
+uniform float spacing;
+uniform mat4 mvp;
+
+// edges reuse the cell's own height, same as Terrain::normalComputation
+float heightAt(int r, int c) {
+    r = clamp(r, 0, gridSize - 1);
+    c = clamp(c, 0, gridSize - 1);
+    return texelFetch(heights, heightBase + r * gridSize + c).r;
+}
+
+void main() {
+    int r = gl_VertexID / gridSize;
+    int c = gl_VertexID - r * gridSize;
+
+    vec3 tangentX = vec3(2.0 * spacing, heightAt(r + 1, c) - heightAt(r - 1, c), 0.0);
+    vec3 tangentZ = vec3(0.0, heightAt(r, c + 1) - heightAt(r, c - 1), 2.0 * spacing);
+    Normal = normalize(cross(tangentZ, tangentX));
+
+    gl_Position = mvp * vec4(float(r) * spacing, heightAt(r, c), float(c) * spacing, 1.0);
+}
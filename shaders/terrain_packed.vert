@@ -0,0 +1,29 @@
+#version 330 core
+// terrain vertices for --vertex-format=packed: a half-float height and an octahedral
+// normal in two signed bytes, position x/z comes from the vertex index
+layout(location = 0) in float aHeight;
+layout(location = 1) in ivec2 aNormal;
+out vec3 Normal;
+
+uniform int gridSize;
+uniform int vertexBase;
+uniform float spacing;
+uniform mat4 mvp;
+
+// inverse of packOctahedral in src/simulation/vertex_packing.h, y is the folded axis
+vec3 decodeOctahedral(vec2 p) {
+    vec3 n = vec3(p.x, 1.0 - abs(p.x) - abs(p.y), p.y);
+    if (n.y < 0.0) {
+        n.xz = (1.0 - abs(n.zx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.z >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(n);
+}
+
+void main() {
+    int vertex = gl_VertexID - vertexBase;
+    int r = vertex / gridSize;
+    int c = vertex - r * gridSize;
+
+    Normal = decodeOctahedral(vec2(aNormal) / 127.0);
+    gl_Position = mvp * vec4(float(r) * spacing, aHeight, float(c) * spacing, 1.0);
+}
@@ -0,0 +1,62 @@
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "benchmark/bench_compare.h"
+#include "options.h"
+
+// runs the headless benchmark several times and checks the numbers against a baseline, so a
+// change that makes things slower fails instead of hiding in run-to-run noise
+int main(int argc, char **argv) {
+  BenchCompareOptions options;
+  const ParseResult parseResult = parseBenchCompareArguments(argc, argv, options);
+  if (parseResult == ParseResult::ExitSuccess) {
+    return EXIT_SUCCESS;
+  }
+  if (parseResult == ParseResult::ExitFailure) {
+    return EXIT_FAILURE;
+  }
+
+  BenchmarkTable baseline;
+  if (!options.baselinePath.empty() && !readBenchmarkTable(options.baselinePath, baseline)) {
+    return EXIT_FAILURE;
+  }
+
+  BenchmarkTable candidate;
+  if (!options.candidatePath.empty()) {
+    if (!readBenchmarkTable(options.candidatePath, candidate)) {
+      return EXIT_FAILURE;
+    }
+  } else {
+    if (options.cpu && !pinToCpu(*options.cpu)) {
+      return EXIT_FAILURE;
+    }
+    if (!runHeadlessBenchmarks(options, argv[0], candidate)) {
+      return EXIT_FAILURE;
+    }
+  }
+  if (!options.saveBaselinePath.empty()) {
+    if (!writeBenchmarkTable(options.saveBaselinePath, candidate)) {
+      return EXIT_FAILURE;
+    }
+    std::cout << "Saved " << candidate.rows.size() << " runs as a baseline to "
+              << options.saveBaselinePath << '\n';
+  }
+
+  if (options.baselinePath.empty()) {
+    printRunSummary(candidate, options);
+    return EXIT_SUCCESS;
+  }
+  std::vector<MetricComparison> comparisons;
+  if (!compareBenchmarkTables(baseline, candidate, options, comparisons)) {
+    return EXIT_FAILURE;
+  }
+  printComparisons(options, comparisons);
+  for (const MetricComparison &comparison : comparisons) {
+    if (comparison.regression) {
+      std::cerr << "Performance regression in " << comparison.metric << "\n";
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
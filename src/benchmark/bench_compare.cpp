@@ -0,0 +1,467 @@
+#include "bench_compare.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define EXCAVATION_SPAWN 1
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char **environ;
+#endif
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace {
+// runs compared against each other should have been set up the same way
+const char *const CONFIG_COLUMNS[] = {
+    "frames",        "grid_size",     "spacing",        "settle_mode",   "settle_threads",
+    "settle_kernel", "vertex_format", "buckets",        "brush",         "brush_size",
+    "scenario",      "seed",          "terrain_source", "render_target", "render_width",
+    "render_height"};
+
+struct SampleStats {
+  std::size_t count = 0;
+  double mean = 0.0;
+  // sample variance, n - 1 in the denominator
+  double variance = 0.0;
+};
+
+SampleStats describe(const std::vector<double> &samples) {
+  SampleStats stats;
+  stats.count = samples.size();
+  if (samples.empty()) {
+    return stats;
+  }
+  double sum = 0.0;
+  for (double sample : samples) {
+    sum += sample;
+  }
+  stats.mean = sum / static_cast<double>(samples.size());
+  if (samples.size() > 1) {
+    double squares = 0.0;
+    for (double sample : samples) {
+      squares += (sample - stats.mean) * (sample - stats.mean);
+    }
+    stats.variance = squares / static_cast<double>(samples.size() - 1);
+  }
+  return stats;
+}
+
+// continued fraction of the incomplete beta function, by the modified Lentz method
+double betaContinuedFraction(double a, double b, double x) {
+  constexpr int MAX_ITERATIONS = 300;
+  constexpr double EPSILON = 1.0e-14;
+  constexpr double TINY = 1.0e-300;
+  double c = 1.0;
+  double d = 1.0 - (a + b) * x / (a + 1.0);
+  d = std::abs(d) < TINY ? TINY : d;
+  d = 1.0 / d;
+  double fraction = d;
+  for (int m = 1; m <= MAX_ITERATIONS; ++m) {
+    const double step = static_cast<double>(m);
+    // even step
+    double numerator = step * (b - step) * x / ((a + 2.0 * step - 1.0) * (a + 2.0 * step));
+    d = 1.0 + numerator * d;
+    d = std::abs(d) < TINY ? TINY : d;
+    c = 1.0 + numerator / c;
+    c = std::abs(c) < TINY ? TINY : c;
+    d = 1.0 / d;
+    fraction *= d * c;
+    // odd step
+    numerator = -(a + step) * (a + b + step) * x / ((a + 2.0 * step) * (a + 2.0 * step + 1.0));
+    d = 1.0 + numerator * d;
+    d = std::abs(d) < TINY ? TINY : d;
+    c = 1.0 + numerator / c;
+    c = std::abs(c) < TINY ? TINY : c;
+    d = 1.0 / d;
+    const double delta = d * c;
+    fraction *= delta;
+    if (std::abs(delta - 1.0) < EPSILON) {
+      break;
+    }
+  }
+  return fraction;
+}
+
+// regularized incomplete beta function I_x(a, b)
+double incompleteBeta(double a, double b, double x) {
+  if (x <= 0.0) {
+    return 0.0;
+  }
+  if (x >= 1.0) {
+    return 1.0;
+  }
+  const double front = std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) +
+                                a * std::log(x) + b * std::log(1.0 - x));
+  // the fraction converges fastest on this side of the mean
+  if (x < (a + 1.0) / (a + b + 2.0)) {
+    return front * betaContinuedFraction(a, b, x) / a;
+  }
+  return 1.0 - front * betaContinuedFraction(b, a, 1.0 - x) / b;
+}
+
+// chance of a Student t with df degrees of freedom landing further from 0 than t
+double twoSidedP(double t, double df) { return incompleteBeta(df / 2.0, 0.5, df / (df + t * t)); }
+
+// the t with twoSidedP(t, df) == alpha
+double criticalT(double df, double alpha) {
+  double low = 0.0;
+  double high = 1.0;
+  while (twoSidedP(high, df) > alpha) {
+    high *= 2.0;
+  }
+  for (int i = 0; i < 100; ++i) {
+    const double middle = 0.5 * (low + high);
+    (twoSidedP(middle, df) > alpha ? low : high) = middle;
+  }
+  return 0.5 * (low + high);
+}
+
+bool higherIsBetter(const std::string &metric) { return metric == "avg_fps"; }
+
+double percentOf(double value, double reference) {
+  if (reference == 0.0) {
+    return value == 0.0 ? 0.0 : std::copysign(std::numeric_limits<double>::infinity(), value);
+  }
+  return 100.0 * value / std::abs(reference);
+}
+
+std::vector<std::string> splitCsvLine(const std::string &line) {
+  std::vector<std::string> fields;
+  std::size_t begin = 0;
+  while (true) {
+    const std::size_t comma = line.find(',', begin);
+    fields.push_back(line.substr(begin, comma - begin));
+    if (comma == std::string::npos) {
+      return fields;
+    }
+    begin = comma + 1;
+  }
+}
+
+std::string columnValue(const BenchmarkTable &table, const std::string &name) {
+  const auto found = std::find(table.header.begin(), table.header.end(), name);
+  if (found == table.header.end() || table.rows.empty()) {
+    return std::string();
+  }
+  return table.rows.front()[static_cast<std::size_t>(found - table.header.begin())];
+}
+
+// the columns where the two sets of runs weren't set up alike, so the numbers may differ for
+// reasons other than the change being measured
+void warnAboutMismatches(const BenchmarkTable &baseline, const BenchmarkTable &candidate) {
+  for (const char *name : CONFIG_COLUMNS) {
+    const std::string before = columnValue(baseline, name);
+    const std::string after = columnValue(candidate, name);
+    if (before != after) {
+      std::cerr << "Warning: baseline and candidate runs differ in " << name << " (" << before
+                << " against " << after << ")\n";
+    }
+  }
+  const std::string before = columnValue(baseline, "height_checksum");
+  const std::string after = columnValue(candidate, "height_checksum");
+  if (!before.empty() && !after.empty() && before != after) {
+    std::cerr << "Warning: the final heightfield checksum changed (" << before << " against "
+              << after << "), the simulation no longer gives the same terrain\n";
+  }
+}
+
+void printPercent(std::ostream &output, double percent) {
+  output << std::showpos << std::setprecision(1) << percent << std::noshowpos << "%";
+}
+} // namespace
+
+std::optional<std::vector<double>> BenchmarkTable::column(const std::string &name) const {
+  const auto found = std::find(header.begin(), header.end(), name);
+  if (found == header.end()) {
+    return std::nullopt;
+  }
+  const std::size_t index = static_cast<std::size_t>(found - header.begin());
+  std::vector<double> values;
+  values.reserve(rows.size());
+  for (const std::vector<std::string> &row : rows) {
+    const std::string &field = row[index];
+    char *end = nullptr;
+    const double value = std::strtod(field.c_str(), &end);
+    if (field.empty() || *end != '\0' || !std::isfinite(value)) {
+      return std::nullopt;
+    }
+    values.push_back(value);
+  }
+  return values;
+}
+
+bool readBenchmarkTable(const std::string &path, BenchmarkTable &table) {
+  std::ifstream input(path);
+  if (!input.is_open()) {
+    std::cerr << "Failed to open benchmark CSV: " << path << "\n";
+    return false;
+  }
+  table = BenchmarkTable{};
+  std::string line;
+  if (!std::getline(input, line)) {
+    std::cerr << "Can't use " << path << ": it's empty\n";
+    return false;
+  }
+  table.header = splitCsvLine(line);
+  if (std::find(table.header.begin(), table.header.end(), "avg_frame_ms") == table.header.end()) {
+    std::cerr << "Can't use " << path << ": it isn't a --csv file from the benchmark\n";
+    return false;
+  }
+  std::size_t lineNumber = 1;
+  while (std::getline(input, line)) {
+    ++lineNumber;
+    if (line.empty()) {
+      continue;
+    }
+    std::vector<std::string> row = splitCsvLine(line);
+    // rows appended by a newer build carry extra columns at the end, which the header of an
+    // older file doesn't name
+    if (row.size() < table.header.size()) {
+      std::cerr << "Can't use " << path << ": line " << lineNumber << " has " << row.size()
+                << " values, the header names " << table.header.size() << "\n";
+      return false;
+    }
+    row.resize(table.header.size());
+    table.rows.push_back(std::move(row));
+  }
+  return true;
+}
+
+bool writeBenchmarkTable(const std::string &path, const BenchmarkTable &table) {
+  const std::filesystem::path csvPath(path);
+  if (!csvPath.parent_path().empty()) {
+    std::filesystem::create_directories(csvPath.parent_path());
+  }
+  std::ofstream output(csvPath);
+  if (!output.is_open()) {
+    std::cerr << "Failed to open CSV output: " << path << "\n";
+    return false;
+  }
+  const auto writeLine = [&](const std::vector<std::string> &fields) {
+    for (std::size_t i = 0; i < fields.size(); ++i) {
+      output << (i > 0 ? "," : "") << fields[i];
+    }
+    output << '\n';
+  };
+  writeLine(table.header);
+  for (const std::vector<std::string> &row : table.rows) {
+    writeLine(row);
+  }
+  return static_cast<bool>(output);
+}
+
+bool pinToCpu(std::size_t cpu) {
+#if defined(__linux__)
+  if (cpu >= CPU_SETSIZE) {
+    std::cerr << "Can't pin to CPU " << cpu << ": out of range\n";
+    return false;
+  }
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+    std::cerr << "Can't pin to CPU " << cpu << ": no such CPU, or not allowed to use it\n";
+    return false;
+  }
+  return true;
+#else
+  std::cerr << "--cpu is only supported on Linux\n";
+  (void)cpu;
+  return false;
+#endif
+}
+
+bool runHeadlessBenchmarks(const BenchCompareOptions &options, const std::string &programPath,
+                           BenchmarkTable &table) {
+#if EXCAVATION_SPAWN
+  const std::string headless =
+      !options.headlessPath.empty()
+          ? options.headlessPath
+          : (std::filesystem::path(programPath).parent_path() / "excavation-sim-headless").string();
+  const std::filesystem::path csvPath = std::filesystem::temp_directory_path() /
+                                        ("bench-compare-" + std::to_string(getpid()) + ".csv");
+  std::filesystem::remove(csvPath);
+
+  // every run appends its row, the last --csv on the command line being the one used
+  std::vector<std::string> arguments = {headless};
+  arguments.insert(arguments.end(), options.headlessArguments.begin(),
+                   options.headlessArguments.end());
+  arguments.push_back("--csv=" + csvPath.string());
+  std::vector<char *> argv;
+  for (std::string &argument : arguments) {
+    argv.push_back(argument.data());
+  }
+  argv.push_back(nullptr);
+
+  // the runs' own summaries would bury the comparison
+  posix_spawn_file_actions_t quiet;
+  posix_spawn_file_actions_init(&quiet);
+  posix_spawn_file_actions_addopen(&quiet, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+
+  const std::size_t total = options.warmup + options.runs;
+  bool succeeded = true;
+  for (std::size_t run = 0; run < total && succeeded; ++run) {
+    std::cout << "Run " << run + 1 << "/" << total << (run < options.warmup ? " (warmup)" : "")
+              << std::endl;
+    pid_t child = 0;
+    int status = 0;
+    if (posix_spawnp(&child, headless.c_str(), &quiet, nullptr, argv.data(), environ) != 0) {
+      std::cerr << "Failed to start " << headless << "\n";
+      succeeded = false;
+    } else if (waitpid(child, &status, 0) != child || !WIFEXITED(status) ||
+               WEXITSTATUS(status) != EXIT_SUCCESS) {
+      std::cerr << headless << " failed on run " << run + 1 << "\n";
+      succeeded = false;
+    }
+  }
+  posix_spawn_file_actions_destroy(&quiet);
+
+  succeeded = succeeded && readBenchmarkTable(csvPath.string(), table);
+  std::filesystem::remove(csvPath);
+  if (!succeeded) {
+    return false;
+  }
+  if (table.rows.size() != total) {
+    std::cerr << "Expected " << total << " rows from " << headless << ", got "
+              << table.rows.size() << "\n";
+    return false;
+  }
+  table.rows.erase(table.rows.begin(), table.rows.begin() + static_cast<long>(options.warmup));
+  return true;
+#else
+  (void)options;
+  (void)programPath;
+  (void)table;
+  std::cerr << "Running the benchmark needs a POSIX system, compare existing CSV files with "
+               "--candidate instead\n";
+  return false;
+#endif
+}
+
+bool compareBenchmarkTables(const BenchmarkTable &baseline, const BenchmarkTable &candidate,
+                            const BenchCompareOptions &options,
+                            std::vector<MetricComparison> &comparisons) {
+  if (baseline.rows.size() < 2 || candidate.rows.size() < 2) {
+    std::cerr << "Need at least two runs on each side to compare, the baseline has "
+              << baseline.rows.size() << " and the candidate " << candidate.rows.size() << "\n";
+    return false;
+  }
+  warnAboutMismatches(baseline, candidate);
+
+  const double alpha = 1.0 - static_cast<double>(options.confidence);
+  comparisons.clear();
+  for (const std::string &metric : options.metrics) {
+    const std::optional<std::vector<double>> before = baseline.column(metric);
+    const std::optional<std::vector<double>> after = candidate.column(metric);
+    if (!before || !after) {
+      std::cerr << "No numeric " << metric << " column in the "
+                << (before ? "candidate" : "baseline") << " runs\n";
+      return false;
+    }
+    const SampleStats a = describe(*before);
+    const SampleStats b = describe(*after);
+
+    // Welch's t-test, which doesn't assume both sides are equally noisy
+    const double aShare = a.variance / static_cast<double>(a.count);
+    const double bShare = b.variance / static_cast<double>(b.count);
+    const double standardError = std::sqrt(aShare + bShare);
+    const double difference = b.mean - a.mean;
+    MetricComparison comparison;
+    comparison.metric = metric;
+    comparison.baselineMean = a.mean;
+    comparison.candidateMean = b.mean;
+    double halfWidth = 0.0;
+    if (standardError > 0.0) {
+      const double degrees =
+          (aShare + bShare) * (aShare + bShare) /
+          (aShare * aShare / static_cast<double>(a.count - 1) +
+           bShare * bShare / static_cast<double>(b.count - 1));
+      comparison.pValue = twoSidedP(difference / standardError, degrees);
+      halfWidth = criticalT(degrees, alpha) * standardError;
+    } else {
+      // both sides gave the same number every run, so any difference is certain
+      comparison.pValue = difference == 0.0 ? 1.0 : 0.0;
+    }
+    comparison.changePercent = percentOf(difference, a.mean);
+    comparison.lowPercent = percentOf(difference - halfWidth, a.mean);
+    comparison.highPercent = percentOf(difference + halfWidth, a.mean);
+    comparison.significant = comparison.pValue < alpha;
+    const double worsePercent =
+        higherIsBetter(metric) ? -comparison.changePercent : comparison.changePercent;
+    comparison.regression =
+        comparison.significant && worsePercent >= static_cast<double>(options.thresholdPercent);
+    comparisons.push_back(comparison);
+  }
+  return true;
+}
+
+void printComparisons(const BenchCompareOptions &options,
+                      const std::vector<MetricComparison> &comparisons) {
+  const int confidencePercent = static_cast<int>(std::lround(options.confidence * 100.0f));
+  std::cout << "\nBaseline against candidate (" << confidencePercent
+            << "% confidence, regression threshold " << options.thresholdPercent << "%)\n";
+  std::cout << std::left << std::setw(20) << "metric" << std::right << std::setw(12)
+            << "baseline" << std::setw(12) << "candidate" << std::setw(10) << "change"
+            << std::setw(22) << (std::to_string(confidencePercent) + "% CI") << std::setw(10)
+            << "p" << "  verdict\n";
+  for (const MetricComparison &comparison : comparisons) {
+    std::ostringstream change;
+    change << std::fixed;
+    printPercent(change, comparison.changePercent);
+    std::ostringstream interval;
+    interval << std::fixed << "[";
+    printPercent(interval, comparison.lowPercent);
+    interval << ", ";
+    printPercent(interval, comparison.highPercent);
+    interval << "]";
+
+    const bool worse = higherIsBetter(comparison.metric) ? comparison.changePercent < 0.0
+                                                         : comparison.changePercent > 0.0;
+    const char *verdict = comparison.regression    ? "REGRESSION"
+                          : !comparison.significant ? "no significant change"
+                          : worse                   ? "slower, within threshold"
+                                                    : "improvement";
+    // five significant digits suit sub-millisecond frame times and thousands of fps alike
+    std::cout << std::left << std::setw(20) << comparison.metric << std::right
+              << std::defaultfloat << std::setprecision(5) << std::setw(12)
+              << comparison.baselineMean << std::setw(12) << comparison.candidateMean
+              << std::setw(10) << change.str() << std::setw(22) << interval.str() << std::fixed
+              << std::setprecision(4) << std::setw(10) << comparison.pValue << "  " << verdict
+              << '\n';
+  }
+}
+
+void printRunSummary(const BenchmarkTable &table, const BenchCompareOptions &options) {
+  const int confidencePercent = static_cast<int>(std::lround(options.confidence * 100.0f));
+  std::cout << "\n" << table.rows.size() << " runs, mean and " << confidencePercent
+            << "% confidence interval\n";
+  for (const std::string &metric : options.metrics) {
+    const std::optional<std::vector<double>> values = table.column(metric);
+    if (!values) {
+      std::cerr << "No numeric " << metric << " column in the runs\n";
+      continue;
+    }
+    const SampleStats stats = describe(*values);
+    const double halfWidth =
+        stats.count > 1 && stats.variance > 0.0
+            ? criticalT(static_cast<double>(stats.count - 1),
+                        1.0 - static_cast<double>(options.confidence)) *
+                  std::sqrt(stats.variance / static_cast<double>(stats.count))
+            : 0.0;
+    std::cout << std::left << std::setw(20) << metric << std::right << std::defaultfloat
+              << std::setprecision(5) << stats.mean << " +- " << halfWidth << " (" << std::fixed
+              << std::setprecision(1) << percentOf(halfWidth, stats.mean) << "%)\n";
+  }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+// bench-compare flags, see parseBenchCompareArguments
+struct BenchCompareOptions {
+  // measured runs of the headless benchmark, after warmup runs whose rows are thrown away
+  std::size_t runs = 10;
+  std::size_t warmup = 2;
+  // pins bench-compare, and so every run it starts, to this CPU
+  std::optional<std::size_t> cpu;
+  // empty looks for excavation-sim-headless next to bench-compare
+  std::string headlessPath;
+  // passed through to every run, everything after "--"
+  std::vector<std::string> headlessArguments;
+  // rows to compare instead of running anything, in writeBenchmarkCsv format
+  std::string candidatePath;
+  // rows to compare against, and where to keep this run's rows as a future baseline
+  std::string baselinePath;
+  std::string saveBaselinePath;
+  // CSV columns compared, avg_fps is the only one where higher is better
+  std::vector<std::string> metrics = {"avg_frame_ms", "p95_frame_ms", "avg_terrain_ms",
+                                      "p95_terrain_ms"};
+  // a change counts as a regression once it is significant and at least this much worse
+  float thresholdPercent = 5.0f;
+  // of the confidence intervals, and one minus it is the significance level of the test
+  float confidence = 0.95f;
+};
+
+// a writeBenchmarkCsv file, one row per run
+struct BenchmarkTable {
+  std::vector<std::string> header;
+  std::vector<std::vector<std::string>> rows;
+
+  // every row's value in that column, nothing if the column is missing or a value isn't a
+  // number
+  std::optional<std::vector<double>> column(const std::string &name) const;
+};
+
+// one metric, baseline against candidate, by Welch's t-test
+struct MetricComparison {
+  std::string metric;
+  double baselineMean = 0.0;
+  double candidateMean = 0.0;
+  // candidate against baseline, with the confidence interval of the difference in means, all
+  // in percent of the baseline mean
+  double changePercent = 0.0;
+  double lowPercent = 0.0;
+  double highPercent = 0.0;
+  // two-sided
+  double pValue = 1.0;
+  bool significant = false;
+  // significant, worse, and worse by more than the threshold
+  bool regression = false;
+};
+
+// prints why and returns false if the file can't be read or isn't a benchmark CSV
+bool readBenchmarkTable(const std::string &path, BenchmarkTable &table);
+// replaces the file
+bool writeBenchmarkTable(const std::string &path, const BenchmarkTable &table);
+// runs the headless benchmark warmup + runs times, one after another, and returns the
+// measured rows
+bool runHeadlessBenchmarks(const BenchCompareOptions &options, const std::string &programPath,
+                           BenchmarkTable &table);
+// pins the calling process, prints why and returns false where that isn't possible
+bool pinToCpu(std::size_t cpu);
+// prints why and returns false if a metric is missing or either side has fewer than two rows
+bool compareBenchmarkTables(const BenchmarkTable &baseline, const BenchmarkTable &candidate,
+                            const BenchCompareOptions &options,
+                            std::vector<MetricComparison> &comparisons);
+void printComparisons(const BenchCompareOptions &options,
+                      const std::vector<MetricComparison> &comparisons);
+// mean and confidence interval of each metric, for a run without a baseline
+void printRunSummary(const BenchmarkTable &table, const BenchCompareOptions &options);
@@ -0,0 +1,169 @@
+#include "input_log.h"
+
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+
+#include "../simulation/terrain.h"
+
+namespace {
+constexpr char MAGIC[8] = {'E', 'X', 'C', 'V', 'I', 'N', 'P', 'T'};
+constexpr std::uint32_t VERSION = 1;
+// reads back byte-swapped on a host of the other endianness
+constexpr std::uint32_t BYTE_ORDER_TAG = 0x01020304u;
+// dt, bucket x/z, camera x/y/z, yaw, pitch, then the dig/dump flags
+constexpr std::size_t FRAME_FLOATS = 8;
+constexpr std::size_t FRAME_BYTES = FRAME_FLOATS * sizeof(float) + 1;
+constexpr std::uint8_t DIG_FLAG = 1;
+constexpr std::uint8_t DUMP_FLAG = 2;
+
+struct InputHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byteOrder;
+  // 0 until the recorder closes
+  std::uint64_t frameCount;
+  std::uint64_t gridSize;
+  float spacing;
+  std::uint32_t buckets;
+  std::uint32_t brush;
+  std::uint32_t brushSize;
+  std::uint64_t initialChecksum;
+  // room for later versions, written as zeros
+  std::uint8_t reserved[8];
+};
+static_assert(sizeof(InputHeader) == 64, "input log header must stay 64 bytes");
+
+InputHeader makeHeader(const InputSession &session, std::size_t frameCount) {
+  InputHeader header{};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.byteOrder = BYTE_ORDER_TAG;
+  header.frameCount = frameCount;
+  header.gridSize = session.gridSize;
+  header.spacing = session.spacing;
+  header.buckets = static_cast<std::uint32_t>(session.buckets);
+  header.brush = static_cast<std::uint32_t>(session.brush);
+  header.brushSize = static_cast<std::uint32_t>(session.brushSize);
+  header.initialChecksum = session.initialChecksum;
+  return header;
+}
+} // namespace
+
+InputRecorder::~InputRecorder() { close(); }
+
+bool InputRecorder::open(const std::string &path, const InputSession &session) {
+  const std::filesystem::path target(path);
+  if (!target.parent_path().empty()) {
+    std::error_code ignored;
+    std::filesystem::create_directories(target.parent_path(), ignored);
+  }
+  output.open(path, std::ios::binary | std::ios::trunc);
+  if (!output.is_open()) {
+    std::cerr << "Failed to open input recording: " << path << "\n";
+    return false;
+  }
+  const InputHeader header = makeHeader(session, 0);
+  output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  frames = 0;
+  return static_cast<bool>(output);
+}
+
+void InputRecorder::append(const InputFrame &frame) {
+  if (!output.is_open()) {
+    return;
+  }
+  const float values[FRAME_FLOATS] = {frame.dt,
+                                      frame.bucket.x,
+                                      frame.bucket.y,
+                                      frame.cameraPosition.x,
+                                      frame.cameraPosition.y,
+                                      frame.cameraPosition.z,
+                                      frame.cameraYaw,
+                                      frame.cameraPitch};
+  char bytes[FRAME_BYTES];
+  std::memcpy(bytes, values, sizeof(values));
+  bytes[FRAME_BYTES - 1] =
+      static_cast<char>((frame.dig ? DIG_FLAG : 0) | (frame.dump ? DUMP_FLAG : 0));
+  output.write(bytes, FRAME_BYTES);
+  ++frames;
+}
+
+bool InputRecorder::close() {
+  if (!output.is_open()) {
+    return true;
+  }
+  // only the count changes, the rest of the header was right from the start
+  const std::uint64_t count = frames;
+  output.seekp(static_cast<std::streamoff>(offsetof(InputHeader, frameCount)));
+  output.write(reinterpret_cast<const char *>(&count), sizeof(count));
+  output.close();
+  return static_cast<bool>(output);
+}
+
+bool InputReplay::open(const std::string &path) {
+  std::ifstream input(path, std::ios::binary | std::ios::ate);
+  if (!input.is_open()) {
+    std::cerr << "Failed to open input recording: " << path << "\n";
+    return false;
+  }
+  const std::size_t fileBytes = static_cast<std::size_t>(input.tellg());
+  input.seekg(0);
+  InputHeader header{};
+  input.read(reinterpret_cast<char *>(&header), sizeof(header));
+  const auto reject = [&](const char *reason) {
+    std::cerr << "Can't replay " << path << ": " << reason << "\n";
+    return false;
+  };
+  if (!input || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+    return reject("not an input recording");
+  }
+  if (header.version != VERSION) {
+    return reject("unsupported version");
+  }
+  if (header.byteOrder != BYTE_ORDER_TAG) {
+    return reject("written on a host of the other byte order");
+  }
+  const std::size_t available = (fileBytes - sizeof(InputHeader)) / FRAME_BYTES;
+  const std::size_t count =
+      header.frameCount == 0 ? available : static_cast<std::size_t>(header.frameCount);
+  if (header.gridSize < 2 || header.gridSize > Terrain::maxGridSize() ||
+      !(header.spacing > 0.0f) || header.buckets == 0 ||
+      header.brush > static_cast<std::uint32_t>(BrushShape::Ellipse) || count > available) {
+    return reject("corrupt header");
+  }
+  if (count == 0) {
+    return reject("no frames recorded");
+  }
+
+  recorded.gridSize = static_cast<std::size_t>(header.gridSize);
+  recorded.spacing = header.spacing;
+  recorded.buckets = header.buckets;
+  recorded.brush = static_cast<BrushShape>(header.brush);
+  recorded.brushSize = header.brushSize;
+  recorded.initialChecksum = header.initialChecksum;
+
+  std::vector<char> bytes(count * FRAME_BYTES);
+  input.read(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+  if (!input) {
+    return reject("truncated");
+  }
+  inputs.resize(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    const char *frameBytes = &bytes[i * FRAME_BYTES];
+    float values[FRAME_FLOATS];
+    std::memcpy(values, frameBytes, sizeof(values));
+    InputFrame &frame = inputs[i];
+    frame.dt = values[0];
+    frame.bucket = glm::vec2(values[1], values[2]);
+    frame.cameraPosition = glm::vec3(values[3], values[4], values[5]);
+    frame.cameraYaw = values[6];
+    frame.cameraPitch = values[7];
+    const auto flags = static_cast<std::uint8_t>(frameBytes[FRAME_BYTES - 1]);
+    frame.dig = (flags & DIG_FLAG) != 0;
+    frame.dump = (flags & DUMP_FLAG) != 0;
+  }
+  return true;
+}
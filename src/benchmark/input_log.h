@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "../simulation/brush.h"
+
+// one frame of operator input, what --record writes and --replay feeds back
+struct InputFrame {
+  // the frame's real delta time, replayed as is so every edit moves the same soil
+  float dt = 0.0f;
+  // bucket x/z in terrain coordinates
+  glm::vec2 bucket{0.0f};
+  bool dig = false;
+  bool dump = false;
+  glm::vec3 cameraPosition{0.0f};
+  float cameraYaw = 0.0f;
+  float cameraPitch = 0.0f;
+};
+
+// what a replay has to match for the same input to give the same terrain
+struct InputSession {
+  std::size_t gridSize = 0;
+  float spacing = 0.0f;
+  std::size_t buckets = 1;
+  BrushShape brush = BrushShape::Point;
+  std::size_t brushSize = 0;
+  // heightfieldChecksum() of the terrain before the first frame
+  std::uint64_t initialChecksum = 0;
+};
+
+// --record: a 64-byte header (magic, version, byte-order tag, frame count, the session) followed
+// by 33 bytes per frame, written as the frames come in
+class InputRecorder {
+public:
+  InputRecorder() = default;
+  // patches the frame count into the header
+  ~InputRecorder();
+  InputRecorder(const InputRecorder &) = delete;
+  InputRecorder &operator=(const InputRecorder &) = delete;
+
+  // prints why and returns false if path can't be written
+  bool open(const std::string &path, const InputSession &session);
+  void append(const InputFrame &frame);
+  std::size_t frameCount() const { return frames; }
+  // returns false if any write failed
+  bool close();
+
+private:
+  std::ofstream output;
+  std::size_t frames = 0;
+};
+
+// --replay: a whole recording read into memory
+// a recording cut short by a crash still has a zero frame count in its header, it replays up
+// to its last whole frame
+class InputReplay {
+public:
+  // prints why and returns false if path isn't a usable recording
+  bool open(const std::string &path);
+  const InputSession &session() const { return recorded; }
+  const std::vector<InputFrame> &frames() const { return inputs; }
+
+private:
+  InputSession recorded;
+  std::vector<InputFrame> inputs;
+};
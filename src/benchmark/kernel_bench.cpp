@@ -0,0 +1,362 @@
+#include "kernel_bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include "../simulation/terrain.h"
+#include "workload.h"
+
+namespace {
+constexpr std::size_t EDITS_PER_REPETITION = 64;
+constexpr std::size_t LOOKUPS_PER_REPETITION = 1 << 16;
+constexpr std::size_t FLEET_BUCKETS = 8;
+constexpr std::size_t BRUSH_SIZE = 8;
+constexpr unsigned int PATTERN_SEED = 1234;
+
+// the lookup loops add into this so the calls can't be dropped
+volatile std::size_t lookupSink = 0;
+
+double median(std::vector<double> values) {
+  if (values.empty()) {
+    return 0.0;
+  }
+  const std::size_t middle = values.size() / 2;
+  std::nth_element(values.begin(), values.begin() + static_cast<long>(middle), values.end());
+  const double upper = values[middle];
+  if (values.size() % 2 != 0) {
+    return upper;
+  }
+  // nth_element leaves everything below the middle in the front half, its largest is the other
+  // middle value
+  const double lower =
+      *std::max_element(values.begin(), values.begin() + static_cast<long>(middle));
+  return (lower + upper) * 0.5;
+}
+
+SimdLevel chosenSimdLevel(const KernelBenchOptions &options) {
+  return clampSimdLevel(options.simdLevel.value_or(detectSimdLevel()));
+}
+
+// prepare runs untimed before every repetition, so each one starts from the same state
+template <typename Prepare, typename Run>
+std::vector<double> timeRepetitions(const KernelBenchOptions &options, Prepare prepare, Run run) {
+  std::vector<double> samples;
+  samples.reserve(options.repetitions);
+  for (std::size_t i = 0; i < options.warmup + options.repetitions; ++i) {
+    prepare();
+    const auto start = std::chrono::steady_clock::now();
+    run();
+    const auto end = std::chrono::steady_clock::now();
+    if (i >= options.warmup) {
+      samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+  }
+  return samples;
+}
+
+KernelBenchResult summarize(const char *kernel, const char *pattern, std::size_t gridSize,
+                            std::size_t operations, std::vector<double> samples) {
+  KernelBenchResult result;
+  result.kernel = kernel;
+  result.pattern = pattern;
+  result.gridSize = gridSize;
+  result.operations = operations;
+  result.medianMs = median(samples);
+  std::vector<double> deviations;
+  deviations.reserve(samples.size());
+  for (double sample : samples) {
+    deviations.push_back(std::abs(sample - result.medianMs));
+  }
+  result.madMs = median(deviations);
+  result.minMs = samples.empty() ? 0.0 : *std::min_element(samples.begin(), samples.end());
+  result.nsPerOperation =
+      operations > 0 ? result.medianMs * 1.0e6 / static_cast<double>(operations) : 0.0;
+  result.samplesMs = std::move(samples);
+  return result;
+}
+
+void printResult(const KernelBenchResult &result) {
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "  " << std::left << std::setw(16) << result.kernel << std::setw(10)
+            << result.pattern << std::right << std::setw(5) << result.gridSize << "x"
+            << std::left << std::setw(5) << result.gridSize << std::right << std::setw(8)
+            << result.operations << " ops: median " << std::setw(9) << result.medianMs
+            << " ms | MAD " << std::setw(7) << result.madMs << " ms | min " << std::setw(9)
+            << result.minMs << " ms | " << std::setprecision(1) << std::setw(10)
+            << result.nsPerOperation << " ns/op\n";
+  std::cout << std::defaultfloat;
+}
+
+// the same start every run, steep enough that the whole grid has to settle
+std::vector<float> roughenedHeights(std::size_t gridSize) {
+  const Terrain base(gridSize, Terrain::defaultSpacing(), nullptr, VertexFormat::Height);
+  std::vector<float> roughened = base.heightData();
+  std::mt19937 random(PATTERN_SEED);
+  std::uniform_real_distribution<float> noise(0.0f, 0.3f);
+  for (float &h : roughened) {
+    h += noise(random);
+  }
+  return roughened;
+}
+
+// EDITS_PER_REPETITION single-bucket edits, from a freshly generated terrain each repetition
+void benchModify(const KernelBenchOptions &options, std::size_t gridSize,
+                 std::vector<KernelBenchResult> &results) {
+  Terrain terrain(gridSize);
+  terrain.setSettleMode(SettleMode::Worklist, 1);
+  terrain.setSimdLevel(chosenSimdLevel(options));
+  const std::vector<float> start = terrain.heightData();
+  std::vector<VertexRange> ranges;
+  const auto reset = [&] {
+    terrain.setHeights(start);
+    terrain.takePendingUploads(ranges);
+  };
+
+  // point: every edit digs the middle cell, the pit deepens into a growing cascade
+  // path: the --benchmark bucket script; scatter: seeded random cells, digging and dumping
+  std::vector<TerrainEdit> path;
+  std::vector<TerrainEdit> scatter;
+  std::mt19937 random(PATTERN_SEED);
+  std::uniform_int_distribution<std::size_t> cell(0, gridSize - 1);
+  for (std::size_t i = 0; i < EDITS_PER_REPETITION; ++i) {
+    const glm::vec2 position = benchmarkBucketPosition(terrain, i);
+    const auto [row, col] = terrain.worldToGrid(position.x, position.y);
+    path.push_back({row, col, benchmarkActionForFrame(i) == TerrainAction::Dig});
+    const std::size_t scatterRow = cell(random);
+    scatter.push_back({scatterRow, cell(random), i % 2 == 0});
+  }
+  const std::vector<TerrainEdit> point(EDITS_PER_REPETITION,
+                                       TerrainEdit{gridSize / 2, gridSize / 2, true});
+  const Brush ellipse = Brush::fromShape(BrushShape::Ellipse, BRUSH_SIZE);
+
+  const auto single = [&](const std::vector<TerrainEdit> &edits) {
+    return [&terrain, &edits] {
+      for (const TerrainEdit &edit : edits) {
+        terrain.modify(edit.row, edit.col, edit.dig, BENCHMARK_SIMULATION_DT);
+      }
+    };
+  };
+  const auto stamped = [&] {
+    for (const TerrainEdit &edit : path) {
+      terrain.modify(edit.row, edit.col, ellipse, edit.dig, BENCHMARK_SIMULATION_DT);
+    }
+  };
+  const std::pair<const char *, std::function<void()>> patterns[] = {
+      {"point", single(point)}, {"path", single(path)}, {"scatter", single(scatter)},
+      {"brush", stamped}};
+  for (const auto &[pattern, run] : patterns) {
+    results.push_back(summarize("modify", pattern, gridSize, EDITS_PER_REPETITION,
+                                timeRepetitions(options, reset, run)));
+    printResult(results.back());
+  }
+}
+
+// EDITS_PER_REPETITION ticks of the --buckets fleet, one settle and rebuild per tick
+void benchModifyBatch(const KernelBenchOptions &options, std::size_t gridSize,
+                      std::vector<KernelBenchResult> &results) {
+  Terrain terrain(gridSize);
+  terrain.setSettleMode(SettleMode::Worklist, 1);
+  terrain.setSimdLevel(chosenSimdLevel(options));
+  const std::vector<float> start = terrain.heightData();
+  std::vector<VertexRange> ranges;
+  std::vector<std::vector<TerrainEdit>> ticks(EDITS_PER_REPETITION);
+  for (std::size_t i = 0; i < ticks.size(); ++i) {
+    fleetEdits(terrain, FLEET_BUCKETS, i, ticks[i]);
+  }
+
+  const auto reset = [&] {
+    terrain.setHeights(start);
+    terrain.takePendingUploads(ranges);
+  };
+  const auto run = [&] {
+    for (const std::vector<TerrainEdit> &tick : ticks) {
+      terrain.modifyBatch(tick, BENCHMARK_SIMULATION_DT);
+    }
+  };
+  results.push_back(summarize("modifyBatch", "fleet", gridSize, EDITS_PER_REPETITION,
+                              timeRepetitions(options, reset, run)));
+  printResult(results.back());
+}
+
+// stabilizeSoil is private, settleAll drives it over every cell; with height-only vertices
+// the rebuild after it is just dirty-set bookkeeping
+void benchStabilize(const KernelBenchOptions &options, std::size_t gridSize,
+                    std::vector<KernelBenchResult> &results) {
+  Terrain terrain(gridSize, Terrain::defaultSpacing(), nullptr, VertexFormat::Height);
+  terrain.setSettleMode(SettleMode::Worklist, 1);
+  terrain.setSimdLevel(chosenSimdLevel(options));
+  const std::vector<float> roughened = roughenedHeights(gridSize);
+  std::vector<VertexRange> ranges;
+
+  const auto reset = [&] {
+    terrain.setHeights(roughened);
+    terrain.takePendingUploads(ranges);
+  };
+  const auto run = [&] { terrain.settleAll(); };
+  results.push_back(summarize("stabilizeSoil", "roughened", gridSize, 1,
+                              timeRepetitions(options, reset, run)));
+  printResult(results.back());
+}
+
+// rebuildVertices is private too, setHeights rebuilds every vertex and its normal
+void benchRebuild(const KernelBenchOptions &options, std::size_t gridSize,
+                  std::vector<KernelBenchResult> &results) {
+  const std::pair<const char *, VertexFormat> formats[] = {{"full", VertexFormat::Full},
+                                                           {"packed", VertexFormat::Packed}};
+  for (const auto &[pattern, format] : formats) {
+    Terrain terrain(gridSize, Terrain::defaultSpacing(), nullptr, format);
+    const std::vector<float> heights = terrain.heightData();
+    std::vector<VertexRange> ranges;
+    const auto reset = [&] { terrain.takePendingUploads(ranges); };
+    const auto run = [&] { terrain.setHeights(heights); };
+    results.push_back(summarize("rebuildVertices", pattern, gridSize, terrain.cellCount(),
+                                timeRepetitions(options, reset, run)));
+    printResult(results.back());
+  }
+}
+
+// seeded random lookups, a few past the edges so worldToGrid's clamp gets exercised
+void benchWorldToGrid(const KernelBenchOptions &options, std::size_t gridSize,
+                      std::vector<KernelBenchResult> &results) {
+  const Terrain terrain(gridSize, Terrain::defaultSpacing(), nullptr, VertexFormat::Height);
+  std::mt19937 random(PATTERN_SEED);
+  const float margin = terrain.spacing() * 4.0f;
+  std::uniform_real_distribution<float> world(-margin, terrain.worldExtent() + margin);
+  std::vector<glm::vec2> positions(LOOKUPS_PER_REPETITION);
+  for (glm::vec2 &position : positions) {
+    position.x = world(random);
+    position.y = world(random);
+  }
+
+  const auto run = [&] {
+    std::size_t sum = 0;
+    for (const glm::vec2 &position : positions) {
+      const auto [row, col] = terrain.worldToGrid(position.x, position.y);
+      sum += row + col;
+    }
+    lookupSink = lookupSink + sum;
+  };
+  results.push_back(summarize("worldToGrid", "scatter", gridSize, LOOKUPS_PER_REPETITION,
+                              timeRepetitions(options, [] {}, run)));
+  printResult(results.back());
+}
+
+void benchGetHeight(const KernelBenchOptions &options, std::size_t gridSize,
+                    std::vector<KernelBenchResult> &results) {
+  Terrain terrain(gridSize, Terrain::defaultSpacing(), nullptr, VertexFormat::Height);
+  std::mt19937 random(PATTERN_SEED);
+  std::uniform_int_distribution<std::size_t> cell(0, gridSize - 1);
+  std::vector<std::pair<std::size_t, std::size_t>> cells(LOOKUPS_PER_REPETITION);
+  for (auto &[row, col] : cells) {
+    row = cell(random);
+    col = cell(random);
+  }
+
+  const auto run = [&] {
+    float sum = 0.0f;
+    for (const auto &[row, col] : cells) {
+      sum += terrain.getHeight(row, col).value_or(0.0f);
+    }
+    lookupSink = lookupSink + static_cast<std::size_t>(sum != 0.0f);
+  };
+  results.push_back(summarize("getHeight", "scatter", gridSize, LOOKUPS_PER_REPETITION,
+                              timeRepetitions(options, [] {}, run)));
+  printResult(results.back());
+}
+
+using Bench = void (*)(const KernelBenchOptions &, std::size_t, std::vector<KernelBenchResult> &);
+const std::pair<const char *, Bench> BENCHES[] = {
+    {"modify", benchModify},         {"modifyBatch", benchModifyBatch},
+    {"stabilizeSoil", benchStabilize}, {"rebuildVertices", benchRebuild},
+    {"worldToGrid", benchWorldToGrid}, {"getHeight", benchGetHeight}};
+} // namespace
+
+bool isKernelBenchName(const std::string &name) {
+  for (const auto &bench : BENCHES) {
+    if (name == bench.first) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<KernelBenchResult> runKernelBenchmarks(const KernelBenchOptions &options) {
+  std::cout << "Terrain kernels (" << simdLevelName(chosenSimdLevel(options)) << " kernels, "
+            << options.warmup << " warmup + " << options.repetitions << " timed repetitions)\n";
+  std::vector<KernelBenchResult> results;
+  for (std::size_t gridSize : options.gridSizes) {
+    for (const auto &[name, bench] : BENCHES) {
+      if (options.kernel.empty() || options.kernel == name) {
+        bench(options, gridSize, results);
+      }
+    }
+  }
+  return results;
+}
+
+bool writeKernelBenchJson(const std::string &path, const KernelBenchOptions &options,
+                          const std::vector<KernelBenchResult> &results) {
+  const std::filesystem::path jsonPath(path);
+  if (!jsonPath.parent_path().empty()) {
+    std::filesystem::create_directories(jsonPath.parent_path());
+  }
+  std::ofstream output(jsonPath, std::ios::trunc);
+  if (!output.is_open()) {
+    std::cerr << "Failed to open JSON output: " << path << "\n";
+    return false;
+  }
+
+  output << std::setprecision(9);
+  output << "{\n  \"benchmark\": \"terrain-bench\",\n  \"simd\": \""
+         << simdLevelName(chosenSimdLevel(options)) << "\",\n  \"warmup\": " << options.warmup
+         << ",\n  \"repetitions\": " << options.repetitions << ",\n  \"results\": [";
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    const KernelBenchResult &result = results[i];
+    output << (i == 0 ? "\n" : ",\n") << "    {\"kernel\": \"" << result.kernel
+           << "\", \"pattern\": \"" << result.pattern << "\", \"grid_size\": " << result.gridSize
+           << ", \"operations\": " << result.operations << ", \"median_ms\": " << result.medianMs
+           << ", \"mad_ms\": " << result.madMs << ", \"min_ms\": " << result.minMs
+           << ", \"ns_per_operation\": " << result.nsPerOperation << ", \"samples_ms\": [";
+    for (std::size_t s = 0; s < result.samplesMs.size(); ++s) {
+      output << (s == 0 ? "" : ", ") << result.samplesMs[s];
+    }
+    output << "]}";
+  }
+  output << "\n  ]\n}\n";
+  return static_cast<bool>(output);
+}
+
+bool writeKernelBenchCsv(const std::string &path, const KernelBenchOptions &options,
+                         const std::vector<KernelBenchResult> &results) {
+  const std::filesystem::path csvPath(path);
+  if (!csvPath.parent_path().empty()) {
+    std::filesystem::create_directories(csvPath.parent_path());
+  }
+
+  const bool needsHeader =
+      !std::filesystem::exists(csvPath) || std::filesystem::file_size(csvPath) == 0;
+  std::ofstream output(csvPath, std::ios::app);
+  if (!output.is_open()) {
+    std::cerr << "Failed to open CSV output: " << path << "\n";
+    return false;
+  }
+
+  if (needsHeader) {
+    output << "kernel,pattern,grid_size,operations,simd,warmup,repetitions,"
+              "median_ms,mad_ms,min_ms,ns_per_operation\n";
+  }
+  for (const KernelBenchResult &result : results) {
+    output << result.kernel << ',' << result.pattern << ',' << result.gridSize << ','
+           << result.operations << ',' << simdLevelName(chosenSimdLevel(options)) << ','
+           << options.warmup << ',' << options.repetitions << ',' << result.medianMs << ','
+           << result.madMs << ',' << result.minMs << ',' << result.nsPerOperation << '\n';
+  }
+  return static_cast<bool>(output);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "../simulation/settle_kernel.h"
+
+// terrain-bench flags, see parseKernelBenchArguments
+struct KernelBenchOptions {
+  std::vector<std::size_t> gridSizes = {64, 256, 1024};
+  // untimed repetitions run first to warm caches and the allocator
+  std::size_t warmup = 3;
+  std::size_t repetitions = 15;
+  // empty runs every kernel, otherwise only the one with this name
+  std::string kernel;
+  // empty picks the widest row kernel the cpu supports
+  std::optional<SimdLevel> simdLevel;
+  std::string jsonPath;
+  std::string csvPath;
+};
+
+// one kernel, pattern and grid size, every repetition timed separately
+struct KernelBenchResult {
+  // the Terrain function being measured, e.g. "modify" or "worldToGrid"
+  std::string kernel;
+  // how the edits or lookups are laid out, e.g. "point" or "scatter"
+  std::string pattern;
+  std::size_t gridSize = 0;
+  // calls per repetition
+  std::size_t operations = 0;
+  std::vector<double> samplesMs;
+  double medianMs = 0.0;
+  // median absolute deviation from medianMs
+  double madMs = 0.0;
+  double minMs = 0.0;
+  // medianMs spread over the calls
+  double nsPerOperation = 0.0;
+};
+
+// whether --kernel=name picks one of the kernels runKernelBenchmarks times
+bool isKernelBenchName(const std::string &name);
+// sweeps every kernel and pattern over options.gridSizes, printing each line as it finishes
+std::vector<KernelBenchResult> runKernelBenchmarks(const KernelBenchOptions &options);
+// writes the whole run, settings and raw samples included, replacing the file
+bool writeKernelBenchJson(const std::string &path, const KernelBenchOptions &options,
+                          const std::vector<KernelBenchResult> &results);
+// appends one row per result, writing the header first when the file is new
+bool writeKernelBenchCsv(const std::string &path, const KernelBenchOptions &options,
+                         const std::vector<KernelBenchResult> &results);
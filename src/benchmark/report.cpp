@@ -0,0 +1,307 @@
+#include "report.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+// terrain cost normalised by grid size, so growth with size shows up as a rising number
+double nanosecondsPerCell(double milliseconds, std::size_t gridSize) {
+  const double cells = static_cast<double>(gridSize) * static_cast<double>(gridSize);
+  return cells > 0.0 ? (milliseconds * 1.0e6) / cells : 0.0;
+}
+
+double tileHitPercent(const TileStreamStats &tiles) {
+  return tiles.requests > 0 ? 100.0 * static_cast<double>(tiles.hits) /
+                                  static_cast<double>(tiles.requests)
+                            : 0.0;
+}
+} // namespace
+
+void printBenchmarkSummary(const RuntimeTelemetry &telemetry, const BenchmarkRunInfo &run) {
+  const MetricSummary frameSummary = summarizeSamples(telemetry.frameHistogram);
+  const MetricSummary terrainSummary = summarizeSamples(telemetry.terrainHistogram);
+  const MetricSummary dirtySummary = summarizeSamples(telemetry.dirtyVertexHistogram);
+  const MetricSummary uploadSummary = summarizeSamples(telemetry.uploadByteHistogram);
+  const MetricSummary passSummary = summarizeSamples(telemetry.stabilizationPassHistogram);
+  const MetricSummary visitSummary = summarizeSamples(telemetry.cellsVisitedHistogram);
+  const MetricSummary queueSummary = summarizeSamples(telemetry.queueHighWaterHistogram);
+  const MetricSummary rangeSummary = summarizeSamples(telemetry.uploadRangeHistogram);
+  const MetricSummary gapSummary = summarizeSamples(telemetry.uploadGapByteHistogram);
+  const MetricSummary fenceSummary = summarizeSamples(telemetry.fenceWaitHistogram);
+  const MetricSummary chunkSummary = summarizeSamples(telemetry.chunksDrawnHistogram);
+  const MetricSummary triangleSummary = summarizeSamples(telemetry.triangleHistogram);
+  const MetricSummary cullSummary = summarizeSamples(telemetry.cullHistogram);
+  const MetricSummary renderSummary = summarizeSamples(telemetry.renderHistogram);
+  const MetricSummary simTickSummary = summarizeSamples(telemetry.simTickHistogram);
+  const MetricSummary latencySummary = summarizeSamples(telemetry.snapshotLatencyHistogram);
+  const MetricSummary tileStallSummary = summarizeSamples(telemetry.tileStallHistogram);
+  const MetricSummary editSummary = summarizeSamples(telemetry.editHistogram);
+  const MetricSummary settleSummary = summarizeSamples(telemetry.settleHistogram);
+  const MetricSummary slowestPassSummary = summarizeSamples(telemetry.slowestPassHistogram);
+  const MetricSummary dilateSummary = summarizeSamples(telemetry.dilateHistogram);
+  const MetricSummary rebuildSummary = summarizeSamples(telemetry.rebuildHistogram);
+  const MetricSummary uploadTimeSummary = summarizeSamples(telemetry.uploadHistogram);
+  const MetricSummary gpuTerrainSummary = summarizeSamples(telemetry.gpuTerrainHistogram);
+  const MetricSummary gpuBucketSummary = summarizeSamples(telemetry.gpuBucketHistogram);
+  const double averageFps =
+      run.wallSeconds > 0.0 ? static_cast<double>(run.completedFrames) / run.wallSeconds : 0.0;
+  const double cellsPerSecond =
+      terrainSummary.average > 0.0
+          ? static_cast<double>(run.gridSize) * static_cast<double>(run.gridSize) /
+                (terrainSummary.average / 1000.0)
+          : 0.0;
+
+  std::cout << "\nBenchmark Summary\n";
+  std::cout << "Frames: " << run.completedFrames << '\n';
+  std::cout << "Grid: " << run.gridSize << "x" << run.gridSize << " cells @ " << run.spacing
+            << " m spacing\n";
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "Settle: " << run.settleMode << " (" << run.settleThreads << " threads, "
+            << run.settleKernel << " kernel)\n";
+  if (run.brushSize > 0) {
+    std::cout << "Brush: " << run.brush << ", " << run.brushSize << " cells wide ("
+              << run.brushCells << " cells per edit)\n";
+  }
+  if (run.buckets > 1) {
+    std::cout << "Fleet: " << run.buckets << " buckets, edits batched per frame\n";
+  }
+  std::cout << "Scenario: " << run.scenario;
+  if (run.seeded) {
+    std::cout << " (seed " << run.seed << ")";
+  }
+  std::cout << '\n';
+  if (run.input != "script") {
+    std::cout << "Input: replayed from " << run.input << '\n';
+  }
+  if (run.renderTarget != "none") {
+    std::cout << "Render target: " << run.renderTarget << " " << run.renderWidth << "x"
+              << run.renderHeight;
+    if (!run.renderContext.empty()) {
+      std::cout << " (" << run.renderContext << ", not presented)";
+    }
+    std::cout << '\n';
+  }
+  std::cout << "Terrain: " << run.terrainSource << ", ready after " << run.terrainReadyMs
+            << " ms, first frame after " << run.firstFrameMs << " ms\n";
+  if (run.siteSize > 0) {
+    const TileStreamStats &tiles = telemetry.tileTotals;
+    std::cout << "Site: " << run.siteSize << "x" << run.siteSize << " cells, tile cache "
+              << formatBytes(static_cast<double>(run.tileCacheBytes)) << " (peak "
+              << formatBytes(static_cast<double>(run.tilePeakBytes)) << "), window moved "
+              << run.windowRecentres << " times\n";
+    std::cout << "Tiles: " << tileHitPercent(tiles) << "% of " << tiles.requests
+              << " reads hit | stall/frame: avg " << tileStallSummary.average << " ms | p95 "
+              << tileStallSummary.p95 << " ms | max " << tileStallSummary.maximum << " ms | "
+              << tiles.prefetched << " prefetched, " << tiles.evictions << " evicted, "
+              << tiles.writebacks << " written back\n";
+  }
+  std::cout << "Heightfield checksum: " << formatChecksum(run.heightChecksum) << '\n';
+  if (run.steepestExcess) {
+    std::cout << "Steepest slope past repose: " << std::scientific << *run.steepestExcess
+              << std::fixed << '\n';
+  }
+  std::cout << "Wall time: " << run.wallSeconds << " s\n";
+  std::cout << "Average FPS: " << averageFps << '\n';
+  std::cout << "Frame time: avg " << frameSummary.average << " ms | p95 " << frameSummary.p95
+            << " ms | max " << frameSummary.maximum << " ms\n";
+  std::cout << "Frame time percentiles: " << formatPercentiles(telemetry.frameHistogram, " ms")
+            << '\n';
+  if (!telemetry.renderHistogram.empty()) {
+    std::cout << "Render time/frame: avg " << renderSummary.average << " ms | p95 "
+              << renderSummary.p95 << " ms | max " << renderSummary.maximum << " ms\n";
+  }
+  if (run.simThread) {
+    std::cout << "Sim tick (own thread): avg " << simTickSummary.average << " ms | p95 "
+              << simTickSummary.p95 << " ms | max " << simTickSummary.maximum << " ms\n";
+    std::cout << "Snapshot latency: avg " << latencySummary.average << " ms | p95 "
+              << latencySummary.p95 << " ms | max " << latencySummary.maximum << " ms\n";
+  }
+  std::cout << "Terrain update: avg " << terrainSummary.average << " ms | p95 "
+            << terrainSummary.p95 << " ms | max " << terrainSummary.maximum << " ms\n";
+  std::cout << "Terrain update percentiles: "
+            << formatPercentiles(telemetry.terrainHistogram, " ms") << '\n';
+  // a point edit's phases are a few microseconds each
+  std::cout << std::setprecision(3);
+  std::cout << "Terrain phases/update (avg / p95 ms): edit " << editSummary.average << " / "
+            << editSummary.p95 << " | settle " << settleSummary.average << " / "
+            << settleSummary.p95 << " | dilate " << dilateSummary.average << " / "
+            << dilateSummary.p95 << " | rebuild " << rebuildSummary.average << " / "
+            << rebuildSummary.p95 << " | upload " << uploadTimeSummary.average << " / "
+            << uploadTimeSummary.p95 << '\n';
+  std::cout << std::setprecision(2);
+  std::cout << "Terrain cost/cell: avg " << nanosecondsPerCell(terrainSummary.average, run.gridSize)
+            << " ns | p95 " << nanosecondsPerCell(terrainSummary.p95, run.gridSize) << " ns | "
+            << (cellsPerSecond / 1.0e6) << " Mcells/s\n";
+  std::cout << "Dirty vertices/update: avg " << dirtySummary.average << " | p95 "
+            << dirtySummary.p95 << " | max " << dirtySummary.maximum << '\n';
+  std::cout << "Upload bytes/update: avg " << uploadSummary.average << " | p95 "
+            << uploadSummary.p95 << " | max " << uploadSummary.maximum << '\n';
+  std::cout << "Upload ranges/update: avg " << rangeSummary.average << " | p95 "
+            << rangeSummary.p95 << " | max " << rangeSummary.maximum << " (gap " << run.uploadGap
+            << " vertices)\n";
+  std::cout << "Upload merged-gap bytes/update: avg " << gapSummary.average << " | p95 "
+            << gapSummary.p95 << " | max " << gapSummary.maximum << '\n';
+  std::cout << "Upload path: " << run.uploadPath << " (" << run.vertexFormat << " vertices, "
+            << run.vertexBytes << " B each)";
+  if (!telemetry.fenceWaitHistogram.empty()) {
+    std::cout << " | fence wait/frame: avg " << fenceSummary.average << " ms | p95 "
+              << fenceSummary.p95 << " ms | max " << fenceSummary.maximum << " ms";
+  }
+  std::cout << '\n';
+  if (!telemetry.chunksDrawnHistogram.empty()) {
+    std::cout << "Chunks drawn/frame: avg " << chunkSummary.average << " | p95 "
+              << chunkSummary.p95 << " | max " << chunkSummary.maximum << " of "
+              << telemetry.chunksTotal << '\n';
+    std::cout << "Triangles/frame: avg " << triangleSummary.average << " | p95 "
+              << triangleSummary.p95 << " | max " << triangleSummary.maximum << '\n';
+    std::cout << "Cull + LOD time/frame: avg " << cullSummary.average << " ms | p95 "
+              << cullSummary.p95 << " ms | max " << cullSummary.maximum << " ms\n";
+  }
+  if (!telemetry.gpuTerrainHistogram.empty()) {
+    // from timer queries, so only the frames whose results came back in time
+    std::cout << "GPU time/frame: terrain avg " << gpuTerrainSummary.average << " ms | p95 "
+              << gpuTerrainSummary.p95 << " ms | max " << gpuTerrainSummary.maximum
+              << " ms | buckets avg " << gpuBucketSummary.average << " ms | p95 "
+              << gpuBucketSummary.p95 << " ms | max " << gpuBucketSummary.maximum << " ms ("
+              << telemetry.gpuTerrainHistogram.size() << " frames sampled)\n";
+  }
+  std::cout << "Stabilization passes/update: avg " << passSummary.average << " | p95 "
+            << passSummary.p95 << " | max " << passSummary.maximum << "\n";
+  std::cout << "Slowest settle pass/update: avg " << slowestPassSummary.average << " ms | p95 "
+            << slowestPassSummary.p95 << " ms | max " << slowestPassSummary.maximum << " ms\n";
+  std::cout << "Settle cells visited/update: avg " << visitSummary.average << " | p95 "
+            << visitSummary.p95 << " | max " << visitSummary.maximum << '\n';
+  std::cout << "Settle queue high-water/update: avg " << queueSummary.average << " | p95 "
+            << queueSummary.p95 << " | max " << queueSummary.maximum << '\n';
+  // whatever prints next, including the next scenario's summary, gets the default format back
+  std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+std::string formatChecksum(std::uint64_t checksum) {
+  std::ostringstream hex;
+  hex << std::hex << std::setw(16) << std::setfill('0') << checksum;
+  return hex.str();
+}
+
+bool writeBenchmarkCsv(const std::string &path, const RuntimeTelemetry &telemetry,
+                       const BenchmarkRunInfo &run) {
+  const std::filesystem::path csvPath(path);
+  if (!csvPath.parent_path().empty()) {
+    std::filesystem::create_directories(csvPath.parent_path());
+  }
+
+  const bool needsHeader = !std::filesystem::exists(csvPath) || std::filesystem::file_size(csvPath) == 0;
+  std::ofstream output(csvPath, std::ios::app);
+  if (!output.is_open()) {
+    std::cerr << "Failed to open CSV output: " << path << "\n";
+    return false;
+  }
+
+  const MetricSummary frameSummary = summarizeSamples(telemetry.frameHistogram);
+  const MetricSummary terrainSummary = summarizeSamples(telemetry.terrainHistogram);
+  const MetricSummary dirtySummary = summarizeSamples(telemetry.dirtyVertexHistogram);
+  const MetricSummary uploadSummary = summarizeSamples(telemetry.uploadByteHistogram);
+  const MetricSummary passSummary = summarizeSamples(telemetry.stabilizationPassHistogram);
+  const MetricSummary visitSummary = summarizeSamples(telemetry.cellsVisitedHistogram);
+  const MetricSummary queueSummary = summarizeSamples(telemetry.queueHighWaterHistogram);
+  const MetricSummary rangeSummary = summarizeSamples(telemetry.uploadRangeHistogram);
+  const MetricSummary gapSummary = summarizeSamples(telemetry.uploadGapByteHistogram);
+  const MetricSummary fenceSummary = summarizeSamples(telemetry.fenceWaitHistogram);
+  const MetricSummary chunkSummary = summarizeSamples(telemetry.chunksDrawnHistogram);
+  const MetricSummary triangleSummary = summarizeSamples(telemetry.triangleHistogram);
+  const MetricSummary cullSummary = summarizeSamples(telemetry.cullHistogram);
+  const MetricSummary renderSummary = summarizeSamples(telemetry.renderHistogram);
+  const MetricSummary simTickSummary = summarizeSamples(telemetry.simTickHistogram);
+  const MetricSummary latencySummary = summarizeSamples(telemetry.snapshotLatencyHistogram);
+  const MetricSummary tileStallSummary = summarizeSamples(telemetry.tileStallHistogram);
+  const MetricSummary editSummary = summarizeSamples(telemetry.editHistogram);
+  const MetricSummary settleSummary = summarizeSamples(telemetry.settleHistogram);
+  const MetricSummary slowestPassSummary = summarizeSamples(telemetry.slowestPassHistogram);
+  const MetricSummary dilateSummary = summarizeSamples(telemetry.dilateHistogram);
+  const MetricSummary rebuildSummary = summarizeSamples(telemetry.rebuildHistogram);
+  const MetricSummary uploadTimeSummary = summarizeSamples(telemetry.uploadHistogram);
+  const MetricSummary gpuTerrainSummary = summarizeSamples(telemetry.gpuTerrainHistogram);
+  const MetricSummary gpuBucketSummary = summarizeSamples(telemetry.gpuBucketHistogram);
+  const TileStreamStats &tiles = telemetry.tileTotals;
+  const double averageFps =
+      run.wallSeconds > 0.0 ? static_cast<double>(run.completedFrames) / run.wallSeconds : 0.0;
+
+  if (needsHeader) {
+    output << "frames,wall_seconds,avg_fps,avg_frame_ms,p95_frame_ms,max_frame_ms,"
+              "avg_terrain_ms,p95_terrain_ms,max_terrain_ms,"
+              "avg_dirty_vertices,p95_dirty_vertices,max_dirty_vertices,"
+              "avg_upload_bytes,p95_upload_bytes,max_upload_bytes,"
+              "avg_stabilization_passes,p95_stabilization_passes,max_stabilization_passes,"
+              "grid_size,spacing,avg_terrain_ns_per_cell,p95_terrain_ns_per_cell,"
+              "avg_cells_visited,p95_cells_visited,max_cells_visited,"
+              "avg_queue_high_water,p95_queue_high_water,max_queue_high_water,"
+              "settle_mode,settle_threads,settle_kernel,"
+              "avg_upload_ranges,p95_upload_ranges,max_upload_ranges,"
+              "avg_upload_gap_bytes,p95_upload_gap_bytes,max_upload_gap_bytes,"
+              "upload_gap,upload_path,avg_fence_wait_ms,p95_fence_wait_ms,max_fence_wait_ms,"
+              "vertex_format,avg_chunks_drawn,p95_chunks_drawn,chunks_total,"
+              "avg_triangles,p95_triangles,max_triangles,avg_cull_ms,p95_cull_ms,max_cull_ms,"
+              "vertex_bytes,sim_thread,avg_render_ms,p95_render_ms,max_render_ms,"
+              "avg_sim_tick_ms,p95_sim_tick_ms,max_sim_tick_ms,avg_snapshot_latency_ms,"
+              "p95_snapshot_latency_ms,max_snapshot_latency_ms,buckets,"
+              "brush,brush_size,brush_cells,terrain_source,terrain_ready_ms,first_frame_ms,"
+              "site_size,tile_cache_bytes,tile_peak_bytes,window_recentres,tile_reads,"
+              "tile_hit_percent,avg_tile_stall_ms,p95_tile_stall_ms,max_tile_stall_ms,"
+              "tiles_prefetched,tiles_evicted,tiles_written_back,input,height_checksum,"
+              "scenario,seed,avg_edit_ms,p95_edit_ms,avg_settle_ms,p95_settle_ms,"
+              "avg_slowest_pass_ms,p95_slowest_pass_ms,max_slowest_pass_ms,avg_dilate_ms,"
+              "p95_dilate_ms,avg_rebuild_ms,p95_rebuild_ms,avg_upload_ms,p95_upload_ms,"
+              "avg_gpu_terrain_ms,p95_gpu_terrain_ms,max_gpu_terrain_ms,avg_gpu_bucket_ms,"
+              "p95_gpu_bucket_ms,max_gpu_bucket_ms,p50_frame_ms,p90_frame_ms,p99_frame_ms,"
+              "p999_frame_ms,p50_terrain_ms,p90_terrain_ms,p99_terrain_ms,p999_terrain_ms,"
+              "render_target,render_width,render_height\n";
+  }
+
+  output << run.completedFrames << ',' << run.wallSeconds << ',' << averageFps << ','
+         << frameSummary.average << ',' << frameSummary.p95 << ',' << frameSummary.maximum << ','
+         << terrainSummary.average << ',' << terrainSummary.p95 << ',' << terrainSummary.maximum
+         << ',' << dirtySummary.average << ',' << dirtySummary.p95 << ',' << dirtySummary.maximum
+         << ',' << uploadSummary.average << ',' << uploadSummary.p95 << ','
+         << uploadSummary.maximum << ',' << passSummary.average << ',' << passSummary.p95 << ','
+         << passSummary.maximum << ',' << run.gridSize << ',' << run.spacing << ','
+         << nanosecondsPerCell(terrainSummary.average, run.gridSize) << ','
+         << nanosecondsPerCell(terrainSummary.p95, run.gridSize) << ',' << visitSummary.average
+         << ',' << visitSummary.p95 << ',' << visitSummary.maximum << ',' << queueSummary.average
+         << ',' << queueSummary.p95 << ',' << queueSummary.maximum << ',' << run.settleMode << ','
+         << run.settleThreads << ',' << run.settleKernel << ',' << rangeSummary.average << ','
+         << rangeSummary.p95 << ',' << rangeSummary.maximum << ',' << gapSummary.average << ','
+         << gapSummary.p95 << ',' << gapSummary.maximum << ',' << run.uploadGap << ','
+         << run.uploadPath << ',' << fenceSummary.average << ',' << fenceSummary.p95 << ','
+         << fenceSummary.maximum << ',' << run.vertexFormat << ',' << chunkSummary.average << ','
+         << chunkSummary.p95 << ',' << telemetry.chunksTotal << ',' << triangleSummary.average
+         << ',' << triangleSummary.p95 << ',' << triangleSummary.maximum << ','
+         << cullSummary.average << ',' << cullSummary.p95 << ',' << cullSummary.maximum << ','
+         << run.vertexBytes << ',' << run.simThread << ',' << renderSummary.average << ','
+         << renderSummary.p95 << ',' << renderSummary.maximum << ',' << simTickSummary.average
+         << ',' << simTickSummary.p95 << ',' << simTickSummary.maximum << ','
+         << latencySummary.average << ',' << latencySummary.p95 << ',' << latencySummary.maximum
+         << ',' << run.buckets << ',' << run.brush << ',' << run.brushSize << ','
+         << run.brushCells << ',' << run.terrainSource << ',' << run.terrainReadyMs << ','
+         << run.firstFrameMs << ',' << run.siteSize << ',' << run.tileCacheBytes << ','
+         << run.tilePeakBytes << ',' << run.windowRecentres << ',' << tiles.requests << ','
+         << tileHitPercent(tiles) << ',' << tileStallSummary.average << ','
+         << tileStallSummary.p95 << ',' << tileStallSummary.maximum << ',' << tiles.prefetched
+         << ',' << tiles.evictions << ',' << tiles.writebacks << ',' << run.input << ','
+         << formatChecksum(run.heightChecksum) << ',' << run.scenario << ',' << run.seed << ','
+         << editSummary.average << ',' << editSummary.p95 << ',' << settleSummary.average << ','
+         << settleSummary.p95 << ',' << slowestPassSummary.average << ','
+         << slowestPassSummary.p95 << ',' << slowestPassSummary.maximum << ','
+         << dilateSummary.average << ',' << dilateSummary.p95 << ',' << rebuildSummary.average
+         << ',' << rebuildSummary.p95 << ',' << uploadTimeSummary.average << ','
+         << uploadTimeSummary.p95 << ',' << gpuTerrainSummary.average << ','
+         << gpuTerrainSummary.p95 << ',' << gpuTerrainSummary.maximum << ','
+         << gpuBucketSummary.average << ',' << gpuBucketSummary.p95 << ','
+         << gpuBucketSummary.maximum << ',' << frameSummary.p50 << ',' << frameSummary.p90 << ','
+         << frameSummary.p99 << ',' << frameSummary.p999 << ',' << terrainSummary.p50 << ','
+         << terrainSummary.p90 << ',' << terrainSummary.p99 << ',' << terrainSummary.p999 << ','
+         << run.renderTarget << ',' << run.renderWidth << ',' << run.renderHeight << '\n';
+  return true;
+}
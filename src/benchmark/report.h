@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "../telemetry/telemetry.h"
+
+// describes one finished benchmark run alongside its telemetry
+struct BenchmarkRunInfo {
+  std::size_t completedFrames = 0;
+  double wallSeconds = 0.0;
+  std::size_t gridSize = 0;
+  float spacing = 0.0f;
+  std::string settleMode;
+  std::size_t settleThreads = 1;
+  std::string settleKernel;
+  std::size_t uploadGap = 0;
+  // "none" for the headless binary
+  std::string uploadPath = "none";
+  std::string vertexFormat;
+  std::size_t vertexBytes = 0;
+  // terrain ticks ran on their own thread (--sim-thread)
+  bool simThread = false;
+  // scripted buckets editing the terrain each frame (--buckets)
+  std::size_t buckets = 1;
+  // bucket footprint (--brush), size and covered cells are 0 for the point edit
+  std::string brush = "point";
+  std::size_t brushSize = 0;
+  std::size_t brushCells = 0;
+  // "generated", or the --load or --site path
+  std::string terrainSource = "generated";
+  // from process start until the terrain was built, and until the first frame was done
+  double terrainReadyMs = 0.0;
+  double firstFrameMs = 0.0;
+  // --site: cells a side of the whole site (0 without one), the tile budget and the most the
+  // cache held, and how often the loaded window moved
+  std::size_t siteSize = 0;
+  std::size_t tileCacheBytes = 0;
+  std::size_t tilePeakBytes = 0;
+  std::size_t windowRecentres = 0;
+  // "script", or the --replay path the edits came from
+  std::string input = "script";
+  // --scenario workload the bucket followed, "sweep" being the original path; seed is only
+  // printed when the scenario draws from it
+  std::string scenario = "sweep";
+  std::uint32_t seed = 0;
+  bool seeded = false;
+  // heightfieldChecksum() of the terrain at the end of the run
+  std::uint64_t heightChecksum = 0;
+  // Terrain::steepestExcess() at the end of the run, the headless binary fills it in
+  std::optional<float> steepestExcess;
+  // "window", "offscreen" (--offscreen) or "none" for the headless binary, and the size drawn at
+  std::string renderTarget = "none";
+  std::size_t renderWidth = 0;
+  std::size_t renderHeight = 0;
+  // how the offscreen run got its context, "hidden window" or "surfaceless EGL"
+  std::string renderContext;
+};
+
+// 16 hex digits, how the summary and CSV print BenchmarkRunInfo::heightChecksum
+std::string formatChecksum(std::uint64_t checksum);
+void printBenchmarkSummary(const RuntimeTelemetry &telemetry, const BenchmarkRunInfo &run);
+// appends one summary row, writing the header first when the file is new
+bool writeBenchmarkCsv(const std::string &path, const RuntimeTelemetry &telemetry,
+                       const BenchmarkRunInfo &run);
@@ -0,0 +1,218 @@
+#include "scenario.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+#include "../simulation/terrain.h"
+
+namespace {
+constexpr const char *SWEEP = "sweep";
+constexpr std::size_t WANDER_MIN_FRAMES = 60;
+constexpr std::size_t WANDER_MAX_FRAMES = 240;
+
+struct BuiltinScenario {
+  const char *name;
+  const char *text;
+};
+
+// in the same format as a scenario file
+const BuiltinScenario BUILTINS[] = {
+    {"trench", "# back and forth along one line, cutting deeper every pass\n"
+               "dig 600 0.2 0.5 0.8 0.5\n"
+               "dig 600 0.8 0.5 0.2 0.5\n"},
+    {"stockpile", "# every load dumped on one spot, each one sliding down a growing heap\n"
+                  "dump 1200 0.5 0.5\n"},
+    {"edge", "# round the very border, where the edit and the settle clip at the grid edge\n"
+             "dig 400 0 0 1 0\n"
+             "dig 400 1 0 1 1\n"
+             "dump 400 1 1 0 1\n"
+             "dump 400 0 1 0 0\n"},
+    {"random-walk", "# wherever the seed takes it, never far from where it just was\n"
+                    "wander 3000 0.1\n"},
+    {"avalanche", "# a heap, then its foot is dug away so the face above keeps collapsing\n"
+                  "dump 600 0.5 0.5\n"
+                  "dig 300 0.5 0.58 0.58 0.5\n"
+                  "dig 300 0.58 0.5 0.5 0.42\n"},
+};
+
+// straight from the generator's output, so a seed gives the same strokes with any standard
+// library
+float unitFloat(std::mt19937 &random) {
+  return static_cast<float>(random() >> 8) / static_cast<float>(1u << 24);
+}
+
+bool parseAction(const std::string &word, TerrainAction &action) {
+  if (word == "dig") {
+    action = TerrainAction::Dig;
+  } else if (word == "dump") {
+    action = TerrainAction::Dump;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool inUnitRange(glm::vec2 position) {
+  return position.x >= 0.0f && position.x <= 1.0f && position.y >= 0.0f && position.y <= 1.0f;
+}
+} // namespace
+
+Scenario::Scenario() : scenarioName(SWEEP) {}
+
+const std::vector<std::string> &Scenario::builtinNames() {
+  static const std::vector<std::string> names = [] {
+    std::vector<std::string> all = {SWEEP};
+    for (const BuiltinScenario &builtin : BUILTINS) {
+      all.push_back(builtin.name);
+    }
+    return all;
+  }();
+  return names;
+}
+
+bool Scenario::open(const std::string &nameOrPath, std::uint32_t seed) {
+  strokes.clear();
+  strokeEnds.clear();
+  usesSeed = false;
+  if (nameOrPath == SWEEP) {
+    scenarioName = SWEEP;
+    return true;
+  }
+  for (const BuiltinScenario &builtin : BUILTINS) {
+    if (nameOrPath == builtin.name) {
+      scenarioName = builtin.name;
+      return parse(builtin.text, builtin.name, seed);
+    }
+  }
+
+  std::ifstream input(nameOrPath);
+  if (!input.is_open()) {
+    std::cerr << "No scenario called " << nameOrPath << ", and no file by that name either\n";
+    return false;
+  }
+  std::ostringstream text;
+  text << input.rdbuf();
+  scenarioName = std::filesystem::path(nameOrPath).stem().string();
+  return parse(text.str(), nameOrPath, seed);
+}
+
+bool Scenario::parse(const std::string &text, const std::string &source, std::uint32_t seed) {
+  std::mt19937 random(seed);
+  glm::vec2 position(0.5f);
+  std::istringstream lines(text);
+  std::string line;
+  std::size_t lineNumber = 0;
+  const auto reject = [&](const char *reason) {
+    std::cerr << "Can't use scenario " << source << ": " << reason << " on line " << lineNumber
+              << "\n";
+    return false;
+  };
+  while (std::getline(lines, line)) {
+    ++lineNumber;
+    line = line.substr(0, line.find('#'));
+    std::istringstream words(line);
+    std::string keyword;
+    if (!(words >> keyword)) {
+      continue;
+    }
+
+    ScenarioStroke stroke;
+    std::string extra;
+    if (keyword == "name") {
+      if (!(words >> scenarioName) || words >> extra) {
+        return reject("expected one word after name");
+      }
+    } else if (parseAction(keyword, stroke.action)) {
+      if (!(words >> stroke.frames >> stroke.from.x >> stroke.from.y) || stroke.frames == 0) {
+        return reject("expected a frame count and a position");
+      }
+      stroke.to = stroke.from;
+      glm::vec2 to(0.0f);
+      if (words >> to.x) {
+        if (!(words >> to.y)) {
+          return reject("expected both coordinates of the end position");
+        }
+        stroke.to = to;
+      } else if (!words.eof()) {
+        return reject("expected a number for the end position");
+      }
+      if (words >> extra) {
+        return reject("too many values");
+      }
+      if (!inUnitRange(stroke.from) || !inUnitRange(stroke.to)) {
+        return reject("positions have to be between 0 and 1");
+      }
+      strokes.push_back(stroke);
+      position = stroke.to;
+    } else if (keyword == "wander") {
+      std::size_t frames = 0;
+      float radius = 0.0f;
+      if (!(words >> frames >> radius) || frames == 0 || !(radius > 0.0f) || words >> extra) {
+        return reject("expected a frame count and a radius");
+      }
+      usesSeed = true;
+      while (frames > 0) {
+        const std::size_t span = WANDER_MAX_FRAMES - WANDER_MIN_FRAMES + 1;
+        stroke.frames = std::min<std::size_t>(frames, WANDER_MIN_FRAMES + random() % span);
+        const float angle = unitFloat(random) * 6.2831853f;
+        const float distance = unitFloat(random) * radius;
+        stroke.action = random() % 2 == 0 ? TerrainAction::Dig : TerrainAction::Dump;
+        stroke.from = position;
+        stroke.to.x = std::clamp(position.x + distance * std::cos(angle), 0.0f, 1.0f);
+        stroke.to.y = std::clamp(position.y + distance * std::sin(angle), 0.0f, 1.0f);
+        strokes.push_back(stroke);
+        position = stroke.to;
+        frames -= stroke.frames;
+      }
+    } else {
+      return reject("unknown keyword");
+    }
+  }
+  if (strokes.empty()) {
+    std::cerr << "Can't use scenario " << source << ": it has no strokes\n";
+    return false;
+  }
+
+  std::size_t end = 0;
+  for (const ScenarioStroke &stroke : strokes) {
+    end += stroke.frames;
+    strokeEnds.push_back(end);
+  }
+  return true;
+}
+
+const ScenarioStroke &Scenario::strokeAt(std::size_t frameIndex,
+                                         std::size_t &strokeFrame) const {
+  const std::size_t frame = frameIndex % strokeEnds.back();
+  const auto end = std::upper_bound(strokeEnds.begin(), strokeEnds.end(), frame);
+  const std::size_t index = static_cast<std::size_t>(end - strokeEnds.begin());
+  strokeFrame = frame - (*end - strokes[index].frames);
+  return strokes[index];
+}
+
+glm::vec2 Scenario::bucketPosition(const Terrain &terrain, std::size_t frameIndex) const {
+  if (strokes.empty()) {
+    return benchmarkBucketPosition(terrain, frameIndex);
+  }
+  std::size_t strokeFrame = 0;
+  const ScenarioStroke &stroke = strokeAt(frameIndex, strokeFrame);
+  const float t = static_cast<float>(strokeFrame) / static_cast<float>(stroke.frames);
+  const glm::vec2 fraction = stroke.from + (stroke.to - stroke.from) * t;
+  // cell centres, so 0 and 1 land on the first and last cell rather than just inside them
+  const float lastCell = static_cast<float>(terrain.gridSize() - 1);
+  return glm::vec2(fraction.x * lastCell + 0.5f, fraction.y * lastCell + 0.5f) *
+         terrain.spacing();
+}
+
+TerrainAction Scenario::actionForFrame(std::size_t frameIndex) const {
+  if (strokes.empty()) {
+    return benchmarkActionForFrame(frameIndex);
+  }
+  std::size_t strokeFrame = 0;
+  return strokeAt(frameIndex, strokeFrame).action;
+}
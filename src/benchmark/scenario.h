@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "workload.h"
+
+class Terrain;
+
+// one straight run of a scenario: the bucket moves from `from` to `to` over `frames` frames,
+// digging or dumping the whole way
+// positions are fractions of the terrain across each axis, 0 and 1 being the edge cells
+struct ScenarioStroke {
+  TerrainAction action = TerrainAction::Dig;
+  std::size_t frames = 1;
+  glm::vec2 from{0.5f};
+  glm::vec2 to{0.5f};
+};
+
+// a named single-bucket benchmark workload (--scenario)
+// scenario files are plain text, one stroke per line, '#' starts a comment:
+//   name NAME                      what the summary and CSV call it, the file name otherwise
+//   dig|dump FRAMES X Z [X2 Z2]    a stroke, staying put without X2 Z2
+//   wander FRAMES RADIUS           seeded strokes of 60-240 frames to random points at most
+//                                  RADIUS from where the last one ended, digging or dumping
+// a run longer than the scenario starts it over
+class Scenario {
+public:
+  // the scripted path --benchmark always ran, and what every run without --scenario uses
+  Scenario();
+
+  // a built-in (see builtinNames) or a scenario file, wander strokes are drawn from seed
+  // prints why and returns false if it can't be used
+  bool open(const std::string &nameOrPath, std::uint32_t seed);
+  const std::string &name() const { return scenarioName; }
+  // false when the seed makes no difference to the strokes
+  bool seeded() const { return usesSeed; }
+  glm::vec2 bucketPosition(const Terrain &terrain, std::size_t frameIndex) const;
+  TerrainAction actionForFrame(std::size_t frameIndex) const;
+
+  // "sweep" first, then the ones that stress a particular path
+  static const std::vector<std::string> &builtinNames();
+
+private:
+  bool parse(const std::string &text, const std::string &source, std::uint32_t seed);
+  const ScenarioStroke &strokeAt(std::size_t frameIndex, std::size_t &strokeFrame) const;
+
+  std::string scenarioName;
+  bool usesSeed = false;
+  // empty for "sweep", which follows benchmarkBucketPosition and benchmarkActionForFrame
+  std::vector<ScenarioStroke> strokes;
+  // frame each stroke ends on, the last one being the scenario's length
+  std::vector<std::size_t> strokeEnds;
+};
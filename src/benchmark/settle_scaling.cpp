@@ -0,0 +1,198 @@
+#include "settle_scaling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+
+#include "../simulation/brush.h"
+
+namespace {
+constexpr unsigned int ROUGHNESS_SEED = 1234;
+// the dumped pile: cells across its round top, and how tall it stands in repose differences
+constexpr std::size_t STOCKPILE_RADIUS = 6;
+constexpr float STOCKPILE_REPOSE_HEIGHTS = 40.0f;
+
+double totalVolume(const std::vector<float> &heights) {
+  return std::accumulate(heights.begin(), heights.end(), 0.0);
+}
+
+// the same rough start for every run, steep enough that the whole grid has to settle
+std::vector<float> roughenedHeights(std::size_t gridSize, float spacing) {
+  const Terrain base(gridSize, spacing);
+  std::vector<float> roughened = base.heightData();
+  std::mt19937 random(ROUGHNESS_SEED);
+  std::uniform_real_distribution<float> noise(0.0f, 0.3f);
+  for (float &h : roughened) {
+    h += noise(random);
+  }
+  return roughened;
+}
+
+// the first run fills reference, later runs are compared against it
+SettleScalingResult settleRoughened(std::size_t gridSize, float spacing,
+                                    const std::vector<float> &roughened, std::size_t threads,
+                                    SimdLevel level, std::vector<float> &reference) {
+  Terrain terrain(gridSize, spacing);
+  terrain.setSettleMode(SettleMode::Parallel, threads);
+  terrain.setSimdLevel(level);
+  terrain.setHeights(roughened);
+  const TerrainUpdateStats stats = terrain.settleAll();
+
+  SettleScalingResult result;
+  result.threads = threads;
+  result.simdLevel = terrain.getSimdLevel();
+  result.milliseconds = stats.cpuMs;
+  result.passes = stats.stabilizationPasses;
+  result.volumeDrift = totalVolume(terrain.heightData()) - totalVolume(roughened);
+  if (reference.empty()) {
+    reference = terrain.heightData();
+  }
+  result.identical = terrain.heightData() == reference;
+  return result;
+}
+} // namespace
+
+std::vector<SettleScalingResult> measureSettleScaling(std::size_t gridSize, float spacing,
+                                                      std::size_t maxThreads, SimdLevel level) {
+  std::vector<std::size_t> threadCounts;
+  for (std::size_t threads = 1; threads < maxThreads; threads *= 2) {
+    threadCounts.push_back(threads);
+  }
+  threadCounts.push_back(std::max<std::size_t>(maxThreads, 1));
+
+  const std::vector<float> roughened = roughenedHeights(gridSize, spacing);
+  std::vector<SettleScalingResult> results;
+  std::vector<float> reference;
+  for (std::size_t threads : threadCounts) {
+    results.push_back(settleRoughened(gridSize, spacing, roughened, threads, level, reference));
+  }
+  return results;
+}
+
+std::vector<SettleScalingResult> measureSettleKernels(std::size_t gridSize, float spacing) {
+  const std::vector<float> roughened = roughenedHeights(gridSize, spacing);
+  std::vector<SettleScalingResult> results;
+  std::vector<float> reference;
+  for (int level = 0; level <= static_cast<int>(detectSimdLevel()); ++level) {
+    results.push_back(settleRoughened(gridSize, spacing, roughened, 1,
+                                      static_cast<SimdLevel>(level), reference));
+  }
+  return results;
+}
+
+void printSettleScaling(const std::vector<SettleScalingResult> &results, std::size_t gridSize) {
+  if (results.empty()) {
+    return;
+  }
+
+  const double baseline = results.front().milliseconds;
+  std::cout << "\nParallel settle scaling (" << gridSize << "x" << gridSize
+            << " roughened grid, full settle)\n";
+  for (const SettleScalingResult &result : results) {
+    const double speedup = result.milliseconds > 0.0 ? baseline / result.milliseconds : 0.0;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "  threads " << std::setw(3) << result.threads << ": " << std::setw(9)
+              << result.milliseconds << " ms | speedup " << speedup << "x | passes "
+              << result.passes << " | " << (result.identical ? "identical" : "DIFFERS")
+              << " | volume drift " << std::scientific << std::setprecision(2)
+              << result.volumeDrift << '\n';
+  }
+  std::cout << std::defaultfloat;
+}
+
+void printSettleKernels(const std::vector<SettleScalingResult> &results, std::size_t gridSize) {
+  if (results.empty()) {
+    return;
+  }
+
+  const double baseline = results.front().milliseconds;
+  std::cout << "\nSettle row kernels (" << gridSize << "x" << gridSize
+            << " roughened grid, full settle, 1 thread)\n";
+  for (const SettleScalingResult &result : results) {
+    const double speedup = result.milliseconds > 0.0 ? baseline / result.milliseconds : 0.0;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "  " << std::setw(6) << simdLevelName(result.simdLevel) << ": " << std::setw(9)
+              << result.milliseconds << " ms | speedup " << speedup << "x | passes "
+              << result.passes << " | " << (result.identical ? "identical" : "DIFFERS") << '\n';
+  }
+  std::cout << std::defaultfloat;
+}
+
+std::vector<SettleConvergenceResult> measureStockpileConvergence(std::size_t gridSize,
+                                                                 float spacing,
+                                                                 std::size_t threads,
+                                                                 SimdLevel level) {
+  // a whole pile dropped at once, far more than one frame's dump
+  const Terrain base(gridSize, spacing);
+  std::vector<float> dumped = base.heightData();
+  const long size = static_cast<long>(base.gridSize());
+  const long radius = std::min<long>(static_cast<long>(STOCKPILE_RADIUS), size / 4);
+  const float pileHeight = STOCKPILE_REPOSE_HEIGHTS * base.reposeDifference();
+  for (long r = size / 2 - radius; r <= size / 2 + radius; ++r) {
+    for (long c = size / 2 - radius; c <= size / 2 + radius; ++c) {
+      const long dr = r - size / 2;
+      const long dc = c - size / 2;
+      if (dr * dr + dc * dc <= radius * radius) {
+        dumped[static_cast<std::size_t>(r * size + c)] += pileHeight;
+      }
+    }
+  }
+
+  std::vector<SettleConvergenceResult> results;
+  for (SettleMode mode : {SettleMode::Worklist, SettleMode::Parallel, SettleMode::Flood}) {
+    Terrain terrain(gridSize, spacing);
+    terrain.setSettleMode(mode, mode == SettleMode::Parallel ? threads : 1);
+    terrain.setSimdLevel(level);
+    terrain.setHeights(dumped);
+    const TerrainUpdateStats stats = terrain.settleAll();
+
+    SettleConvergenceResult result;
+    result.mode = mode;
+    result.milliseconds = stats.settleMs;
+    result.passes = stats.stabilizationPasses;
+    result.cellsVisited = stats.cellsVisited;
+    result.steepestExcess = terrain.steepestExcess();
+    result.volumeDrift = totalVolume(terrain.heightData()) - totalVolume(dumped);
+    results.push_back(result);
+  }
+  return results;
+}
+
+void printStockpileConvergence(const std::vector<SettleConvergenceResult> &results,
+                               std::size_t gridSize) {
+  if (results.empty()) {
+    return;
+  }
+
+  const std::size_t across = 2 * std::min(STOCKPILE_RADIUS, gridSize / 4) + 1;
+  std::cout << std::defaultfloat << "\nStockpile settle to convergence (" << gridSize << "x"
+            << gridSize << " grid, a pile " << across << " cells across and "
+            << STOCKPILE_REPOSE_HEIGHTS << " repose steps tall dumped at once)\n";
+  for (const SettleConvergenceResult &result : results) {
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "  " << std::setw(8) << settleModeName(result.mode) << ": " << std::setw(9)
+              << result.milliseconds << " ms | passes " << result.passes << " | cells visited "
+              << result.cellsVisited << " | steepest excess " << std::scientific
+              << std::setprecision(2) << result.steepestExcess << " | volume drift "
+              << result.volumeDrift << '\n';
+  }
+  std::cout << std::defaultfloat;
+}
+
+int runSelfCheck() {
+  constexpr std::size_t SELF_CHECK_GRID = 1024;
+  const bool kernelsMatch = selfCheckSettleKernels(std::cout);
+  const bool stampsMatch = selfCheckStampKernels(std::cout);
+  const std::vector<SettleScalingResult> results =
+      measureSettleKernels(SELF_CHECK_GRID, Terrain::defaultSpacing());
+  printSettleKernels(results, SELF_CHECK_GRID);
+  bool settlesMatch = true;
+  for (const SettleScalingResult &result : results) {
+    settlesMatch = settlesMatch && result.identical;
+  }
+  return kernelsMatch && stampsMatch && settlesMatch ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "../simulation/settle_kernel.h"
+#include "../simulation/terrain.h"
+
+struct SettleScalingResult {
+  std::size_t threads = 0;
+  SimdLevel simdLevel = SimdLevel::Scalar;
+  double milliseconds = 0.0;
+  std::size_t passes = 0;
+  // heightfield matches the single-threaded run bit for bit
+  bool identical = false;
+  // total height after minus before, summed in double
+  double volumeDrift = 0.0;
+};
+
+// settles the same randomly roughened grid with the parallel solver at 1, 2, 4, ... maxThreads
+std::vector<SettleScalingResult> measureSettleScaling(std::size_t gridSize, float spacing,
+                                                      std::size_t maxThreads, SimdLevel level);
+void printSettleScaling(const std::vector<SettleScalingResult> &results, std::size_t gridSize);
+
+// settles the same roughened grid single-threaded once per supported row kernel
+std::vector<SettleScalingResult> measureSettleKernels(std::size_t gridSize, float spacing);
+void printSettleKernels(const std::vector<SettleScalingResult> &results, std::size_t gridSize);
+
+struct SettleConvergenceResult {
+  SettleMode mode = SettleMode::Worklist;
+  double milliseconds = 0.0;
+  std::size_t passes = 0;
+  std::size_t cellsVisited = 0;
+  // furthest any pair of neighbours still stands past the angle of repose, 0 once settled
+  float steepestExcess = 0.0f;
+  double volumeDrift = 0.0;
+};
+
+// dumps one tall stockpile in the middle of the generated grid and times every solver settling
+// it completely, threads and level only apply to the parallel one
+std::vector<SettleConvergenceResult> measureStockpileConvergence(std::size_t gridSize,
+                                                                 float spacing,
+                                                                 std::size_t threads,
+                                                                 SimdLevel level);
+void printStockpileConvergence(const std::vector<SettleConvergenceResult> &results,
+                               std::size_t gridSize);
+
+// --self-check: checks every supported settle and stamp kernel against the scalar one and
+// prints the timings, returns the process exit code
+int runSelfCheck();
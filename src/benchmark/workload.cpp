@@ -0,0 +1,74 @@
+#include "workload.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "../simulation/terrain.h"
+
+namespace {
+// one lap of the site flight path per this many frames
+constexpr float SITE_LAP_FRAMES = 6000.0f;
+
+float siteFlightAngle(std::size_t frameIndex) {
+  return static_cast<float>(frameIndex) / SITE_LAP_FRAMES * 6.2831853f;
+}
+} // namespace
+
+glm::vec2 benchmarkBucketPosition(const Terrain &terrain, std::size_t frameIndex) {
+  return fleetBucketPosition(terrain, 0, 1, frameIndex);
+}
+
+TerrainAction benchmarkActionForFrame(std::size_t frameIndex) {
+  return fleetActionForFrame(0, frameIndex);
+}
+
+glm::vec2 fleetBucketPosition(const Terrain &terrain, std::size_t bucket, std::size_t fleetSize,
+                              std::size_t frameIndex) {
+  const float margin = terrain.spacing() * 6.0f;
+  const float traversableSpan = std::max(terrain.spacing(), terrain.worldExtent() - (2.0f * margin));
+  const float t = static_cast<float>(frameIndex);
+
+  // the site is split into a near-square grid of tiles and each bucket sweeps its own tile,
+  // so a fleet works separate patches the way machines on one site would
+  const std::size_t tilesPerSide =
+      static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(fleetSize))));
+  const float tileSpan = traversableSpan / static_cast<float>(tilesPerSide);
+  const float tileX = margin + static_cast<float>(bucket / tilesPerSide) * tileSpan;
+  const float tileZ = margin + static_cast<float>(bucket % tilesPerSide) * tileSpan;
+  // every bucket gets its own phase so they don't move in lockstep
+  const float phase = static_cast<float>(bucket) * 2.4f;
+
+  const float x = tileX + (0.5f + 0.5f * std::sin(t * 0.021f + phase)) * tileSpan;
+  const float z = tileZ + (0.5f + 0.5f * std::sin((t * 0.013f) + 1.1f + phase)) * tileSpan;
+  return {x, z};
+}
+
+TerrainAction fleetActionForFrame(std::size_t bucket, std::size_t frameIndex) {
+  constexpr std::size_t actionWindow = 240;
+  // staggered so roughly half the fleet digs while the other half dumps
+  const std::size_t shifted = frameIndex + bucket * (actionWindow / 2 + 7);
+  return ((shifted / actionWindow) % 2 == 0) ? TerrainAction::Dig : TerrainAction::Dump;
+}
+
+void fleetEdits(const Terrain &terrain, std::size_t fleetSize, std::size_t frameIndex,
+                std::vector<TerrainEdit> &edits) {
+  edits.clear();
+  for (std::size_t bucket = 0; bucket < fleetSize; ++bucket) {
+    const glm::vec2 position = fleetBucketPosition(terrain, bucket, fleetSize, frameIndex);
+    const auto [row, col] = terrain.worldToGrid(position.x, position.y);
+    const bool dig = fleetActionForFrame(bucket, frameIndex) == TerrainAction::Dig;
+    edits.push_back({row, col, dig});
+  }
+}
+
+glm::vec2 siteFlightPosition(float siteExtent, std::size_t frameIndex) {
+  const float angle = siteFlightAngle(frameIndex);
+  const float radius = siteExtent * 0.35f;
+  return glm::vec2(siteExtent * 0.5f + radius * std::cos(angle),
+                   siteExtent * 0.5f + radius * std::sin(angle));
+}
+
+glm::vec2 siteFlightHeading(std::size_t frameIndex) {
+  const float angle = siteFlightAngle(frameIndex);
+  return glm::vec2(-std::sin(angle), std::cos(angle));
+}
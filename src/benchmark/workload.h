@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <vector>
+
+class Terrain;
+struct TerrainEdit;
+
+// fixed simulation step so benchmark runs are deterministic regardless of frame rate
+constexpr float BENCHMARK_SIMULATION_DT = 1.0f / 120.0f;
+
+enum class TerrainAction { Dig, Dump };
+
+// scripted bucket path shared by the windowed and headless benchmarks
+glm::vec2 benchmarkBucketPosition(const Terrain &terrain, std::size_t frameIndex);
+TerrainAction benchmarkActionForFrame(std::size_t frameIndex);
+
+// --buckets=N: bucket 0 of a one-bucket fleet follows the benchmark path above
+glm::vec2 fleetBucketPosition(const Terrain &terrain, std::size_t bucket, std::size_t fleetSize,
+                              std::size_t frameIndex);
+TerrainAction fleetActionForFrame(std::size_t bucket, std::size_t frameIndex);
+// one edit per bucket for Terrain::modifyBatch, edits is cleared first
+void fleetEdits(const Terrain &terrain, std::size_t fleetSize, std::size_t frameIndex,
+                std::vector<TerrainEdit> &edits);
+
+// --site: a lap around the middle of a site siteExtent world units across, in site coordinates
+// the bucket and camera follow it, so the loaded window keeps moving
+glm::vec2 siteFlightPosition(float siteExtent, std::size_t frameIndex);
+// direction of travel along the lap at frameIndex, unit length
+glm::vec2 siteFlightHeading(std::size_t frameIndex);
@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+#include "benchmark/input_log.h"
+#include "benchmark/report.h"
+#include "benchmark/scenario.h"
+#include "benchmark/settle_scaling.h"
+#include "benchmark/workload.h"
+#include "options.h"
+#include "simulation/site_window.h"
+#include "simulation/terrain.h"
+#include "simulation/terrain_file.h"
+#include "simulation/tile_store.h"
+#include "telemetry/telemetry.h"
+#include "telemetry/trace.h"
+
+// replays the --benchmark workload against the simulation core only
+// no window, no GL context and no swap, so the numbers are pure terrain cost
+int main(int argc, char **argv) {
+  const auto processStart = std::chrono::steady_clock::now();
+  AppOptions options;
+  const ParseResult parseResult = parseArguments(argc, argv, options);
+  if (parseResult == ParseResult::ExitSuccess) {
+    return EXIT_SUCCESS;
+  }
+  if (parseResult == ParseResult::ExitFailure) {
+    return EXIT_FAILURE;
+  }
+  if (options.selfCheck) {
+    return runSelfCheck();
+  }
+  if (!options.recordPath.empty()) {
+    std::cerr << "--record needs the viewer, there's no operator input here\n";
+    return EXIT_FAILURE;
+  }
+  // the numbers would read as if these had taken effect
+  if (options.simThread) {
+    std::cerr << "--sim-thread needs the viewer, there is no render thread to split edits from\n";
+    return EXIT_FAILURE;
+  }
+  if (options.offscreen) {
+    std::cerr << "--offscreen needs the viewer, nothing is rendered here\n";
+    return EXIT_FAILURE;
+  }
+  if (!options.tracePath.empty() && !startTracing()) {
+    return EXIT_FAILURE;
+  }
+  InputReplay replay;
+  if (!options.replayPath.empty()) {
+    if (!replay.open(options.replayPath)) {
+      return EXIT_FAILURE;
+    }
+    applyReplaySession(replay, options);
+  }
+
+  // --load replaces the generated hills and decides the grid size and spacing
+  TerrainFile terrainFile;
+  if (!options.loadPath.empty() && !terrainFile.open(options.loadPath)) {
+    return EXIT_FAILURE;
+  }
+  // --site streams a bigger heightfield from disk, the terrain is only the window around the
+  // bucket and --grid its size
+  TileStore tileStore;
+  if (!options.sitePath.empty()) {
+    if (!std::filesystem::exists(options.sitePath) &&
+        !TileStore::create(options.sitePath, options.siteSize, TileStore::defaultTileSize(),
+                           options.spacing)) {
+      return EXIT_FAILURE;
+    }
+    if (!tileStore.open(options.sitePath, options.tileCacheMb << 20)) {
+      return EXIT_FAILURE;
+    }
+  }
+  std::size_t gridSize = options.gridSize;
+  float spacing = options.spacing;
+  if (!options.loadPath.empty()) {
+    gridSize = terrainFile.gridSize();
+    spacing = terrainFile.spacing();
+  } else if (!options.sitePath.empty()) {
+    gridSize = SiteWindow::windowSize(options.gridSize, tileStore);
+    spacing = tileStore.spacing();
+  }
+  Terrain terrain(gridSize, spacing, terrainFile.heights(), options.vertexFormat);
+  terrainFile.close();
+  const float siteExtent = static_cast<float>(tileStore.siteSize()) * spacing;
+  std::optional<SiteWindow> siteWindow;
+  if (!options.sitePath.empty()) {
+    siteWindow.emplace(tileStore, terrain, siteFlightPosition(siteExtent, 0));
+  }
+  if (!options.replayPath.empty() &&
+      heightfieldChecksum(terrain.heightData().data(), terrain.cellCount()) !=
+          replay.session().initialChecksum) {
+    std::cerr << "Can't replay " << options.replayPath
+              << ": it was recorded on a different starting terrain (check --load)\n";
+    return EXIT_FAILURE;
+  }
+  const double terrainReadyMs =
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - processStart)
+          .count();
+  terrain.setSettleMode(options.settleMode, options.settleThreads);
+  if (options.simdLevel) {
+    terrain.setSimdLevel(*options.simdLevel);
+  }
+  terrain.setUploadGap(options.uploadGap);
+  if (options.brushShape != BrushShape::Point) {
+    terrain.setBrush(Brush::fromShape(options.brushShape, options.brushSize));
+  }
+  std::vector<VertexRange> uploadRanges;
+  std::vector<TerrainEdit> fleet;
+
+  // every scenario starts from the terrain as loaded, so keep a copy when there's more than one
+  std::vector<Scenario> scenarios(std::max<std::size_t>(options.scenarios.size(), 1));
+  for (std::size_t i = 0; i < options.scenarios.size(); ++i) {
+    if (!scenarios[i].open(options.scenarios[i], options.seed)) {
+      return EXIT_FAILURE;
+    }
+  }
+  const std::vector<float> startHeights =
+      scenarios.size() > 1 ? terrain.heightData() : std::vector<float>();
+
+  const TerrainCompression compression =
+      options.compressSaves ? TerrainCompression::DeltaPlanes : TerrainCompression::None;
+  std::optional<TerrainAutosaver> autosaver;
+  if (options.autosaveSeconds > 0.0f) {
+    autosaver.emplace(options.savePath, terrain.gridSize(), terrain.spacing(), compression);
+  }
+  const std::chrono::duration<double> autosaveInterval(options.autosaveSeconds);
+  auto lastAutosave = std::chrono::steady_clock::now();
+  double firstFrameMs = 0.0;
+
+  for (std::size_t scenarioIndex = 0; scenarioIndex < scenarios.size(); ++scenarioIndex) {
+    const Scenario &scenario = scenarios[scenarioIndex];
+    if (scenarioIndex > 0) {
+      terrain.setHeights(startHeights);
+    }
+    RuntimeTelemetry telemetry;
+    telemetry.enableHistory();
+    telemetry.enableIntervals(options.reportInterval);
+
+    std::cout << "Headless benchmark: " << options.benchmarkFrames << " frames on a "
+              << terrain.gridSize() << "x" << terrain.gridSize() << " grid";
+    if (siteWindow) {
+      std::cout << " streamed from a " << tileStore.siteSize() << "x" << tileStore.siteSize()
+                << " site";
+    }
+    if (options.buckets > 1) {
+      std::cout << " with " << options.buckets << " buckets";
+    }
+    if (!options.scenarios.empty()) {
+      std::cout << ", scenario " << scenario.name();
+    }
+    std::cout << '\n';
+
+    const auto benchmarkStart = std::chrono::steady_clock::now();
+    std::size_t completedFrames = 0;
+    while (completedFrames < options.benchmarkFrames) {
+      TRACE_SCOPE("frame");
+      const auto frameStart = std::chrono::steady_clock::now();
+
+      TerrainUpdateStats frameTerrainStats;
+      // a replayed frame's own dt, so every edit moves the same soil it did when recorded
+      const InputFrame *input =
+          options.replayPath.empty() ? nullptr : &replay.frames()[completedFrames];
+      const float dt = input ? input->dt : BENCHMARK_SIMULATION_DT;
+      glm::vec2 sitePosition(0.0f);
+      if (siteWindow) {
+        // the window follows the flight path, reads ahead of it and moves when it strays
+        sitePosition = siteFlightPosition(siteExtent, completedFrames);
+        siteWindow->update(sitePosition - siteWindow->origin(),
+                           siteFlightHeading(completedFrames));
+      }
+      if (options.buckets > 1) {
+        fleetEdits(terrain, options.buckets, completedFrames, fleet);
+        accumulateTerrainStats(frameTerrainStats, terrain.modifyBatch(fleet, dt));
+      } else if (input) {
+        // same order as the viewer's E and Q keys
+        const auto [bucketRow, bucketCol] =
+            terrain.worldToGrid(input->bucket.x, input->bucket.y);
+        if (input->dig) {
+          accumulateTerrainStats(frameTerrainStats,
+                                 terrain.modify(bucketRow, bucketCol, true, dt));
+        }
+        if (input->dump) {
+          accumulateTerrainStats(frameTerrainStats,
+                                 terrain.modify(bucketRow, bucketCol, false, dt));
+        }
+      } else {
+        const glm::vec2 bucketPosition = siteWindow
+                                             ? sitePosition - siteWindow->origin()
+                                             : scenario.bucketPosition(terrain, completedFrames);
+        const auto [bucketRow, bucketCol] =
+            terrain.worldToGrid(bucketPosition.x, bucketPosition.y);
+        const bool dig = scenario.actionForFrame(completedFrames) == TerrainAction::Dig;
+        accumulateTerrainStats(frameTerrainStats, terrain.modify(bucketRow, bucketCol, dig,
+                                                                 BENCHMARK_SIMULATION_DT));
+      }
+      // nothing to upload to, but drain the ranges like the renderer would
+      terrain.takePendingUploads(uploadRanges);
+
+      const auto frameEnd = std::chrono::steady_clock::now();
+      telemetry.recordFrame(
+          std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+      telemetry.recordTerrainUpdate(frameTerrainStats);
+      if (siteWindow) {
+        telemetry.recordTileStream(tileStore.takeStats());
+      }
+      if (const std::optional<std::string> interval = telemetry.pollIntervalReport()) {
+        std::cout << *interval << '\n';
+      }
+      if (firstFrameMs == 0.0) {
+        firstFrameMs = std::chrono::duration<double, std::milli>(frameEnd - processStart).count();
+      }
+      ++completedFrames;
+
+      // the writer thread gets a copy, a save still in progress just pushes this one back
+      if (autosaver && frameEnd - lastAutosave >= autosaveInterval &&
+          autosaver->request(terrain.heightData())) {
+        lastAutosave = frameEnd;
+      }
+    }
+
+    const auto benchmarkEnd = std::chrono::steady_clock::now();
+    const bool lastScenario = scenarioIndex + 1 == scenarios.size();
+    if (lastScenario) {
+      // lets a save in progress finish before the final one replaces it
+      autosaver.reset();
+      if (!options.savePath.empty()) {
+        if (!saveTerrainFile(options.savePath, terrain.gridSize(), terrain.spacing(),
+                             terrain.heightData().data(), compression)) {
+          return EXIT_FAILURE;
+        }
+        std::cout << "Saved terrain to " << options.savePath << '\n';
+      }
+    }
+    if (siteWindow) {
+      // the last window's edits, and every dirty tile still in the cache
+      siteWindow->writeBack();
+      tileStore.flush();
+      const TileStreamStats closing = tileStore.takeStats();
+      telemetry.tileTotals.evictions += closing.evictions;
+      telemetry.tileTotals.writebacks += closing.writebacks;
+    }
+
+    BenchmarkRunInfo run;
+    run.completedFrames = completedFrames;
+    run.wallSeconds = std::chrono::duration<double>(benchmarkEnd - benchmarkStart).count();
+    run.gridSize = terrain.gridSize();
+    run.spacing = terrain.spacing();
+    run.settleMode = settleModeName(terrain.getSettleMode());
+    run.settleThreads = terrain.getSettleThreads();
+    run.settleKernel = simdLevelName(terrain.getSimdLevel());
+    run.uploadGap = terrain.getUploadGap();
+    run.vertexFormat = vertexFormatName(terrain.getVertexFormat());
+    run.vertexBytes = terrain.uploadVertexBytes();
+    run.buckets = options.buckets;
+    if (const std::optional<Brush> &footprint = terrain.getBrush()) {
+      run.brush = brushShapeName(options.brushShape);
+      run.brushSize = options.brushSize;
+      run.brushCells = footprint->cellCount();
+    }
+    run.terrainSource = !options.loadPath.empty()   ? options.loadPath
+                        : !options.sitePath.empty() ? options.sitePath
+                                                    : "generated";
+    run.terrainReadyMs = terrainReadyMs;
+    run.firstFrameMs = firstFrameMs;
+    if (!options.replayPath.empty()) {
+      run.input = options.replayPath;
+    }
+    run.scenario = scenario.name();
+    run.seed = options.seed;
+    run.seeded = scenario.seeded();
+    run.heightChecksum = heightfieldChecksum(terrain.heightData().data(), terrain.cellCount());
+    run.steepestExcess = terrain.steepestExcess();
+    if (siteWindow) {
+      run.siteSize = tileStore.siteSize();
+      run.tileCacheBytes = tileStore.budgetBytes();
+      run.tilePeakBytes = tileStore.peakResidentBytes();
+      run.windowRecentres = siteWindow->recentres();
+    }
+    printBenchmarkSummary(telemetry, run);
+    if (options.writeCsv && !writeBenchmarkCsv(options.csvPath, telemetry, run)) {
+      return EXIT_FAILURE;
+    }
+    if (options.checkSettled && !terrain.settled()) {
+      std::cerr << "The terrain didn't settle: a slope stands " << *run.steepestExcess
+                << " past the repose difference of " << terrain.reposeDifference() << "\n";
+      return EXIT_FAILURE;
+    }
+  }
+  // before the scaling runs below, which aren't part of the workload
+  if (!options.tracePath.empty() && !writeTrace(options.tracePath)) {
+    return EXIT_FAILURE;
+  }
+  if (options.settleMode == SettleMode::Parallel) {
+    printSettleScaling(measureSettleScaling(terrain.gridSize(), terrain.spacing(),
+                                            terrain.getSettleThreads(), terrain.getSimdLevel()),
+                       terrain.gridSize());
+  }
+  // a stockpile run also gets every solver timed settling one big dump all the way
+  if (std::any_of(scenarios.begin(), scenarios.end(),
+                  [](const Scenario &scenario) { return scenario.name() == "stockpile"; })) {
+    printStockpileConvergence(measureStockpileConvergence(terrain.gridSize(), terrain.spacing(),
+                                                          terrain.getSettleThreads(),
+                                                          terrain.getSimdLevel()),
+                              terrain.gridSize());
+  }
+  return EXIT_SUCCESS;
+}
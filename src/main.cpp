@@ -1,9 +1,7 @@
 #include <algorithm>
 #include <array>
 #include <chrono>
-#include <cmath>
 #include <filesystem>
-#include <fstream>
 #include <glad/gl.h>
 
 #include <GLFW/glfw3.h>
@@ -15,376 +13,51 @@
 #include "glm/ext/matrix_clip_space.hpp"
 #include "glm/ext/matrix_float4x4.hpp"
 #include "glm/trigonometric.hpp"
+#include "benchmark/input_log.h"
+#include "benchmark/report.h"
+#include "benchmark/scenario.h"
+#include "benchmark/settle_scaling.h"
+#include "benchmark/workload.h"
+#include "options.h"
 #include "rendering/camera.h"
+#include "rendering/gpu_timer.h"
+#include "rendering/offscreen_target.h"
 #include "rendering/shader.h"
+#include "rendering/terrain_renderer.h"
+#include "simulation/sim_thread.h"
+#include "simulation/site_window.h"
 #include "simulation/terrain.h"
+#include "simulation/terrain_file.h"
+#include "simulation/tile_store.h"
+#include "telemetry/telemetry.h"
+#include "telemetry/trace.h"
 #include <cstdlib>
-#include <iomanip>
 #include <iostream>
-#include <numeric>
+#include <optional>
 #include <sstream>
 #include <string>
-#include <string_view>
 #include <vector>
 
 // anon namespace instead of static functions
 namespace {
 constexpr char WINDOW_TITLE[] = "Excavation Simulator";
-constexpr std::size_t METRIC_WINDOW = 240;
-constexpr float BENCHMARK_SIMULATION_DT = 1.0f / 120.0f;
 
-struct AppOptions {
-  bool benchmarkMode = false;
-  bool disableVsync = false;
-  bool writeCsv = false;
-  std::size_t benchmarkFrames = 3000;
-  std::string csvPath;
-};
-
-struct MetricSummary {
-  double average = 0.0;
-  double p95 = 0.0;
-  double maximum = 0.0;
-};
-
-struct RollingMetric {
-  std::array<double, METRIC_WINDOW> values{};
-  std::size_t count = 0;
-  std::size_t next = 0;
-  double sum = 0.0;
-
-  void add(double value) {
-    if (count < values.size()) {
-      values[next] = value;
-      sum += value;
-      ++count;
-      next = (next + 1) % values.size();
-      return;
-    }
-
-    sum -= values[next];
-    values[next] = value;
-    sum += value;
-    next = (next + 1) % values.size();
-  }
-
-  bool empty() const { return count == 0; }
-
-  double average() const {
-    if (count == 0) {
-      return 0.0;
-    }
-    return sum / static_cast<double>(count);
-  }
-
-  double percentile(double percentileValue) const {
-    if (count == 0) {
-      return 0.0;
-    }
-
-    std::vector<double> samples(values.begin(), values.begin() + static_cast<long>(count));
-    std::sort(samples.begin(), samples.end());
-    const double clamped = std::clamp(percentileValue, 0.0, 1.0);
-    const std::size_t index =
-        static_cast<std::size_t>(clamped * static_cast<double>(samples.size() - 1));
-    return samples[index];
-  }
-};
-
-std::string formatBytes(double bytes) {
-  std::ostringstream formatted;
-  formatted << std::fixed;
-
-  if (bytes >= 1024.0 * 1024.0) {
-    formatted << std::setprecision(2) << (bytes / (1024.0 * 1024.0)) << " MiB";
-    return formatted.str();
-  }
-
-  if (bytes >= 1024.0) {
-    formatted << std::setprecision(1) << (bytes / 1024.0) << " KiB";
-    return formatted.str();
-  }
-
-  formatted << std::setprecision(0) << bytes << " B";
-  return formatted.str();
-}
-
-void accumulateTerrainStats(TerrainUpdateStats &aggregate, const TerrainUpdateStats &sample) {
-  if (!sample.updated) {
-    return;
-  }
-
-  aggregate.updated = true;
-  aggregate.cpuMs += sample.cpuMs;
-  aggregate.dirtyVertices += sample.dirtyVertices;
-  aggregate.uploadBytes += sample.uploadBytes;
-  aggregate.stabilizationPasses += sample.stabilizationPasses;
-}
-
-struct RuntimeTelemetry {
-  RollingMetric frameMs;
-  RollingMetric terrainMs;
-  RollingMetric dirtyVertices;
-  RollingMetric uploadBytes;
-  RollingMetric stabilizationPasses;
-  bool captureHistory = false;
-  std::vector<double> frameHistory;
-  std::vector<double> terrainHistory;
-  std::vector<double> dirtyVertexHistory;
-  std::vector<double> uploadByteHistory;
-  std::vector<double> stabilizationPassHistory;
-  std::size_t framesSinceTitleUpdate = 0;
-  double lastTitleUpdateTime = 0.0;
-
-  void enableHistory(std::size_t expectedFrames) {
-    captureHistory = true;
-    frameHistory.reserve(expectedFrames);
-    terrainHistory.reserve(expectedFrames);
-    dirtyVertexHistory.reserve(expectedFrames);
-    uploadByteHistory.reserve(expectedFrames);
-    stabilizationPassHistory.reserve(expectedFrames);
-  }
-
-  void recordFrame(double sampleMs) {
-    frameMs.add(sampleMs);
-    ++framesSinceTitleUpdate;
-    if (captureHistory) {
-      frameHistory.push_back(sampleMs);
-    }
-  }
-
-  void recordTerrainUpdate(const TerrainUpdateStats &stats) {
-    if (!stats.updated) {
-      return;
-    }
-
-    terrainMs.add(stats.cpuMs);
-    dirtyVertices.add(static_cast<double>(stats.dirtyVertices));
-    uploadBytes.add(static_cast<double>(stats.uploadBytes));
-    stabilizationPasses.add(static_cast<double>(stats.stabilizationPasses));
-    if (captureHistory) {
-      terrainHistory.push_back(stats.cpuMs);
-      dirtyVertexHistory.push_back(static_cast<double>(stats.dirtyVertices));
-      uploadByteHistory.push_back(static_cast<double>(stats.uploadBytes));
-      stabilizationPassHistory.push_back(static_cast<double>(stats.stabilizationPasses));
-    }
-  }
-
-  void updateWindowTitle(GLFWwindow *window, double now, std::string_view titlePrefix) {
-    if (lastTitleUpdateTime == 0.0) {
-      lastTitleUpdateTime = now;
-      return;
-    }
-
-    const double elapsed = now - lastTitleUpdateTime;
-    if (elapsed < 1.0 || framesSinceTitleUpdate == 0) {
-      return;
-    }
-
-    const double fps = static_cast<double>(framesSinceTitleUpdate) / elapsed;
-    std::ostringstream title;
-    title << std::fixed << std::setprecision(1);
-    title << titlePrefix << " | " << fps << " FPS";
-    title << " | frame " << frameMs.average() << " ms avg / " << frameMs.percentile(0.95)
-          << " p95";
-
-    if (terrainMs.empty()) {
-      title << " | terrain idle";
-    } else {
-      title << " | terrain " << terrainMs.average() << " ms";
-      title << " | dirty " << std::setprecision(0) << dirtyVertices.average();
-      title << " | upload " << formatBytes(uploadBytes.average());
-      title << " | passes " << std::setprecision(1) << stabilizationPasses.average();
-    }
-
-    glfwSetWindowTitle(window, title.str().c_str());
-    lastTitleUpdateTime = now;
-    framesSinceTitleUpdate = 0;
-  }
-};
-
-enum class ParseResult { Continue, ExitSuccess, ExitFailure };
-
-enum class TerrainAction { Dig, Dump };
-
-void printUsage(const char *programName) {
-  std::cout << "Usage: " << programName
-            << " [--benchmark] [--frames=N] [--no-vsync] [--csv=PATH]\n";
-}
-
-bool parsePositiveSize(std::string_view value, std::size_t &parsed) {
-  if (value.empty()) {
-    return false;
-  }
-
-  char *end = nullptr;
-  const unsigned long long raw = std::strtoull(value.data(), &end, 10);
-  if (end == value.data() || (end != nullptr && *end != '\0') || raw == 0) {
-    return false;
-  }
-
-  parsed = static_cast<std::size_t>(raw);
-  return true;
-}
-
-ParseResult parseArguments(int argc, char **argv, AppOptions &options) {
-  for (int i = 1; i < argc; ++i) {
-    const std::string argument = argv[i];
-    if (argument == "--help") {
-      printUsage(argv[0]);
-      return ParseResult::ExitSuccess;
-    }
-
-    if (argument == "--benchmark") {
-      options.benchmarkMode = true;
-      continue;
-    }
-
-    if (argument == "--no-vsync") {
-      options.disableVsync = true;
-      continue;
-    }
-
-    if (argument.rfind("--frames=", 0) == 0) {
-      const std::string value = argument.substr(9);
-      if (!parsePositiveSize(value, options.benchmarkFrames)) {
-        std::cerr << "Invalid --frames value: " << value << "\n";
-        printUsage(argv[0]);
-        return ParseResult::ExitFailure;
-      }
-      continue;
-    }
-
-    if (argument.rfind("--csv=", 0) == 0) {
-      options.csvPath = argument.substr(6);
-      options.writeCsv = !options.csvPath.empty();
-      if (!options.writeCsv) {
-        std::cerr << "Invalid --csv value\n";
-        printUsage(argv[0]);
-        return ParseResult::ExitFailure;
-      }
-      continue;
-    }
-
-    std::cerr << "Unknown argument: " << argument << "\n";
-    printUsage(argv[0]);
-    return ParseResult::ExitFailure;
-  }
-
-  return ParseResult::Continue;
-}
-
-MetricSummary summarizeSamples(const std::vector<double> &samples) {
-  MetricSummary summary;
-  if (samples.empty()) {
-    return summary;
-  }
-
-  const double sum = std::accumulate(samples.begin(), samples.end(), 0.0);
-  summary.average = sum / static_cast<double>(samples.size());
-
-  std::vector<double> sortedSamples = samples;
-  std::sort(sortedSamples.begin(), sortedSamples.end());
-  const std::size_t percentileIndex =
-      static_cast<std::size_t>(0.95 * static_cast<double>(sortedSamples.size() - 1));
-  summary.p95 = sortedSamples[percentileIndex];
-  summary.maximum = sortedSamples.back();
-  return summary;
-}
-
-glm::vec2 benchmarkBucketPosition(std::size_t frameIndex) {
-  constexpr float margin = Terrain::spacing() * 6.0f;
-  const float traversableSpan = std::max(Terrain::spacing(), Terrain::worldExtent() - (2.0f * margin));
-  const float t = static_cast<float>(frameIndex);
-
-  const float x = margin + (0.5f + 0.5f * std::sin(t * 0.021f)) * traversableSpan;
-  const float z = margin + (0.5f + 0.5f * std::sin((t * 0.013f) + 1.1f)) * traversableSpan;
-  return {x, z};
-}
-
-TerrainAction benchmarkActionForFrame(std::size_t frameIndex) {
-  constexpr std::size_t actionWindow = 240;
-  return ((frameIndex / actionWindow) % 2 == 0) ? TerrainAction::Dig : TerrainAction::Dump;
-}
-
-std::string buildWindowTitlePrefix(const AppOptions &options, std::size_t completedFrames) {
+// scenario is left out when the run didn't ask for one
+std::string buildWindowTitlePrefix(const AppOptions &options, const std::string &scenario,
+                                   std::size_t completedFrames) {
   if (!options.benchmarkMode) {
     return WINDOW_TITLE;
   }
 
   std::ostringstream prefix;
-  prefix << WINDOW_TITLE << " [benchmark " << completedFrames << "/" << options.benchmarkFrames
-         << "]";
+  prefix << WINDOW_TITLE << " [benchmark ";
+  if (!scenario.empty()) {
+    prefix << scenario << ' ';
+  }
+  prefix << completedFrames << "/" << options.benchmarkFrames << "]";
   return prefix.str();
 }
 
-void printBenchmarkSummary(const RuntimeTelemetry &telemetry, double wallSeconds,
-                           std::size_t completedFrames) {
-  const MetricSummary frameSummary = summarizeSamples(telemetry.frameHistory);
-  const MetricSummary terrainSummary = summarizeSamples(telemetry.terrainHistory);
-  const MetricSummary dirtySummary = summarizeSamples(telemetry.dirtyVertexHistory);
-  const MetricSummary uploadSummary = summarizeSamples(telemetry.uploadByteHistory);
-  const MetricSummary passSummary = summarizeSamples(telemetry.stabilizationPassHistory);
-  const double averageFps =
-      wallSeconds > 0.0 ? static_cast<double>(completedFrames) / wallSeconds : 0.0;
-
-  std::cout << "\nBenchmark Summary\n";
-  std::cout << "Frames: " << completedFrames << '\n';
-  std::cout << std::fixed << std::setprecision(2);
-  std::cout << "Wall time: " << wallSeconds << " s\n";
-  std::cout << "Average FPS: " << averageFps << '\n';
-  std::cout << "Frame time: avg " << frameSummary.average << " ms | p95 " << frameSummary.p95
-            << " ms | max " << frameSummary.maximum << " ms\n";
-  std::cout << "Terrain update: avg " << terrainSummary.average << " ms | p95 "
-            << terrainSummary.p95 << " ms | max " << terrainSummary.maximum << " ms\n";
-  std::cout << "Dirty vertices/update: avg " << dirtySummary.average << " | p95 "
-            << dirtySummary.p95 << " | max " << dirtySummary.maximum << '\n';
-  std::cout << "Upload bytes/update: avg " << uploadSummary.average << " | p95 "
-            << uploadSummary.p95 << " | max " << uploadSummary.maximum << '\n';
-  std::cout << "Stabilization passes/update: avg " << passSummary.average << " | p95 "
-            << passSummary.p95 << " | max " << passSummary.maximum << "\n";
-}
-
-bool writeBenchmarkCsv(const AppOptions &options, const RuntimeTelemetry &telemetry, double wallSeconds,
-                       std::size_t completedFrames) {
-  const std::filesystem::path csvPath(options.csvPath);
-  if (!csvPath.parent_path().empty()) {
-    std::filesystem::create_directories(csvPath.parent_path());
-  }
-
-  const bool needsHeader = !std::filesystem::exists(csvPath) || std::filesystem::file_size(csvPath) == 0;
-  std::ofstream output(csvPath, std::ios::app);
-  if (!output.is_open()) {
-    std::cerr << "Failed to open CSV output: " << options.csvPath << "\n";
-    return false;
-  }
-
-  const MetricSummary frameSummary = summarizeSamples(telemetry.frameHistory);
-  const MetricSummary terrainSummary = summarizeSamples(telemetry.terrainHistory);
-  const MetricSummary dirtySummary = summarizeSamples(telemetry.dirtyVertexHistory);
-  const MetricSummary uploadSummary = summarizeSamples(telemetry.uploadByteHistory);
-  const MetricSummary passSummary = summarizeSamples(telemetry.stabilizationPassHistory);
-  const double averageFps =
-      wallSeconds > 0.0 ? static_cast<double>(completedFrames) / wallSeconds : 0.0;
-
-  if (needsHeader) {
-    output << "frames,wall_seconds,avg_fps,avg_frame_ms,p95_frame_ms,max_frame_ms,"
-              "avg_terrain_ms,p95_terrain_ms,max_terrain_ms,"
-              "avg_dirty_vertices,p95_dirty_vertices,max_dirty_vertices,"
-              "avg_upload_bytes,p95_upload_bytes,max_upload_bytes,"
-              "avg_stabilization_passes,p95_stabilization_passes,max_stabilization_passes\n";
-  }
-
-  output << completedFrames << ',' << wallSeconds << ',' << averageFps << ','
-         << frameSummary.average << ',' << frameSummary.p95 << ',' << frameSummary.maximum << ','
-         << terrainSummary.average << ',' << terrainSummary.p95 << ',' << terrainSummary.maximum
-         << ',' << dirtySummary.average << ',' << dirtySummary.p95 << ',' << dirtySummary.maximum
-         << ',' << uploadSummary.average << ',' << uploadSummary.p95 << ','
-         << uploadSummary.maximum << ',' << passSummary.average << ',' << passSummary.p95 << ','
-         << passSummary.maximum << '\n';
-  return true;
-}
-
 // just called on errors
 void errorCallback(int error, const char *description) {
   std::cerr << "GLFW error " << error << ": " << description << "\n";
@@ -428,6 +101,7 @@ void cursorPosCallBack(GLFWwindow *window, double xpos, double ypos) {
 } // namespace
 
 int main(int argc, char **argv) {
+  const auto processStart = std::chrono::steady_clock::now();
   AppOptions options;
   const ParseResult parseResult = parseArguments(argc, argv, options);
   if (parseResult == ParseResult::ExitSuccess) {
@@ -436,10 +110,45 @@ int main(int argc, char **argv) {
   if (parseResult == ParseResult::ExitFailure) {
     return EXIT_FAILURE;
   }
+  if (options.selfCheck) {
+    return runSelfCheck();
+  }
+  if (options.checkSettled) {
+    std::cerr << "--check-settled is only checked by the headless benchmark\n";
+    return EXIT_FAILURE;
+  }
+  if (!options.tracePath.empty() && !startTracing()) {
+    return EXIT_FAILURE;
+  }
+  InputReplay replay;
+  if (!options.replayPath.empty()) {
+    if (!replay.open(options.replayPath)) {
+      return EXIT_FAILURE;
+    }
+    applyReplaySession(replay, options);
+  }
+  std::vector<Scenario> scenarios(std::max<std::size_t>(options.scenarios.size(), 1));
+  for (std::size_t i = 0; i < options.scenarios.size(); ++i) {
+    if (!scenarios[i].open(options.scenarios[i], options.seed)) {
+      return EXIT_FAILURE;
+    }
+  }
+  std::size_t scenarioIndex = 0;
 
   glfwSetErrorCallback(errorCallback);
   constexpr float BUCKET_SPEED = 2.0f;
 
+  // --offscreen with no display to open a window on: GLFW's null platform and a surfaceless EGL
+  // context, which Mesa provides (llvmpipe included)
+  bool surfaceless = false;
+#if defined(__linux__)
+  if (options.offscreen && std::getenv("DISPLAY") == nullptr &&
+      std::getenv("WAYLAND_DISPLAY") == nullptr) {
+    glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    surfaceless = true;
+  }
+#endif
+
   if (!glfwInit()) {
     std::cerr << "Failed to initialize GLFW\n";
     return EXIT_FAILURE;
@@ -452,6 +161,12 @@ int main(int argc, char **argv) {
 #ifdef __APPLE__
   glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
+  if (options.offscreen) {
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    if (surfaceless) {
+      glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+    }
+  }
 
   GLFWwindow *window = glfwCreateWindow(1280, 720, WINDOW_TITLE, nullptr, nullptr);
   if (!window) {
@@ -461,10 +176,13 @@ int main(int argc, char **argv) {
   }
 
   glfwMakeContextCurrent(window);
-  const int swapInterval = (options.disableVsync || options.benchmarkMode) ? 0 : 1;
-  glfwSwapInterval(swapInterval);
+  // an offscreen run never swaps, and its viewport is the framebuffer object's
+  if (!options.offscreen) {
+    const int swapInterval = (options.disableVsync || options.benchmarkMode) ? 0 : 1;
+    glfwSwapInterval(swapInterval);
+    glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
+  }
   glfwSetKeyCallback(window, keyCallback);
-  glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
 
   Camera camera;
   // so that you can access the camera in the cursor pos callback
@@ -489,6 +207,19 @@ int main(int argc, char **argv) {
             << '\n';
   std::cout << "Renderer: " << glGetString(GL_RENDERER) << '\n';
 
+  OffscreenTarget offscreenTarget;
+  if (options.offscreen) {
+    if (!offscreenTarget.create(static_cast<GLsizei>(options.offscreenWidth),
+                                static_cast<GLsizei>(options.offscreenHeight))) {
+      glfwTerminate();
+      return EXIT_FAILURE;
+    }
+    offscreenTarget.bind();
+    std::cout << "Rendering offscreen at " << options.offscreenWidth << "x"
+              << options.offscreenHeight << " ("
+              << (surfaceless ? "surfaceless EGL" : "hidden window") << ")\n";
+  }
+
   glEnable(GL_DEPTH_TEST);
 
   // set background colour
@@ -539,7 +270,7 @@ int main(int argc, char **argv) {
   };
   // clang-format on
 
-  GLuint bucketVAO, bucketVBO, bucketEBO;
+  GLuint bucketVAO, bucketVBO, bucketEBO, bucketInstanceVBO;
 
   glGenVertexArrays(1, &bucketVAO);
   glBindVertexArray(bucketVAO);
@@ -562,40 +293,245 @@ int main(int argc, char **argv) {
   glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
   glEnableVertexAttribArray(1);
 
+  // one offset per bucket, every bucket in the fleet is a single instanced draw
+  glGenBuffers(1, &bucketInstanceVBO);
+  glBindBuffer(GL_ARRAY_BUFFER, bucketInstanceVBO);
+  glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)0);
+  glEnableVertexAttribArray(2);
+  glVertexAttribDivisor(2, 1);
+
   // using shader class and giving path to shader code
   Shader basic_shader("shaders/basic.vert", "shaders/basic.frag");
+  Shader bucketShader("shaders/bucket.vert", "shaders/basic.frag");
 
-  Terrain terrain;
+  // --load replaces the generated hills and decides the grid size and spacing
+  TerrainFile terrainFile;
+  if (!options.loadPath.empty() && !terrainFile.open(options.loadPath)) {
+    glfwTerminate();
+    return EXIT_FAILURE;
+  }
+  // --site streams a bigger heightfield from disk, the terrain is only the window around the
+  // camera and --grid its size
+  TileStore tileStore;
+  if (!options.sitePath.empty()) {
+    if ((!std::filesystem::exists(options.sitePath) &&
+         !TileStore::create(options.sitePath, options.siteSize, TileStore::defaultTileSize(),
+                            options.spacing)) ||
+        !tileStore.open(options.sitePath, options.tileCacheMb << 20)) {
+      glfwTerminate();
+      return EXIT_FAILURE;
+    }
+  }
+  std::size_t gridSize = options.gridSize;
+  float spacing = options.spacing;
+  if (!options.loadPath.empty()) {
+    gridSize = terrainFile.gridSize();
+    spacing = terrainFile.spacing();
+  } else if (!options.sitePath.empty()) {
+    gridSize = SiteWindow::windowSize(options.gridSize, tileStore);
+    spacing = tileStore.spacing();
+  }
+  VertexFormat vertexFormat = options.vertexFormat;
+  const std::size_t heightCopies = options.uploadPath == UploadPath::Ring ? 3 : 1;
+  if (vertexFormat == VertexFormat::Height &&
+      static_cast<std::size_t>(TerrainRenderer::maxHeightTexels()) <
+          gridSize * gridSize * heightCopies) {
+    std::cerr << "Grid too large for a height buffer texture, using --vertex-format=full\n";
+    vertexFormat = VertexFormat::Full;
+  }
+  Terrain terrain(gridSize, spacing, terrainFile.heights(), vertexFormat);
+  terrainFile.close();
+  const float siteExtent = static_cast<float>(tileStore.siteSize()) * spacing;
+  std::optional<SiteWindow> siteWindow;
+  if (!options.sitePath.empty()) {
+    siteWindow.emplace(tileStore, terrain, siteFlightPosition(siteExtent, 0));
+  }
+  const double terrainReadyMs =
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - processStart)
+          .count();
+  terrain.setSettleMode(options.settleMode, options.settleThreads);
+  if (options.simdLevel) {
+    terrain.setSimdLevel(*options.simdLevel);
+  }
+  terrain.setUploadGap(options.uploadGap);
+  if (options.brushShape != BrushShape::Point) {
+    terrain.setBrush(Brush::fromShape(options.brushShape, options.brushSize));
+  }
+  const std::uint64_t initialChecksum =
+      heightfieldChecksum(terrain.heightData().data(), terrain.cellCount());
+  if (!options.replayPath.empty() && initialChecksum != replay.session().initialChecksum) {
+    std::cerr << "Can't replay " << options.replayPath
+              << ": it was recorded on a different starting terrain (check --load)\n";
+    glfwTerminate();
+    return EXIT_FAILURE;
+  }
+  InputRecorder recorder;
+  if (!options.recordPath.empty()) {
+    InputSession session;
+    session.gridSize = terrain.gridSize();
+    session.spacing = terrain.spacing();
+    session.buckets = options.buckets;
+    session.brush = options.brushShape;
+    session.brushSize = options.brushShape == BrushShape::Point ? 0 : options.brushSize;
+    session.initialChecksum = initialChecksum;
+    if (!recorder.open(options.recordPath, session)) {
+      glfwTerminate();
+      return EXIT_FAILURE;
+    }
+  }
+  TerrainRenderer terrainRenderer(terrain, options.uploadPath);
+  terrainRenderer.setLodDistance(options.lodDistance);
+  // height-only and packed vertices are expanded on the GPU by their own vertex shaders
+  std::optional<Shader> formatShader;
+  if (vertexFormat == VertexFormat::Height) {
+    formatShader.emplace("shaders/terrain_height.vert", "shaders/basic.frag");
+  } else if (vertexFormat == VertexFormat::Packed) {
+    formatShader.emplace("shaders/terrain_packed.vert", "shaders/basic.frag");
+  }
+  Shader &terrainShader = formatShader ? *formatShader : basic_shader;
+  // what the terrain and bucket draws cost on the GPU, the CPU side can't see that
+  GpuTimer terrainGpuTimer;
+  GpuTimer bucketGpuTimer;
+  // reused every frame so draining the dirty ranges doesn't allocate
+  std::vector<VertexRange> uploadRanges;
+  // with --sim-thread the terrain is only touched by that thread from here until reset(),
+  // this thread draws from its snapshots and sends it the bucket state
+  std::optional<SimulationThread> simulation;
+  if (options.simThread) {
+    simulation.emplace(terrain, BENCHMARK_SIMULATION_DT, options.buckets);
+  }
+  // --buckets scripts every bucket, the arrow keys and E/Q only drive a lone one
+  const bool fleetMode = options.buckets > 1;
+  std::vector<TerrainEdit> fleetBatch;
+  std::vector<glm::vec3> bucketOffsets(options.buckets);
+  std::size_t fleetFrame = 0;
+
+  const TerrainCompression compression =
+      options.compressSaves ? TerrainCompression::DeltaPlanes : TerrainCompression::None;
+  std::optional<TerrainAutosaver> autosaver;
+  if (options.autosaveSeconds > 0.0f) {
+    autosaver.emplace(options.savePath, terrain.gridSize(), terrain.spacing(), compression);
+  }
+  const std::chrono::duration<double> autosaveInterval(options.autosaveSeconds);
+  auto lastAutosave = std::chrono::steady_clock::now();
+  double firstFrameMs = 0.0;
 
   // this includes the view matrix
   // perspective matrix deals with converting 3d coordinates to 2d output (to screen)
-  glm::mat4 perspective = glm::perspective(glm::radians(45.0f), 1280.0f / 720.0f, 0.1f, 100.0f);
+  // far plane grows with the site so large grids aren't clipped
+  const float farPlane = std::max(100.0f, terrain.worldExtent() * 2.0f);
+  const float aspect = options.offscreen ? static_cast<float>(options.offscreenWidth) /
+                                               static_cast<float>(options.offscreenHeight)
+                                         : 1280.0f / 720.0f;
+  glm::mat4 perspective = glm::perspective(glm::radians(45.0f), aspect, 0.1f, farPlane);
   // perspective takes in fov, aspect ratio, when to clip a close object, when to clip a far object
 
   glm::vec3 bucketPos(1.5f, 0.5f, -1.5f);
+  // with --site everything starts where the scripted flight does, camera looking up +z at it
+  glm::vec2 lastCameraXZ(0.0f);
+  if (siteWindow) {
+    const glm::vec2 start = siteFlightPosition(siteExtent, 0) - siteWindow->origin();
+    bucketPos = glm::vec3(start.x, 0.5f, start.y);
+    camera.setPosition(glm::vec3(start.x, 12.0f, start.y - 15.0f));
+    lastCameraXZ = glm::vec2(start.x, start.y - 15.0f);
+  }
 
   RuntimeTelemetry telemetry;
   if (options.benchmarkMode) {
-    telemetry.enableHistory(options.benchmarkFrames);
+    telemetry.enableHistory();
   }
+  telemetry.enableIntervals(options.reportInterval);
+  // every scenario starts from the terrain as loaded, so keep a copy when there's more than one
+  const std::vector<float> startHeights =
+      scenarios.size() > 1 ? terrain.heightData() : std::vector<float>();
 
-  const auto benchmarkStart = std::chrono::steady_clock::now();
+  auto benchmarkStart = std::chrono::steady_clock::now();
   std::size_t benchmarkFramesCompleted = 0;
+
+  // prints the summary and CSV row of the scenario that just finished
+  const auto reportBenchmark = [&] {
+    const auto benchmarkEnd = std::chrono::steady_clock::now();
+    BenchmarkRunInfo run;
+    run.completedFrames = benchmarkFramesCompleted;
+    run.wallSeconds = std::chrono::duration<double>(benchmarkEnd - benchmarkStart).count();
+    run.gridSize = terrain.gridSize();
+    run.spacing = terrain.spacing();
+    run.settleMode = settleModeName(terrain.getSettleMode());
+    run.settleThreads = terrain.getSettleThreads();
+    run.settleKernel = simdLevelName(terrain.getSimdLevel());
+    run.uploadGap = terrain.getUploadGap();
+    run.uploadPath = uploadPathName(terrainRenderer.getUploadPath());
+    run.vertexFormat = vertexFormatName(terrain.getVertexFormat());
+    run.vertexBytes = terrain.uploadVertexBytes();
+    run.simThread = options.simThread;
+    run.buckets = options.buckets;
+    if (const std::optional<Brush> &footprint = terrain.getBrush()) {
+      run.brush = brushShapeName(options.brushShape);
+      run.brushSize = options.brushSize;
+      run.brushCells = footprint->cellCount();
+    }
+    run.terrainSource = !options.loadPath.empty()   ? options.loadPath
+                        : !options.sitePath.empty() ? options.sitePath
+                                                    : "generated";
+    run.terrainReadyMs = terrainReadyMs;
+    run.firstFrameMs = firstFrameMs;
+    if (!options.replayPath.empty()) {
+      run.input = options.replayPath;
+    }
+    run.scenario = scenarios[scenarioIndex].name();
+    run.seed = options.seed;
+    run.seeded = scenarios[scenarioIndex].seeded();
+    run.heightChecksum = heightfieldChecksum(terrain.heightData().data(), terrain.cellCount());
+    int framebufferWidth = 0;
+    int framebufferHeight = 0;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    run.renderTarget = options.offscreen ? "offscreen" : "window";
+    run.renderWidth = options.offscreen ? options.offscreenWidth
+                                        : static_cast<std::size_t>(framebufferWidth);
+    run.renderHeight = options.offscreen ? options.offscreenHeight
+                                         : static_cast<std::size_t>(framebufferHeight);
+    if (options.offscreen) {
+      run.renderContext = surfaceless ? "surfaceless EGL" : "hidden window";
+    }
+    if (siteWindow) {
+      run.siteSize = tileStore.siteSize();
+      run.tileCacheBytes = tileStore.budgetBytes();
+      run.tilePeakBytes = tileStore.peakResidentBytes();
+      run.windowRecentres = siteWindow->recentres();
+    }
+    printBenchmarkSummary(telemetry, run);
+    if (options.writeCsv) {
+      writeBenchmarkCsv(options.csvPath, telemetry, run);
+    }
+  };
   double lastTime = glfwGetTime();
 
   // this is the main render loop that runs 60 times per second (60FPS)
   while (!glfwWindowShouldClose(window)) {
+    TRACE_SCOPE("frame");
     const auto frameStart = std::chrono::steady_clock::now();
 
     // implement delta time so movements aren't frame dependent
     const double currentTime = glfwGetTime();
     const float realDeltaTime = static_cast<float>(currentTime - lastTime);
     lastTime = currentTime;
-    const float deltaTime = options.benchmarkMode ? BENCHMARK_SIMULATION_DT : realDeltaTime;
+    // --replay puts back the recorded frame: its dt, the bucket and the camera
+    const InputFrame *replayInput =
+        options.replayPath.empty() ? nullptr : &replay.frames()[benchmarkFramesCompleted];
+    const float deltaTime = replayInput        ? replayInput->dt
+                            : options.benchmarkMode ? BENCHMARK_SIMULATION_DT
+                                                    : realDeltaTime;
     TerrainUpdateStats frameTerrainStats;
 
-    if (options.benchmarkMode) {
-      const glm::vec2 scriptedBucketPosition = benchmarkBucketPosition(benchmarkFramesCompleted);
+    TRACE_BEGIN("input");
+    if (replayInput) {
+      bucketPos.x = replayInput->bucket.x;
+      bucketPos.z = replayInput->bucket.y;
+      camera.setPosition(replayInput->cameraPosition);
+      camera.setOrientation(replayInput->cameraYaw, replayInput->cameraPitch);
+    } else if (options.benchmarkMode && !fleetMode && !siteWindow) {
+      const glm::vec2 scriptedBucketPosition =
+          scenarios[scenarioIndex].bucketPosition(terrain, benchmarkFramesCompleted);
       bucketPos.x = scriptedBucketPosition.x;
       bucketPos.z = scriptedBucketPosition.y;
     }
@@ -622,7 +558,9 @@ int main(int argc, char **argv) {
       if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) {
         camera.moveDown(deltaTime);
       }
+    }
 
+    if (!options.benchmarkMode && !fleetMode) {
       // bucket movement checks (arrow keys)
       if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) {
         bucketPos.x -= (BUCKET_SPEED * deltaTime);
@@ -637,52 +575,238 @@ int main(int argc, char **argv) {
         bucketPos.z -= (BUCKET_SPEED * deltaTime);
       }
     }
+    TRACE_END();
+
+    if (siteWindow) {
+      glm::vec2 heading(0.0f);
+      if (options.benchmarkMode) {
+        // the scripted flight carries the bucket and the camera follows it
+        const glm::vec2 flight =
+            siteFlightPosition(siteExtent, benchmarkFramesCompleted) - siteWindow->origin();
+        heading = siteFlightHeading(benchmarkFramesCompleted);
+        if (!fleetMode) {
+          bucketPos.x = flight.x;
+          bucketPos.z = flight.y;
+        }
+        camera.setPosition(glm::vec3(flight.x, 12.0f, flight.y - 15.0f));
+      } else {
+        const glm::vec3 position = camera.getPosition();
+        heading = glm::vec2(position.x, position.z) - lastCameraXZ;
+      }
+      const glm::vec3 cameraPosition = camera.getPosition();
+      const glm::vec2 moved =
+          siteWindow->update(glm::vec2(cameraPosition.x, cameraPosition.z), heading);
+      if (moved.x != 0.0f || moved.y != 0.0f) {
+        // everything kept in terrain coordinates moves with the window
+        camera.setPosition(cameraPosition - glm::vec3(moved.x, 0.0f, moved.y));
+        bucketPos.x -= moved.x;
+        bucketPos.z -= moved.y;
+        // the whole window changed, send it before it's drawn from the old offset
+        if (terrain.takePendingUploads(uploadRanges)) {
+          terrainRenderer.upload(terrain, uploadRanges);
+        }
+      }
+      lastCameraXZ = glm::vec2(camera.getPosition().x, camera.getPosition().z);
+    }
 
-    basic_shader.use();
+    // the operator's buttons for this frame, read once so the recording and the edits agree
+    const bool digPressed = !options.benchmarkMode && glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS;
+    const bool dumpPressed =
+        !options.benchmarkMode && glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS;
+    if (!options.recordPath.empty()) {
+      InputFrame input;
+      input.dt = deltaTime;
+      input.bucket = glm::vec2(bucketPos.x, bucketPos.z);
+      input.dig = digPressed;
+      input.dump = dumpPressed;
+      input.cameraPosition = camera.getPosition();
+      input.cameraYaw = camera.getYaw();
+      input.cameraPitch = camera.getPitch();
+      recorder.append(input);
+    }
 
-    // terrain
-    terrain.draw(basic_shader, perspective * camera.getViewMatrix());
+    // pick up whatever the simulation thread finished since the last frame
+    if (simulation && simulation->acquire()) {
+      TRACE_SCOPE("upload");
+      const TerrainSnapshot &snapshot = simulation->snapshot();
+      const auto uploadStart = std::chrono::steady_clock::now();
+      if (!snapshot.uploads.empty()) {
+        terrainRenderer.upload(snapshot.vertices.data(), snapshot.heights, snapshot.uploads);
+      }
+      accumulateTerrainStats(frameTerrainStats, snapshot.terrainStats);
+      frameTerrainStats.uploadMs += std::chrono::duration<double, std::milli>(
+                                        std::chrono::steady_clock::now() - uploadStart)
+                                        .count();
+      const double latencyMs =
+          std::chrono::duration<double, std::milli>(uploadStart - snapshot.publishedAt).count();
+      telemetry.recordSimSnapshot(snapshot.ticks, snapshot.tickMs, latencyMs);
+    }
 
-    // bucket
+    // terrain
+    TRACE_BEGIN("draw terrain");
+    terrainShader.use();
+    terrainGpuTimer.begin();
+    telemetry.recordTerrainDraw(terrainRenderer.draw(
+        terrainShader, perspective * camera.getViewMatrix(), camera.getPosition()));
+    terrainGpuTimer.end();
+    TRACE_END();
+
+    // buckets
     auto [bucketRow, bucketCol] = terrain.worldToGrid(bucketPos.x, bucketPos.z);
 
-    // also set the bucket's height to the current terrain height
+    // also set each bucket's height to the current terrain height
     // to make it look like its 'digging'
-    bucketPos.y = terrain.getHeight(bucketRow, bucketCol).value_or(0.0f);
-    glm::mat4 bucketModel =
-        glm::translate(glm::mat4(1.0f), bucketPos) * glm::scale(glm::mat4(1.0f), glm::vec3(0.3f));
-    glm::mat4 bucketMvp = perspective * camera.getViewMatrix() * bucketModel;
-    basic_shader.uniformInfo("mvp", bucketMvp);
-    basic_shader.uniformInfo("objectColour", glm::vec3(0.9f, 0.75, 0.2f));
+    const std::vector<float> &bucketHeights =
+        simulation ? simulation->snapshot().heights : terrain.heightData();
+    const auto heightAt = [&](float x, float z) {
+      const auto [row, col] = terrain.worldToGrid(x, z);
+      return bucketHeights[row * terrain.gridSize() + col];
+    };
+    if (fleetMode) {
+      // the tick thread's buckets as of its last snapshot, or where this frame's edits go
+      for (std::size_t bucket = 0; bucket < bucketOffsets.size(); ++bucket) {
+        const glm::vec2 position =
+            simulation ? simulation->snapshot().fleet[bucket]
+                       : fleetBucketPosition(terrain, bucket, options.buckets, fleetFrame);
+        bucketOffsets[bucket] = glm::vec3(position.x, heightAt(position.x, position.y), position.y);
+      }
+    } else {
+      bucketPos.y = heightAt(bucketPos.x, bucketPos.z);
+      bucketOffsets[0] = bucketPos;
+    }
+    TRACE_BEGIN("draw buckets");
+    bucketShader.use();
+    bucketShader.uniformInfo("viewProjection", perspective * camera.getViewMatrix());
+    bucketShader.uniformInfo("scale", 0.3f);
+    bucketShader.uniformInfo("objectColour", glm::vec3(0.9f, 0.75, 0.2f));
     glBindVertexArray(bucketVAO);
-    glDrawElements(GL_TRIANGLES, cubeIndices.size(), GL_UNSIGNED_INT, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, bucketInstanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, bucketOffsets.size() * sizeof(glm::vec3), bucketOffsets.data(),
+                 GL_STREAM_DRAW);
+    bucketGpuTimer.begin();
+    glDrawElementsInstanced(GL_TRIANGLES, cubeIndices.size(), GL_UNSIGNED_INT, 0,
+                            static_cast<GLsizei>(bucketOffsets.size()));
+    bucketGpuTimer.end();
+    TRACE_END();
+    // whichever earlier frames the GPU has finished with by now
+    while (const std::optional<double> gpuMs = terrainGpuTimer.takeMs()) {
+      telemetry.recordGpuTerrain(*gpuMs);
+    }
+    while (const std::optional<double> gpuMs = bucketGpuTimer.takeMs()) {
+      telemetry.recordGpuBucket(*gpuMs);
+    }
 
-    if (options.benchmarkMode) {
-      const TerrainAction action = benchmarkActionForFrame(benchmarkFramesCompleted);
-      const bool dig = action == TerrainAction::Dig;
+    if (fleetMode) {
+      // every bucket's edit for the frame, settled and rebuilt once
+      if (!simulation) {
+        fleetEdits(terrain, options.buckets, fleetFrame, fleetBatch);
+        accumulateTerrainStats(frameTerrainStats, terrain.modifyBatch(fleetBatch, deltaTime));
+      }
+      ++fleetFrame;
+    } else if (simulation) {
+      // applied on every tick until the next frame's command arrives
+      SimulationCommand command;
+      command.bucket = glm::vec2(bucketPos.x, bucketPos.z);
+      if (options.benchmarkMode) {
+        command.dig = scenarios[scenarioIndex].actionForFrame(benchmarkFramesCompleted) ==
+                      TerrainAction::Dig;
+        command.dump = !command.dig;
+      } else {
+        command.dig = digPressed;
+        command.dump = dumpPressed;
+      }
+      simulation->submit(command);
+    } else if (replayInput) {
+      // same order as the E and Q keys below
+      if (replayInput->dig) {
+        accumulateTerrainStats(frameTerrainStats,
+                               terrain.modify(bucketRow, bucketCol, true, deltaTime));
+      }
+      if (replayInput->dump) {
+        accumulateTerrainStats(frameTerrainStats,
+                               terrain.modify(bucketRow, bucketCol, false, deltaTime));
+      }
+    } else if (options.benchmarkMode) {
+      const bool dig =
+          scenarios[scenarioIndex].actionForFrame(benchmarkFramesCompleted) == TerrainAction::Dig;
       accumulateTerrainStats(frameTerrainStats, terrain.modify(bucketRow, bucketCol, dig, deltaTime));
     } else {
       // button to dig
-      if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) {
+      if (digPressed) {
         accumulateTerrainStats(frameTerrainStats,
                                terrain.modify(bucketRow, bucketCol, true, deltaTime));
       }
 
       // button to dump
-      if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) {
+      if (dumpPressed) {
         accumulateTerrainStats(frameTerrainStats,
                                terrain.modify(bucketRow, bucketCol, false, deltaTime));
       }
     }
 
-    glfwSwapBuffers(window); // shows new frame
-    glfwPollEvents();        // polls for actions
+    // push whatever the edits above dirtied to the GPU
+    const double simulationMs = simulation ? 0.0 : frameTerrainStats.cpuMs;
+    if (!simulation && terrain.takePendingUploads(uploadRanges)) {
+      TRACE_SCOPE("upload");
+      const auto uploadStart = std::chrono::steady_clock::now();
+      terrainRenderer.upload(terrain, uploadRanges);
+      const auto uploadEnd = std::chrono::steady_clock::now();
+      frameTerrainStats.uploadMs =
+          std::chrono::duration<double, std::milli>(uploadEnd - uploadStart).count();
+      frameTerrainStats.cpuMs += frameTerrainStats.uploadMs;
+    }
+
+    if (terrainRenderer.getUploadPath() == UploadPath::Ring) {
+      telemetry.recordFenceWait(terrainRenderer.takeFenceWaitMs());
+    }
+
+    // everything this thread did for the frame except the terrain edits and the swap
+    const double renderMs = std::chrono::duration<double, std::milli>(
+                                std::chrono::steady_clock::now() - frameStart)
+                                .count() -
+                            simulationMs;
+    telemetry.recordRender(renderMs);
+
+    if (options.offscreen) {
+      // nothing to present, so wait for the GPU here instead, keeping each frame's draws inside
+      // its own frame time rather than queued up behind the next frame
+      TRACE_BEGIN("finish");
+      glFinish();
+      TRACE_END();
+    } else {
+      TRACE_BEGIN("swap");
+      glfwSwapBuffers(window); // shows new frame
+      TRACE_END();
+    }
+    TRACE_BEGIN("poll events");
+    glfwPollEvents(); // polls for actions
+    TRACE_END();
 
     const auto frameEnd = std::chrono::steady_clock::now();
     const double frameDurationMs =
         std::chrono::duration<double, std::milli>(frameEnd - frameStart).count();
     telemetry.recordFrame(frameDurationMs);
     telemetry.recordTerrainUpdate(frameTerrainStats);
+    if (siteWindow) {
+      telemetry.recordTileStream(tileStore.takeStats());
+    }
+    if (const std::optional<std::string> interval = telemetry.pollIntervalReport()) {
+      std::cout << *interval << '\n';
+    }
+    if (firstFrameMs == 0.0) {
+      firstFrameMs = std::chrono::duration<double, std::milli>(frameEnd - processStart).count();
+      const char *source = !options.loadPath.empty()   ? "loaded"
+                           : !options.sitePath.empty() ? "streamed"
+                                                       : "generated";
+      std::cout << "First frame after " << firstFrameMs << " ms (terrain " << source << " after "
+                << terrainReadyMs << " ms)\n";
+    }
+
+    // the writer thread gets a copy, a save still in progress just pushes this one back
+    if (autosaver && frameEnd - lastAutosave >= autosaveInterval &&
+        autosaver->request(simulation ? simulation->snapshot().heights : terrain.heightData())) {
+      lastAutosave = frameEnd;
+    }
 
     std::size_t completedFrames = benchmarkFramesCompleted;
     if (options.benchmarkMode) {
@@ -690,21 +814,78 @@ int main(int argc, char **argv) {
       completedFrames = benchmarkFramesCompleted;
     }
 
-    telemetry.updateWindowTitle(window, glfwGetTime(),
-                                buildWindowTitlePrefix(options, completedFrames));
+    const std::string scenarioName =
+        options.scenarios.empty() ? std::string() : scenarios[scenarioIndex].name();
+    if (const std::optional<std::string> title = telemetry.pollWindowTitle(
+            glfwGetTime(), buildWindowTitlePrefix(options, scenarioName, completedFrames))) {
+      glfwSetWindowTitle(window, title->c_str());
+    }
 
     if (options.benchmarkMode && benchmarkFramesCompleted >= options.benchmarkFrames) {
-      glfwSetWindowShouldClose(window, GLFW_TRUE);
+      if (scenarioIndex + 1 == scenarios.size()) {
+        glfwSetWindowShouldClose(window, GLFW_TRUE);
+      } else {
+        // next scenario: report this one and start over from the same terrain
+        reportBenchmark();
+        ++scenarioIndex;
+        terrain.setHeights(startHeights);
+        telemetry = RuntimeTelemetry();
+        telemetry.enableHistory();
+        telemetry.enableIntervals(options.reportInterval);
+        benchmarkFramesCompleted = 0;
+        benchmarkStart = std::chrono::steady_clock::now();
+      }
     }
   }
 
+  // joins the tick thread, the terrain is safe to read again below
+  simulation.reset();
+  // lets a save in progress finish before the final one replaces it
+  autosaver.reset();
+  if (!options.savePath.empty() &&
+      saveTerrainFile(options.savePath, terrain.gridSize(), terrain.spacing(),
+                      terrain.heightData().data(), compression)) {
+    std::cout << "Saved terrain to " << options.savePath << '\n';
+  }
+  if (!options.recordPath.empty()) {
+    // the checksum a replay of this session should end on
+    if (recorder.close()) {
+      std::cout << "Recorded " << recorder.frameCount() << " frames to " << options.recordPath
+                << ", final heightfield checksum "
+                << formatChecksum(
+                       heightfieldChecksum(terrain.heightData().data(), terrain.cellCount()))
+                << '\n';
+    } else {
+      std::cerr << "Failed to write input recording: " << options.recordPath << "\n";
+    }
+  }
+  if (siteWindow) {
+    // the last window's edits, and every dirty tile still in the cache
+    siteWindow->writeBack();
+    tileStore.flush();
+    const TileStreamStats closing = tileStore.takeStats();
+    telemetry.tileTotals.evictions += closing.evictions;
+    telemetry.tileTotals.writebacks += closing.writebacks;
+  }
+
+  // before the scaling runs below, which aren't part of the session
+  if (!options.tracePath.empty()) {
+    writeTrace(options.tracePath);
+  }
   if (options.benchmarkMode) {
-    const auto benchmarkEnd = std::chrono::steady_clock::now();
-    const double wallSeconds =
-        std::chrono::duration<double>(benchmarkEnd - benchmarkStart).count();
-    printBenchmarkSummary(telemetry, wallSeconds, benchmarkFramesCompleted);
-    if (options.writeCsv) {
-      writeBenchmarkCsv(options, telemetry, wallSeconds, benchmarkFramesCompleted);
+    reportBenchmark();
+    if (options.settleMode == SettleMode::Parallel) {
+      printSettleScaling(measureSettleScaling(terrain.gridSize(), terrain.spacing(),
+                                              terrain.getSettleThreads(), terrain.getSimdLevel()),
+                         terrain.gridSize());
+    }
+    // a stockpile run also gets every solver timed settling one big dump all the way
+    if (std::any_of(scenarios.begin(), scenarios.end(),
+                    [](const Scenario &scenario) { return scenario.name() == "stockpile"; })) {
+      printStockpileConvergence(measureStockpileConvergence(terrain.gridSize(), terrain.spacing(),
+                                                            terrain.getSettleThreads(),
+                                                            terrain.getSimdLevel()),
+                                terrain.gridSize());
     }
   }
 
@@ -0,0 +1,700 @@
+#include "options.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "benchmark/bench_compare.h"
+#include "benchmark/input_log.h"
+#include "benchmark/kernel_bench.h"
+#include "benchmark/scenario.h"
+
+namespace {
+bool parseSize(std::string_view value, std::size_t &parsed) {
+  if (value.empty() || value.front() == '-') {
+    return false;
+  }
+
+  char *end = nullptr;
+  const unsigned long long raw = std::strtoull(value.data(), &end, 10);
+  if (end == value.data() || (end != nullptr && *end != '\0')) {
+    return false;
+  }
+
+  parsed = static_cast<std::size_t>(raw);
+  return true;
+}
+
+bool parsePositiveSize(std::string_view value, std::size_t &parsed) {
+  std::size_t raw = 0;
+  if (!parseSize(value, raw) || raw == 0) {
+    return false;
+  }
+
+  parsed = raw;
+  return true;
+}
+
+bool parsePositiveFloat(std::string_view value, float &parsed) {
+  if (value.empty()) {
+    return false;
+  }
+
+  char *end = nullptr;
+  const float raw = std::strtof(value.data(), &end);
+  if (end == value.data() || (end != nullptr && *end != '\0') || !(raw > 0.0f)) {
+    return false;
+  }
+
+  parsed = raw;
+  return true;
+}
+
+// "auto" resets parsed, the widest supported level is picked later
+bool parseSimdLevel(std::string_view value, std::optional<SimdLevel> &parsed) {
+  if (value == "auto") {
+    parsed.reset();
+  } else if (value == "scalar") {
+    parsed = SimdLevel::Scalar;
+  } else if (value == "sse2") {
+    parsed = SimdLevel::Sse2;
+  } else if (value == "avx2") {
+    parsed = SimdLevel::Avx2;
+  } else if (value == "avx512") {
+    parsed = SimdLevel::Avx512;
+  } else {
+    return false;
+  }
+  return true;
+}
+} // namespace
+
+void printUsage(const char *programName) {
+  std::cout << "Usage: " << programName
+            << " [--benchmark] [--frames=N] [--no-vsync] [--csv=PATH] [--grid=N] [--spacing=S]\n"
+            << "       [--settle=worklist|relax|parallel|flood] [--threads=N]\n"
+            << "       [--simd=auto|scalar|sse2|avx2|avx512] [--self-check] [--check-settled]\n"
+            << "       [--upload-gap=N] [--upload=subdata|ring]\n"
+            << "       [--vertex-format=full|height|packed] [--lod-distance=D]\n"
+            << "       [--sim-thread] [--buckets=N]\n"
+            << "       [--brush=point|rect|ellipse] [--brush-size=N]\n"
+            << "       [--load=PATH] [--save=PATH] [--autosave=SECONDS] [--compress]\n"
+            << "       [--site=PATH] [--site-size=N] [--tile-cache-mb=N]\n"
+            << "       [--record=PATH] [--replay=PATH] [--scenario=NAME|PATH,...] [--seed=N]\n"
+            << "       [--trace=PATH] [--report-interval=N] [--offscreen[=WIDTHxHEIGHT]]\n";
+  std::cout << "Scenarios:";
+  for (const std::string &name : Scenario::builtinNames()) {
+    std::cout << ' ' << name;
+  }
+  std::cout << ", or a scenario file\n";
+}
+
+void applyReplaySession(const InputReplay &replay, AppOptions &options) {
+  const InputSession &session = replay.session();
+  options.gridSize = session.gridSize;
+  options.spacing = session.spacing;
+  options.buckets = session.buckets;
+  options.brushShape = session.brush;
+  if (session.brush != BrushShape::Point) {
+    options.brushSize = session.brushSize;
+  }
+  options.benchmarkFrames = replay.frames().size();
+}
+
+ParseResult parseArguments(int argc, char **argv, AppOptions &options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string argument = argv[i];
+    if (argument == "--help") {
+      printUsage(argv[0]);
+      return ParseResult::ExitSuccess;
+    }
+
+    if (argument == "--benchmark") {
+      options.benchmarkMode = true;
+      continue;
+    }
+
+    if (argument == "--no-vsync") {
+      options.disableVsync = true;
+      continue;
+    }
+
+    // only ever a benchmark, there's nothing on screen to steer by
+    if (argument == "--offscreen" || argument.rfind("--offscreen=", 0) == 0) {
+      options.offscreen = true;
+      options.benchmarkMode = true;
+      if (argument.size() > 11) {
+        const std::string value = argument.substr(12);
+        const std::size_t separator = value.find('x');
+        if (separator == std::string::npos ||
+            !parsePositiveSize(value.substr(0, separator), options.offscreenWidth) ||
+            !parsePositiveSize(value.substr(separator + 1), options.offscreenHeight)) {
+          std::cerr << "Invalid --offscreen value, expected WIDTHxHEIGHT: " << value << "\n";
+          printUsage(argv[0]);
+          return ParseResult::ExitFailure;
+        }
+      }
+      continue;
+    }
+
+    if (argument.rfind("--frames=", 0) == 0) {
+      const std::string value = argument.substr(9);
+      if (!parsePositiveSize(value, options.benchmarkFrames)) {
+        std::cerr << "Invalid --frames value: " << value << "\n";
+        printUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--grid=", 0) == 0) {
+      const std::string value = argument.substr(7);
+      if (!parsePositiveSize(value, options.gridSize) || options.gridSize < 2 ||
+          options.gridSize > Terrain::maxGridSize()) {
+        std::cerr << "Invalid --grid value, expected 2 to " << Terrain::maxGridSize() << ": "
+                  << value << "\n";
+        printUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--spacing=", 0) == 0) {
+      const std::string value = argument.substr(10);
+      if (!parsePositiveFloat(value, options.spacing)) {
+        std::cerr << "Invalid --spacing value: " << value << "\n";
+        printUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--settle=", 0) == 0) {
+      const std::string value = argument.substr(9);
+      // relax names the fixed-step worklist next to flood
+      if (value == "worklist" || value == "relax") {
+        options.settleMode = SettleMode::Worklist;
+      } else if (value == "parallel") {
+        options.settleMode = SettleMode::Parallel;
+      } else if (value == "flood") {
+        options.settleMode = SettleMode::Flood;
+      } else {
+        std::cerr << "Invalid --settle value: " << value << "\n";
+        printUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--threads=", 0) == 0) {
+      const std::string value = argument.substr(10);
+      if (!parsePositiveSize(value, options.settleThreads)) {
+        std::cerr << "Invalid --threads value: " << value << "\n";
+        printUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--simd=", 0) == 0) {
+      const std::string value = argument.substr(7);
+      if (!parseSimdLevel(value, options.simdLevel)) {
+        std::cerr << "Invalid --simd value: " << value << "\n";
+        printUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--upload-gap=", 0) == 0) {
+      const std::string value = argument.substr(13);
+      if (!parseSize(value, options.uploadGap)) {
+        std::cerr << "Invalid --upload-gap value: " << value << "\n";
+        printUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--upload=", 0) == 0) {
+      const std::string value = argument.substr(9);
+      if (value == "subdata") {
+        options.uploadPath = UploadPath::SubData;
+      } else if (value == "ring") {
+        options.uploadPath = UploadPath::Ring;
+      } else {
+        std::cerr << "Invalid --upload value: " << value << "\n";
+        printUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--vertex-format=", 0) == 0) {
+      const std::string value = argument.substr(16);
+      if (value == "full") {
+        options.vertexFormat = VertexFormat::Full;
+      } else if (value == "height") {
+        options.vertexFormat = VertexFormat::Height;
+      } else if (value == "packed") {
+        options.vertexFormat = VertexFormat::Packed;
+      } else {
+        std::cerr << "Invalid --vertex-format value: " << value << "\n";
+        printUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--brush=", 0) == 0) {
+      const std::string value = argument.substr(8);
+      if (value == "point") {
+        options.brushShape = BrushShape::Point;
+      } else if (value == "rect") {
+        options.brushShape = BrushShape::Rectangle;
+      } else if (value == "ellipse") {
+        options.brushShape = BrushShape::Ellipse;
+      } else {
+        std::cerr << "Invalid --brush value: " << value << "\n";
+        printUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--brush-size=", 0) == 0) {
+      const std::string value = argument.substr(13);
+      if (!parsePositiveSize(value, options.brushSize)) {
+        std::cerr << "Invalid --brush-size value: " << value << "\n";
+        printUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--lod-distance=", 0) == 0) {
+      const std::string value = argument.substr(15);
+      char *end = nullptr;
+      const float raw = std::strtof(value.c_str(), &end);
+      if (value.empty() || *end != '\0' || !(raw >= 0.0f)) {
+        std::cerr << "Invalid --lod-distance value: " << value << "\n";
+        printUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      options.lodDistance = raw;
+      continue;
+    }
+
+    if (argument.rfind("--buckets=", 0) == 0) {
+      const std::string value = argument.substr(10);
+      if (!parsePositiveSize(value, options.buckets)) {
+        std::cerr << "Invalid --buckets value: " << value << "\n";
+        printUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument == "--sim-thread") {
+      options.simThread = true;
+      continue;
+    }
+
+    if (argument == "--self-check") {
+      options.selfCheck = true;
+      continue;
+    }
+
+    if (argument == "--check-settled") {
+      options.checkSettled = true;
+      continue;
+    }
+
+    if (argument.rfind("--csv=", 0) == 0) {
+      options.csvPath = argument.substr(6);
+      options.writeCsv = !options.csvPath.empty();
+      if (!options.writeCsv) {
+        std::cerr << "Invalid --csv value\n";
+        printUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--load=", 0) == 0 || argument.rfind("--save=", 0) == 0) {
+      std::string &path = argument[2] == 'l' ? options.loadPath : options.savePath;
+      path = argument.substr(7);
+      if (path.empty()) {
+        std::cerr << "Invalid " << argument << " value\n";
+        printUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--autosave=", 0) == 0) {
+      const std::string value = argument.substr(11);
+      if (!parsePositiveFloat(value, options.autosaveSeconds)) {
+        std::cerr << "Invalid --autosave value: " << value << "\n";
+        printUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument == "--compress") {
+      options.compressSaves = true;
+      continue;
+    }
+
+    if (argument.rfind("--site=", 0) == 0) {
+      options.sitePath = argument.substr(7);
+      if (options.sitePath.empty()) {
+        std::cerr << "Invalid --site value\n";
+        printUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--site-size=", 0) == 0) {
+      const std::string value = argument.substr(12);
+      if (!parsePositiveSize(value, options.siteSize) || options.siteSize < 2) {
+        std::cerr << "Invalid --site-size value: " << value << "\n";
+        printUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--tile-cache-mb=", 0) == 0) {
+      const std::string value = argument.substr(16);
+      if (!parsePositiveSize(value, options.tileCacheMb)) {
+        std::cerr << "Invalid --tile-cache-mb value: " << value << "\n";
+        printUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--record=", 0) == 0 || argument.rfind("--replay=", 0) == 0) {
+      const bool replay = argument[4] == 'p';
+      std::string &path = replay ? options.replayPath : options.recordPath;
+      path = argument.substr(9);
+      if (path.empty()) {
+        std::cerr << "Invalid " << argument << " value\n";
+        printUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      // a replay runs like a benchmark, just with recorded input instead of the script
+      options.benchmarkMode = options.benchmarkMode || replay;
+      continue;
+    }
+
+    if (argument.rfind("--scenario=", 0) == 0) {
+      const std::string value = argument.substr(11);
+      options.scenarios.clear();
+      std::size_t begin = 0;
+      while (begin <= value.size()) {
+        const std::size_t comma = std::min(value.find(',', begin), value.size());
+        options.scenarios.push_back(value.substr(begin, comma - begin));
+        if (options.scenarios.back().empty()) {
+          std::cerr << "Invalid --scenario value: " << value << "\n";
+          printUsage(argv[0]);
+          return ParseResult::ExitFailure;
+        }
+        begin = comma + 1;
+      }
+      // scenarios only exist as benchmark workloads
+      options.benchmarkMode = true;
+      continue;
+    }
+
+    if (argument.rfind("--seed=", 0) == 0) {
+      const std::string value = argument.substr(7);
+      std::size_t seed = 0;
+      if (!parseSize(value, seed) || seed > UINT32_MAX) {
+        std::cerr << "Invalid --seed value: " << value << "\n";
+        printUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      options.seed = static_cast<std::uint32_t>(seed);
+      continue;
+    }
+
+    if (argument.rfind("--report-interval=", 0) == 0) {
+      const std::string value = argument.substr(18);
+      if (!parseSize(value, options.reportInterval)) {
+        std::cerr << "Invalid --report-interval value: " << value << "\n";
+        printUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--trace=", 0) == 0) {
+      options.tracePath = argument.substr(8);
+      if (options.tracePath.empty()) {
+        std::cerr << "Invalid --trace value\n";
+        printUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    std::cerr << "Unknown argument: " << argument << "\n";
+    printUsage(argv[0]);
+    return ParseResult::ExitFailure;
+  }
+
+  if (options.autosaveSeconds > 0.0f && options.savePath.empty()) {
+    std::cerr << "--autosave needs --save=PATH to write to\n";
+    printUsage(argv[0]);
+    return ParseResult::ExitFailure;
+  }
+
+  // the site file is its own checkpoint, and the window moves under the terrain between ticks
+  if (!options.sitePath.empty() &&
+      (options.simThread || !options.loadPath.empty() || !options.savePath.empty())) {
+    std::cerr << "--site can't be combined with --sim-thread, --load or --save\n";
+    printUsage(argv[0]);
+    return ParseResult::ExitFailure;
+  }
+
+  // edits have to land on the same frames for a replay to give the same terrain
+  const bool inputLog = !options.recordPath.empty() || !options.replayPath.empty();
+  if (inputLog && (options.simThread || !options.sitePath.empty())) {
+    std::cerr << "--record and --replay can't be combined with --sim-thread or --site\n";
+    printUsage(argv[0]);
+    return ParseResult::ExitFailure;
+  }
+  if (!options.recordPath.empty() && options.benchmarkMode) {
+    std::cerr << "--record needs an interactive run, not --benchmark or --replay\n";
+    printUsage(argv[0]);
+    return ParseResult::ExitFailure;
+  }
+
+  // a scenario scripts one bucket on the frame thread, over a terrain that stays put
+  if (!options.scenarios.empty() && (!options.replayPath.empty() || !options.sitePath.empty() ||
+                                     options.simThread || options.buckets > 1)) {
+    std::cerr << "--scenario can't be combined with --replay, --site, --sim-thread or --buckets\n";
+    printUsage(argv[0]);
+    return ParseResult::ExitFailure;
+  }
+
+  return ParseResult::Continue;
+}
+
+void printKernelBenchUsage(const char *programName) {
+  std::cout << "Usage: " << programName
+            << " [--sizes=N,N,...] [--warmup=N] [--repetitions=N] [--kernel=NAME]\n"
+            << "       [--simd=auto|scalar|sse2|avx2|avx512] [--json=PATH] [--csv=PATH]\n"
+            << "Kernels: modify, modifyBatch, stabilizeSoil, rebuildVertices, worldToGrid,"
+               " getHeight\n";
+}
+
+ParseResult parseKernelBenchArguments(int argc, char **argv, KernelBenchOptions &options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string argument = argv[i];
+    if (argument == "--help") {
+      printKernelBenchUsage(argv[0]);
+      return ParseResult::ExitSuccess;
+    }
+
+    if (argument.rfind("--sizes=", 0) == 0) {
+      const std::string value = argument.substr(8);
+      options.gridSizes.clear();
+      std::size_t begin = 0;
+      while (begin <= value.size()) {
+        const std::size_t comma = std::min(value.find(',', begin), value.size());
+        std::size_t size = 0;
+        if (!parsePositiveSize(value.substr(begin, comma - begin), size) || size < 2 ||
+            size > Terrain::maxGridSize()) {
+          std::cerr << "Invalid --sizes value: " << value << "\n";
+          printKernelBenchUsage(argv[0]);
+          return ParseResult::ExitFailure;
+        }
+        options.gridSizes.push_back(size);
+        begin = comma + 1;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--warmup=", 0) == 0) {
+      const std::string value = argument.substr(9);
+      if (!parseSize(value, options.warmup)) {
+        std::cerr << "Invalid --warmup value: " << value << "\n";
+        printKernelBenchUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--repetitions=", 0) == 0) {
+      const std::string value = argument.substr(14);
+      if (!parsePositiveSize(value, options.repetitions)) {
+        std::cerr << "Invalid --repetitions value: " << value << "\n";
+        printKernelBenchUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--kernel=", 0) == 0) {
+      options.kernel = argument.substr(9);
+      if (!isKernelBenchName(options.kernel)) {
+        std::cerr << "Unknown kernel: " << options.kernel << "\n";
+        printKernelBenchUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--simd=", 0) == 0) {
+      const std::string value = argument.substr(7);
+      if (!parseSimdLevel(value, options.simdLevel)) {
+        std::cerr << "Invalid --simd value: " << value << "\n";
+        printKernelBenchUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--json=", 0) == 0 || argument.rfind("--csv=", 0) == 0) {
+      const bool json = argument[2] == 'j';
+      std::string &path = json ? options.jsonPath : options.csvPath;
+      path = argument.substr(json ? 7 : 6);
+      if (path.empty()) {
+        std::cerr << "Invalid " << argument << " value\n";
+        printKernelBenchUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    std::cerr << "Unknown argument: " << argument << "\n";
+    printKernelBenchUsage(argv[0]);
+    return ParseResult::ExitFailure;
+  }
+
+  return ParseResult::Continue;
+}
+
+void printBenchCompareUsage(const char *programName) {
+  std::cout << "Usage: " << programName
+            << " [--runs=N] [--warmup=N] [--cpu=N] [--headless=PATH] [--candidate=PATH]\n"
+            << "       [--baseline=PATH] [--save-baseline=PATH] [--metrics=NAME,NAME,...]\n"
+            << "       [--threshold=PERCENT] [--confidence=LEVEL] [-- HEADLESS FLAGS...]\n"
+            << "Metrics are --csv column names, e.g. avg_frame_ms, p95_frame_ms, avg_terrain_ms,"
+               " p99_terrain_ms, avg_fps\n";
+}
+
+ParseResult parseBenchCompareArguments(int argc, char **argv, BenchCompareOptions &options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string argument = argv[i];
+    if (argument == "--help") {
+      printBenchCompareUsage(argv[0]);
+      return ParseResult::ExitSuccess;
+    }
+
+    if (argument == "--") {
+      options.headlessArguments.assign(argv + i + 1, argv + argc);
+      break;
+    }
+
+    if (argument.rfind("--runs=", 0) == 0 || argument.rfind("--warmup=", 0) == 0) {
+      const bool runs = argument[2] == 'r';
+      const std::string value = argument.substr(runs ? 7 : 9);
+      const bool valid = runs ? parsePositiveSize(value, options.runs)
+                              : parseSize(value, options.warmup);
+      if (!valid) {
+        std::cerr << "Invalid " << argument << " value\n";
+        printBenchCompareUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--cpu=", 0) == 0) {
+      std::size_t cpu = 0;
+      if (!parseSize(argument.substr(6), cpu)) {
+        std::cerr << "Invalid --cpu value: " << argument.substr(6) << "\n";
+        printBenchCompareUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      options.cpu = cpu;
+      continue;
+    }
+
+    const std::pair<const char *, std::string *> paths[] = {
+        {"--headless=", &options.headlessPath},
+        {"--candidate=", &options.candidatePath},
+        {"--baseline=", &options.baselinePath},
+        {"--save-baseline=", &options.saveBaselinePath}};
+    const auto path = std::find_if(std::begin(paths), std::end(paths), [&](const auto &flag) {
+      return argument.rfind(flag.first, 0) == 0;
+    });
+    if (path != std::end(paths)) {
+      *path->second = argument.substr(std::string_view(path->first).size());
+      if (path->second->empty()) {
+        std::cerr << "Invalid " << argument << " value\n";
+        printBenchCompareUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--metrics=", 0) == 0) {
+      const std::string value = argument.substr(10);
+      options.metrics.clear();
+      std::size_t begin = 0;
+      while (begin <= value.size()) {
+        const std::size_t comma = std::min(value.find(',', begin), value.size());
+        if (comma == begin) {
+          std::cerr << "Invalid --metrics value: " << value << "\n";
+          printBenchCompareUsage(argv[0]);
+          return ParseResult::ExitFailure;
+        }
+        options.metrics.push_back(value.substr(begin, comma - begin));
+        begin = comma + 1;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--threshold=", 0) == 0) {
+      const std::string value = argument.substr(12);
+      if (!parsePositiveFloat(value, options.thresholdPercent)) {
+        std::cerr << "Invalid --threshold value: " << value << "\n";
+        printBenchCompareUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    if (argument.rfind("--confidence=", 0) == 0) {
+      const std::string value = argument.substr(13);
+      if (!parsePositiveFloat(value, options.confidence) || options.confidence >= 1.0f) {
+        std::cerr << "Invalid --confidence value, expected a level like 0.95: " << value << "\n";
+        printBenchCompareUsage(argv[0]);
+        return ParseResult::ExitFailure;
+      }
+      continue;
+    }
+
+    std::cerr << "Unknown argument: " << argument << "\n";
+    printBenchCompareUsage(argv[0]);
+    return ParseResult::ExitFailure;
+  }
+
+  if (!options.candidatePath.empty() && options.baselinePath.empty()) {
+    std::cerr << "--candidate needs a --baseline to compare against\n";
+    printBenchCompareUsage(argv[0]);
+    return ParseResult::ExitFailure;
+  }
+  return ParseResult::Continue;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "rendering/chunk_grid.h"
+#include "rendering/upload_path.h"
+#include "simulation/terrain.h"
+
+// command line flags shared by the windowed app and the headless benchmark
+struct AppOptions {
+  bool benchmarkMode = false;
+  bool disableVsync = false;
+  bool writeCsv = false;
+  std::size_t benchmarkFrames = 3000;
+  std::string csvPath;
+  std::size_t gridSize = 64;
+  float spacing = 0.1f;
+  SettleMode settleMode = SettleMode::Worklist;
+  // 0 means one per hardware thread
+  std::size_t settleThreads = 0;
+  // empty picks the widest row kernel the cpu supports
+  std::optional<SimdLevel> simdLevel;
+  // compare the row kernels against the scalar reference and exit
+  bool selfCheck = false;
+  // fail a headless run whose terrain ends with a slope steeper than the angle of repose
+  bool checkSettled = false;
+  // clean vertices allowed between two dirty runs before they're uploaded separately
+  std::size_t uploadGap = Terrain::defaultUploadGap();
+  // only the windowed app uploads, the headless binary ignores this
+  UploadPath uploadPath = UploadPath::SubData;
+  VertexFormat vertexFormat = VertexFormat::Full;
+  // chunk widths drawn at full detail before geomipmap levels start dropping, 0 disables LOD
+  float lodDistance = ChunkGrid::defaultLodDistance();
+  // run terrain edits on their own fixed-tick thread, windowed app only
+  bool simThread = false;
+  // more than one runs a scripted fleet with batched edits instead of the keyboard bucket
+  std::size_t buckets = 1;
+  // bucket footprint; point keeps the original single-cell edit and ignores brushSize
+  BrushShape brushShape = BrushShape::Point;
+  // footprint width in cells
+  std::size_t brushSize = 8;
+  // heightfield checkpoint to start from, its grid size and spacing replace --grid/--spacing
+  std::string loadPath;
+  // checkpoint written on exit, and by --autosave while running
+  std::string savePath;
+  // seconds between background saves to savePath, 0 only saves on exit
+  float autosaveSeconds = 0.0f;
+  bool compressSaves = false;
+  // tiled site streamed from disk around the camera, created with siteSize cells a side if
+  // missing; --grid becomes the size of the loaded window
+  std::string sitePath;
+  std::size_t siteSize = 8192;
+  // resident tile budget, in megabytes
+  std::size_t tileCacheMb = 64;
+  // operator input written every interactive frame, viewer only
+  std::string recordPath;
+  // recorded input played back as a benchmark run, its session replaces --grid/--spacing,
+  // --buckets and --brush, and its length --frames
+  std::string replayPath;
+  // workloads run one after another from the same starting terrain, each reported on its own;
+  // empty runs the original sweep, see Scenario
+  std::vector<std::string> scenarios;
+  // random-walk and a scenario file's wander strokes are drawn from this
+  std::uint32_t seed = 1;
+  // Chrome trace event JSON of every thread's timeline, written on exit
+  std::string tracePath;
+  // frames between printed frame and terrain time percentiles, 0 prints none
+  std::size_t reportInterval = 0;
+  // benchmark into a framebuffer object of this size instead of the window, which stays hidden
+  // and is never presented; viewer only
+  bool offscreen = false;
+  std::size_t offscreenWidth = 1280;
+  std::size_t offscreenHeight = 720;
+};
+
+enum class ParseResult { Continue, ExitSuccess, ExitFailure };
+
+class InputReplay;
+struct KernelBenchOptions;
+struct BenchCompareOptions;
+
+void printUsage(const char *programName);
+ParseResult parseArguments(int argc, char **argv, AppOptions &options);
+// takes the grid, fleet, brush and frame count from a recording so the replay matches it
+void applyReplaySession(const InputReplay &replay, AppOptions &options);
+
+// terrain-bench has its own flags, see KernelBenchOptions
+void printKernelBenchUsage(const char *programName);
+ParseResult parseKernelBenchArguments(int argc, char **argv, KernelBenchOptions &options);
+
+// bench-compare has its own flags, see BenchCompareOptions
+void printBenchCompareUsage(const char *programName);
+ParseResult parseBenchCompareArguments(int argc, char **argv, BenchCompareOptions &options);
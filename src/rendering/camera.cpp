@@ -54,6 +54,12 @@ void Camera::look(float xOffset, float yOffset) {
   updateFront();
 }
 
+void Camera::setOrientation(float newYaw, float newPitch) {
+  yaw = newYaw;
+  pitch = newPitch;
+  updateFront();
+}
+
 glm::mat4 Camera::getViewMatrix() {
   glm::mat4 view = glm::lookAt(position, position + front, up);
   return view;
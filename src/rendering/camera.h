@@ -25,4 +25,12 @@ public:
   void moveDown(float dt);
   void look(float xOffset, float yOffset);
   glm::mat4 getViewMatrix();
+  glm::vec3 getPosition() const { return position; }
+  void setPosition(const glm::vec3 &newPosition) { position = newPosition; }
+  // unit view direction
+  glm::vec3 getFront() const { return front; }
+  // radians, what --record stores so --replay can put the view back exactly
+  float getYaw() const { return yaw; }
+  float getPitch() const { return pitch; }
+  void setOrientation(float newYaw, float newPitch);
 };
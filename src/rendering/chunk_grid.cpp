@@ -0,0 +1,291 @@
+#include "chunk_grid.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+ChunkGrid::ChunkGrid(std::size_t gridSize, float spacing)
+    : size(gridSize), cellSpacing(spacing),
+      chunksPerSide((gridSize - 1 + CHUNK_QUADS - 1) / CHUNK_QUADS) {
+  // full-size chunks share 16 patterns per level: one per combination of edges stitched to a
+  // finer neighbour. neighbours never differ by more than one level (see select), so a
+  // stitched edge always uses exactly half the chunk's own step
+  patterns.resize((MAX_LEVEL + 1) * 16);
+  for (std::size_t level = 0; level <= MAX_LEVEL; ++level) {
+    const unsigned masks = level == 0 ? 1 : 16;
+    for (unsigned edges = 0; edges < masks; ++edges) {
+      patterns[level * 16 + edges] =
+          appendPattern(CHUNK_QUADS, CHUNK_QUADS, std::size_t{1} << level, edges);
+    }
+  }
+
+  chunks.resize(chunksPerSide * chunksPerSide);
+  for (std::size_t a = 0; a < chunksPerSide; ++a) {
+    for (std::size_t b = 0; b < chunksPerSide; ++b) {
+      Chunk &chunk = chunks[a * chunksPerSide + b];
+      chunk.firstRow = a * CHUNK_QUADS;
+      chunk.firstCol = b * CHUNK_QUADS;
+      chunk.rows = std::min(CHUNK_QUADS, size - 1 - chunk.firstRow);
+      chunk.cols = std::min(CHUNK_QUADS, size - 1 - chunk.firstCol);
+      chunk.partial = chunk.rows != CHUNK_QUADS || chunk.cols != CHUNK_QUADS;
+      if (!chunk.partial) {
+        continue;
+      }
+      // at most three shapes (short right column, short bottom row, the corner)
+      chunk.partialPattern = partialPatterns.size();
+      for (std::size_t k = 0; k < partialPatterns.size(); ++k) {
+        if (partialShapes[k] == std::make_pair(chunk.rows, chunk.cols)) {
+          chunk.partialPattern = k;
+        }
+      }
+      if (chunk.partialPattern == partialPatterns.size()) {
+        partialShapes.emplace_back(chunk.rows, chunk.cols);
+        partialPatterns.push_back(appendPattern(chunk.rows, chunk.cols, 1, 0));
+      }
+    }
+  }
+
+  levels.resize(chunks.size());
+  visible.resize(chunks.size());
+  staleChunks.reserve(chunks.size());
+}
+
+ChunkGrid::Pattern ChunkGrid::appendPattern(std::size_t rows, std::size_t cols, std::size_t step,
+                                            unsigned edges) {
+  Pattern pattern;
+  pattern.first = indices.size();
+  auto vertex = [&](std::size_t r, std::size_t c) {
+    return static_cast<std::uint32_t>(r * size + c);
+  };
+  const std::size_t half = step / 2;
+
+  for (std::size_t r = 0; r < rows; r += step) {
+    for (std::size_t c = 0; c < cols; c += step) {
+      const bool splitTop = (edges & EDGE_TOP) && r == 0;
+      const bool splitBottom = (edges & EDGE_BOTTOM) && r + step == rows;
+      const bool splitLeft = (edges & EDGE_LEFT) && c == 0;
+      const bool splitRight = (edges & EDGE_RIGHT) && c + step == cols;
+      if (!splitTop && !splitBottom && !splitLeft && !splitRight) {
+        // an unstitched quad is two triangles split along the top-left to bottom-right
+        // diagonal, the layout every level and every edge-free pattern shares
+        const std::uint32_t topLeft = vertex(r, c);
+        const std::uint32_t topRight = vertex(r, c + step);
+        const std::uint32_t bottomLeft = vertex(r + step, c);
+        const std::uint32_t bottomRight = vertex(r + step, c + step);
+        indices.insert(indices.end(), {topLeft, bottomLeft, bottomRight});
+        indices.insert(indices.end(), {topLeft, bottomRight, topRight});
+        continue;
+      }
+
+      // a quad on a stitched edge becomes a fan around its centre, walking the border in the
+      // same order as the two-triangle case; split sides visit the finer neighbour's vertices
+      const std::uint32_t centre = vertex(r + half, c + half);
+      auto side = [&](long r0, long c0, long dr, long dc, bool split) {
+        const long sideStep = static_cast<long>(split ? half : step);
+        for (long k = 0; k < static_cast<long>(step); k += sideStep) {
+          const long next = k + sideStep;
+          const std::uint32_t from = vertex(static_cast<std::size_t>(r0 + dr * k),
+                                            static_cast<std::size_t>(c0 + dc * k));
+          const std::uint32_t to = vertex(static_cast<std::size_t>(r0 + dr * next),
+                                          static_cast<std::size_t>(c0 + dc * next));
+          indices.insert(indices.end(), {centre, from, to});
+        }
+      };
+      const long top = static_cast<long>(r);
+      const long left = static_cast<long>(c);
+      const long bottom = static_cast<long>(r + step);
+      const long right = static_cast<long>(c + step);
+      side(top, left, 1, 0, splitLeft);       // top left -> bottom left
+      side(bottom, left, 0, 1, splitBottom);  // bottom left -> bottom right
+      side(bottom, right, -1, 0, splitRight); // bottom right -> top right
+      side(top, right, 0, -1, splitTop);      // top right -> top left
+    }
+  }
+
+  pattern.count = indices.size() - pattern.first;
+  return pattern;
+}
+
+void ChunkGrid::rescan(Chunk &chunk, const std::vector<float> &heights) {
+  float low = heights[chunk.firstRow * size + chunk.firstCol];
+  float high = low;
+  for (std::size_t r = chunk.firstRow; r <= chunk.firstRow + chunk.rows; ++r) {
+    const auto first = heights.begin() + static_cast<long>(r * size + chunk.firstCol);
+    const auto last = first + static_cast<long>(chunk.cols + 1);
+    const auto [minIt, maxIt] = std::minmax_element(first, last);
+    low = std::min(low, *minIt);
+    high = std::max(high, *maxIt);
+  }
+  chunk.boundsMin = glm::vec3(chunk.firstRow * cellSpacing, low, chunk.firstCol * cellSpacing);
+  chunk.boundsMax = glm::vec3((chunk.firstRow + chunk.rows) * cellSpacing, high,
+                              (chunk.firstCol + chunk.cols) * cellSpacing);
+  chunk.stale = false;
+}
+
+void ChunkGrid::recomputeBounds(const std::vector<float> &heights) {
+  for (Chunk &chunk : chunks) {
+    rescan(chunk, heights);
+  }
+}
+
+void ChunkGrid::markStale(std::size_t row, std::size_t firstCol, std::size_t lastCol) {
+  // vertices on a chunk border belong to the chunks either side of it
+  const std::size_t firstA = row > 0 ? (row - 1) / CHUNK_QUADS : 0;
+  const std::size_t lastA = std::min(row / CHUNK_QUADS, chunksPerSide - 1);
+  const std::size_t firstB = firstCol > 0 ? (firstCol - 1) / CHUNK_QUADS : 0;
+  const std::size_t lastB = std::min(lastCol / CHUNK_QUADS, chunksPerSide - 1);
+  for (std::size_t a = firstA; a <= lastA; ++a) {
+    for (std::size_t b = firstB; b <= lastB; ++b) {
+      Chunk &chunk = chunks[a * chunksPerSide + b];
+      if (!chunk.stale) {
+        chunk.stale = true;
+        staleChunks.push_back(a * chunksPerSide + b);
+      }
+    }
+  }
+}
+
+void ChunkGrid::updateBounds(const std::vector<float> &heights,
+                             const std::vector<VertexRange> &ranges) {
+  for (const VertexRange &range : ranges) {
+    if (range.count == 0) {
+      continue;
+    }
+    const std::size_t last = range.first + range.count - 1;
+    const std::size_t firstRow = range.first / size;
+    const std::size_t lastRow = last / size;
+    for (std::size_t r = firstRow; r <= lastRow; ++r) {
+      const std::size_t firstCol = r == firstRow ? range.first % size : 0;
+      const std::size_t lastCol = r == lastRow ? last % size : size - 1;
+      markStale(r, firstCol, lastCol);
+    }
+  }
+  for (std::size_t index : staleChunks) {
+    rescan(chunks[index], heights);
+  }
+  staleChunks.clear();
+}
+
+TerrainDrawStats ChunkGrid::select(const glm::mat4 &viewProjection, const glm::vec3 &eye,
+                                   float lodDistance, ChunkDrawList &out) {
+  const auto start = std::chrono::steady_clock::now();
+  TerrainDrawStats stats;
+  stats.chunksTotal = chunks.size();
+  out.counts.clear();
+  out.offsets.clear();
+  out.baseVertices.clear();
+
+  // frustum planes straight from the matrix rows (Gribb & Hartmann), glm is column-major
+  glm::vec4 planes[6];
+  const glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0],
+                       viewProjection[3][0]);
+  const glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1],
+                       viewProjection[3][1]);
+  const glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2],
+                       viewProjection[3][2]);
+  const glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3],
+                       viewProjection[3][3]);
+  planes[0] = row3 + row0;
+  planes[1] = row3 - row0;
+  planes[2] = row3 + row1;
+  planes[3] = row3 - row1;
+  planes[4] = row3 + row2;
+  planes[5] = row3 - row2;
+
+  const float chunkWidth = static_cast<float>(CHUNK_QUADS) * cellSpacing;
+  for (std::size_t i = 0; i < chunks.size(); ++i) {
+    const Chunk &chunk = chunks[i];
+    bool inside = true;
+    for (const glm::vec4 &plane : planes) {
+      // the box corner furthest along the plane normal
+      const glm::vec3 corner(plane.x > 0.0f ? chunk.boundsMax.x : chunk.boundsMin.x,
+                             plane.y > 0.0f ? chunk.boundsMax.y : chunk.boundsMin.y,
+                             plane.z > 0.0f ? chunk.boundsMax.z : chunk.boundsMin.z);
+      if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) {
+        inside = false;
+        break;
+      }
+    }
+    visible[i] = inside;
+
+    std::size_t level = 0;
+    if (!chunk.partial && lodDistance > 0.0f) {
+      const glm::vec3 nearest = glm::clamp(eye, chunk.boundsMin, chunk.boundsMax);
+      const float distance = glm::length(eye - nearest) / (lodDistance * chunkWidth);
+      if (distance >= 1.0f) {
+        level = std::min(MAX_LEVEL, static_cast<std::size_t>(std::log2(distance)) + 1);
+      }
+    }
+    levels[i] = static_cast<std::uint8_t>(level);
+  }
+
+  // neighbours may differ by at most one level, otherwise the half-step stitch can't meet;
+  // lowering a chunk only ever lowers its neighbours' limits, so this settles quickly
+  bool lowered = true;
+  while (lowered) {
+    lowered = false;
+    for (std::size_t a = 0; a < chunksPerSide; ++a) {
+      for (std::size_t b = 0; b < chunksPerSide; ++b) {
+        const std::size_t i = a * chunksPerSide + b;
+        std::uint8_t limit = levels[i];
+        if (a > 0) {
+          limit = std::min<std::uint8_t>(limit, levels[i - chunksPerSide] + 1);
+        }
+        if (a + 1 < chunksPerSide) {
+          limit = std::min<std::uint8_t>(limit, levels[i + chunksPerSide] + 1);
+        }
+        if (b > 0) {
+          limit = std::min<std::uint8_t>(limit, levels[i - 1] + 1);
+        }
+        if (b + 1 < chunksPerSide) {
+          limit = std::min<std::uint8_t>(limit, levels[i + 1] + 1);
+        }
+        if (limit < levels[i]) {
+          levels[i] = limit;
+          lowered = true;
+        }
+      }
+    }
+  }
+
+  for (std::size_t a = 0; a < chunksPerSide; ++a) {
+    for (std::size_t b = 0; b < chunksPerSide; ++b) {
+      const std::size_t i = a * chunksPerSide + b;
+      if (!visible[i]) {
+        continue;
+      }
+      const Chunk &chunk = chunks[i];
+      Pattern pattern;
+      if (chunk.partial) {
+        pattern = partialPatterns[chunk.partialPattern];
+      } else {
+        const std::uint8_t level = levels[i];
+        unsigned edges = 0;
+        if (a > 0 && levels[i - chunksPerSide] < level) {
+          edges |= EDGE_TOP;
+        }
+        if (a + 1 < chunksPerSide && levels[i + chunksPerSide] < level) {
+          edges |= EDGE_BOTTOM;
+        }
+        if (b > 0 && levels[i - 1] < level) {
+          edges |= EDGE_LEFT;
+        }
+        if (b + 1 < chunksPerSide && levels[i + 1] < level) {
+          edges |= EDGE_RIGHT;
+        }
+        pattern = patterns[level * 16 + edges];
+      }
+      out.counts.push_back(static_cast<std::int32_t>(pattern.count));
+      out.offsets.push_back(
+          reinterpret_cast<const void *>(pattern.first * sizeof(std::uint32_t)));
+      out.baseVertices.push_back(
+          static_cast<std::int32_t>(chunk.firstRow * size + chunk.firstCol));
+      ++stats.chunksDrawn;
+      stats.triangles += pattern.count / 3;
+    }
+  }
+
+  const auto end = std::chrono::steady_clock::now();
+  stats.cullMs = std::chrono::duration<double, std::milli>(end - start).count();
+  return stats;
+}
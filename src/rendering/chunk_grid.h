@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <utility>
+#include <vector>
+
+#include "../simulation/dirty_region.h"
+
+// what one frame of chunked terrain drawing cost
+struct TerrainDrawStats {
+  std::size_t chunksDrawn = 0;
+  std::size_t chunksTotal = 0;
+  std::size_t triangles = 0;
+  double cullMs = 0.0;
+};
+
+// visible chunks of one frame, laid out for glMultiDrawElementsBaseVertex
+struct ChunkDrawList {
+  std::vector<std::int32_t> counts;
+  std::vector<const void *> offsets;
+  std::vector<std::int32_t> baseVertices;
+};
+
+// splits the terrain grid into square chunks with their own height bounds, culls them against
+// the view frustum and picks a geomipmap level per chunk
+// no GL in here, the renderer owns the buffers and issues the draw
+class ChunkGrid {
+public:
+  // quads along a chunk edge, a power of two so every level halves cleanly
+  static constexpr std::size_t CHUNK_QUADS = 32;
+
+  ChunkGrid(std::size_t gridSize, float spacing);
+
+  // every index pattern back to back, indices are relative to the chunk's first vertex
+  const std::vector<std::uint32_t> &indexData() const { return indices; }
+  void recomputeBounds(const std::vector<float> &heights);
+  // rescans the chunks touched by the uploaded vertex ranges
+  void updateBounds(const std::vector<float> &heights, const std::vector<VertexRange> &ranges);
+  // lodDistance is in chunk widths: chunks nearer than that draw at full detail and every
+  // doubling of distance drops a level; 0 turns LOD off
+  TerrainDrawStats select(const glm::mat4 &viewProjection, const glm::vec3 &eye, float lodDistance,
+                          ChunkDrawList &out);
+  std::size_t chunkCount() const { return chunks.size(); }
+  static constexpr float defaultLodDistance() { return DEFAULT_LOD_DISTANCE; }
+
+private:
+  // levels 0 .. MAX_LEVEL, a level-l chunk samples every 2^l-th vertex
+  static constexpr std::size_t MAX_LEVEL = 5;
+  // chunk widths out to which terrain stays at full detail
+  static constexpr float DEFAULT_LOD_DISTANCE = 2.0f;
+  // edges that meet a finer neighbour and have to split to its step
+  enum EdgeBit : unsigned { EDGE_TOP = 1, EDGE_BOTTOM = 2, EDGE_LEFT = 4, EDGE_RIGHT = 8 };
+
+  struct Pattern {
+    std::size_t first = 0;
+    std::size_t count = 0;
+  };
+  struct Chunk {
+    std::size_t firstRow = 0;
+    std::size_t firstCol = 0;
+    std::size_t rows = 0;
+    std::size_t cols = 0;
+    glm::vec3 boundsMin{0.0f};
+    glm::vec3 boundsMax{0.0f};
+    // chunks short of CHUNK_QUADS at the far edges only have a full-detail pattern
+    std::size_t partialPattern = 0;
+    bool partial = false;
+    bool stale = false;
+  };
+
+  std::size_t size;
+  float cellSpacing;
+  std::size_t chunksPerSide;
+  std::vector<Chunk> chunks;
+  std::vector<std::uint32_t> indices;
+  // [level][edge mask], level 0 only uses mask 0
+  std::vector<Pattern> patterns;
+  std::vector<Pattern> partialPatterns;
+  // rows x cols of the chunks each partial pattern was built for
+  std::vector<std::pair<std::size_t, std::size_t>> partialShapes;
+  // per-frame scratch, sized once
+  std::vector<std::uint8_t> levels;
+  std::vector<std::uint8_t> visible;
+  std::vector<std::size_t> staleChunks;
+
+  Pattern appendPattern(std::size_t rows, std::size_t cols, std::size_t step, unsigned edges);
+  void rescan(Chunk &chunk, const std::vector<float> &heights);
+  void markStale(std::size_t row, std::size_t firstCol, std::size_t lastCol);
+};
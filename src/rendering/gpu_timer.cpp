@@ -0,0 +1,38 @@
+#include "gpu_timer.h"
+
+GpuTimer::GpuTimer() { glGenQueries(static_cast<GLsizei>(queries.size()), queries.data()); }
+
+GpuTimer::~GpuTimer() { glDeleteQueries(static_cast<GLsizei>(queries.size()), queries.data()); }
+
+void GpuTimer::begin() {
+  if (inFlight == queries.size()) {
+    return;
+  }
+  glBeginQuery(GL_TIME_ELAPSED, queries[(oldest + inFlight) % queries.size()]);
+  timing = true;
+}
+
+void GpuTimer::end() {
+  if (!timing) {
+    return;
+  }
+  glEndQuery(GL_TIME_ELAPSED);
+  timing = false;
+  ++inFlight;
+}
+
+std::optional<double> GpuTimer::takeMs() {
+  if (inFlight == 0) {
+    return std::nullopt;
+  }
+  GLuint available = GL_FALSE;
+  glGetQueryObjectuiv(queries[oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+  if (available == GL_FALSE) {
+    return std::nullopt;
+  }
+  GLuint64 nanoseconds = 0;
+  glGetQueryObjectui64v(queries[oldest], GL_QUERY_RESULT, &nanoseconds);
+  oldest = (oldest + 1) % queries.size();
+  --inFlight;
+  return static_cast<double>(nanoseconds) / 1.0e6;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <optional>
+
+#include "glad/gl.h"
+
+// GPU time spent between begin() and end(), read back a few frames later so the CPU never
+// waits for the GPU to catch up
+class GpuTimer {
+private:
+  // frames of queries that may still be in flight
+  static constexpr std::size_t QUERY_RING = 4;
+
+  std::array<GLuint, QUERY_RING> queries{};
+  // oldest query not read yet, and how many after it are waiting
+  std::size_t oldest = 0;
+  std::size_t inFlight = 0;
+  bool timing = false;
+
+public:
+  GpuTimer();
+  ~GpuTimer();
+  GpuTimer(const GpuTimer &) = delete;
+  GpuTimer &operator=(const GpuTimer &) = delete;
+
+  // skips this frame when every query is still waiting on the GPU
+  void begin();
+  void end();
+  // the oldest finished measurement, nothing if the GPU hasn't got to it yet
+  std::optional<double> takeMs();
+};
@@ -0,0 +1,48 @@
+#include "offscreen_target.h"
+
+#include <iostream>
+
+OffscreenTarget::~OffscreenTarget() {
+  glDeleteFramebuffers(1, &framebuffer);
+  glDeleteRenderbuffers(1, &colour);
+  glDeleteRenderbuffers(1, &depth);
+}
+
+bool OffscreenTarget::create(GLsizei requestedWidth, GLsizei requestedHeight) {
+  GLint maxSize = 0;
+  glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxSize);
+  if (requestedWidth > maxSize || requestedHeight > maxSize) {
+    std::cerr << "Offscreen size " << requestedWidth << "x" << requestedHeight
+              << " is past the driver's limit of " << maxSize << "\n";
+    return false;
+  }
+  width = requestedWidth;
+  height = requestedHeight;
+
+  // renderbuffers rather than textures, nothing ever samples the result
+  glGenRenderbuffers(1, &colour);
+  glBindRenderbuffer(GL_RENDERBUFFER, colour);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glGenRenderbuffers(1, &depth);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colour);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+  const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    std::cerr << "Offscreen framebuffer incomplete (status 0x" << std::hex << status << std::dec
+              << ")\n";
+    return false;
+  }
+  return true;
+}
+
+void OffscreenTarget::bind() const {
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glViewport(0, 0, width, height);
+}
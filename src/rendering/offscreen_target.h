@@ -0,0 +1,28 @@
+#pragma once
+
+#include "glad/gl.h"
+
+// colour and depth renderbuffers attached to a framebuffer object, what --offscreen draws into
+// instead of the window's back buffer
+class OffscreenTarget {
+private:
+  GLuint framebuffer = 0;
+  GLuint colour = 0;
+  GLuint depth = 0;
+  GLsizei width = 0;
+  GLsizei height = 0;
+
+public:
+  OffscreenTarget() = default;
+  ~OffscreenTarget();
+  OffscreenTarget(const OffscreenTarget &) = delete;
+  OffscreenTarget &operator=(const OffscreenTarget &) = delete;
+
+  // needs a current context, prints why and returns false if the size is beyond the driver's
+  // limit or the framebuffer isn't complete
+  bool create(GLsizei width, GLsizei height);
+  // makes it the draw target, viewport included
+  void bind() const;
+  GLsizei getWidth() const { return width; }
+  GLsizei getHeight() const { return height; }
+};
@@ -82,3 +82,13 @@ void Shader::uniformInfo(const std::string &uniform, const glm::vec3 &vec) {
   int location = glGetUniformLocation(programID, uniform.c_str());
   glUniform3fv(location, 1, glm::value_ptr(vec));
 }
+
+void Shader::uniformInfo(const std::string &uniform, int value) {
+  int location = glGetUniformLocation(programID, uniform.c_str());
+  glUniform1i(location, value);
+}
+
+void Shader::uniformInfo(const std::string &uniform, float value) {
+  int location = glGetUniformLocation(programID, uniform.c_str());
+  glUniform1f(location, value);
+}
@@ -14,4 +14,6 @@ public:
   void use();
   void uniformInfo(const std::string &uniform, const glm::mat4 &matrix);
   void uniformInfo(const std::string &uniform, const glm::vec3 &vec);
+  void uniformInfo(const std::string &uniform, int value);
+  void uniformInfo(const std::string &uniform, float value);
 };
@@ -0,0 +1,225 @@
+#include "terrain_renderer.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+TerrainRenderer::TerrainRenderer(const Terrain &terrain, UploadPath requested)
+    : vertexFormat(terrain.getVertexFormat()), gridSize(static_cast<GLint>(terrain.gridSize())),
+      cellSpacing(terrain.spacing()), chunks(terrain.gridSize(), terrain.spacing()) {
+  // chunk index patterns, each draw offsets them to its chunk with a base vertex
+  const std::vector<std::uint32_t> &connections = chunks.indexData();
+  chunks.recomputeBounds(terrain.heightData());
+  vertexCount = static_cast<GLint>(terrain.cellCount());
+  vertexBytes = terrain.uploadVertexBytes();
+  segmentBytes = terrain.cellCount() * vertexBytes;
+
+  glGenVertexArrays(1, &this->VAO);
+  glBindVertexArray(this->VAO);
+  glGenBuffers(1, &this->EBO);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, connections.size() * sizeof(std::uint32_t),
+               connections.data(), GL_STATIC_DRAW);
+  // memory chunks fed from cpu to gpu to handle graphics rendering
+  glGenBuffers(1, &this->VBO);
+  // static draw tells the GPU data is set once and used multiple times
+  glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+  // copies user defined data into bound buffer
+  // dynamic draw tells the gpu driver that this buffer will be updated frequently so allocate
+  // memory to optimize for this
+  if (requested == UploadPath::Ring && createRing(terrain.uploadData())) {
+    uploadPath = UploadPath::Ring;
+  } else {
+    if (requested == UploadPath::Ring) {
+      std::cerr << "ARB_buffer_storage not available, falling back to glBufferSubData uploads\n";
+    }
+    glBufferData(GL_ARRAY_BUFFER, segmentBytes, terrain.uploadData(), GL_DYNAMIC_DRAW);
+  }
+
+  if (vertexFormat == VertexFormat::Height) {
+    // no vertex attributes: terrain_height.vert reads the heights through a buffer texture
+    // and works out the grid position from gl_VertexID
+    glGenTextures(1, &this->heightTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, this->heightTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, this->VBO);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    return;
+  }
+
+  if (vertexFormat == VertexFormat::Packed) {
+    // terrain_packed.vert takes x/z from gl_VertexID, only height and normal are attributes
+    // height: attribute 0, half float at offset 0
+    glVertexAttribPointer(0, 1, GL_HALF_FLOAT, GL_FALSE, sizeof(std::uint32_t), (void *)0);
+    glEnableVertexAttribArray(0);
+    // octahedral normal: attribute 1, two signed bytes at offset 2 kept as integers
+    glVertexAttribIPointer(1, 2, GL_BYTE, sizeof(std::uint32_t), (void *)2);
+    glEnableVertexAttribArray(1);
+    return;
+  }
+
+  // tells opengl how to read position data from the buffer
+  // we have the vector and its normal vector both stored so there is two calls to read
+  // one is standard vectors, the other is starting from the normals
+
+  // position: attribute 0, offset 0
+  // index, component #, data type, normalize?, stride, offset
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
+  glEnableVertexAttribArray(0);
+
+  // normal: attribute 1, offset 3 floats
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
+  glEnableVertexAttribArray(1);
+}
+
+bool TerrainRenderer::createRing(const void *data) {
+  if (!GLAD_GL_ARB_buffer_storage || glBufferStorage == nullptr) {
+    return false;
+  }
+
+  // coherent so writes through the pointer are visible to the next draw without a flush,
+  // the fences below are what keep the CPU off the segment the GPU is reading
+  const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  glBufferStorage(GL_ARRAY_BUFFER, RING_SEGMENTS * segmentBytes, nullptr, flags);
+  mapped = static_cast<unsigned char *>(
+      glMapBufferRange(GL_ARRAY_BUFFER, 0, RING_SEGMENTS * segmentBytes, flags));
+  if (mapped == nullptr) {
+    return false;
+  }
+  for (std::size_t s = 0; s < RING_SEGMENTS; ++s) {
+    std::memcpy(mapped + s * segmentBytes, data, segmentBytes);
+    staleRanges[s].reserve(MAX_STALE_RANGES);
+  }
+  return true;
+}
+
+TerrainRenderer::~TerrainRenderer() {
+  for (GLsync fence : fences) {
+    if (fence != nullptr) {
+      glDeleteSync(fence);
+    }
+  }
+  if (mapped != nullptr) {
+    glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+  }
+  if (heightTexture != 0) {
+    glDeleteTextures(1, &this->heightTexture);
+  }
+  glDeleteBuffers(1, &this->VBO);
+  glDeleteBuffers(1, &this->EBO);
+  glDeleteVertexArrays(1, &this->VAO);
+}
+
+void TerrainRenderer::upload(const Terrain &terrain, const std::vector<VertexRange> &ranges) {
+  upload(terrain.uploadData(), terrain.heightData(), ranges);
+}
+
+void TerrainRenderer::upload(const void *vertexData, const std::vector<float> &heights,
+                             const std::vector<VertexRange> &ranges) {
+  const std::size_t stride = vertexBytes;
+  const auto *source = static_cast<const unsigned char *>(vertexData);
+  chunks.updateBounds(heights, ranges);
+  if (uploadPath == UploadPath::SubData) {
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    for (const VertexRange &range : ranges) {
+      const std::size_t byteOffset = range.first * stride;
+      const std::size_t byteSize = range.count * stride;
+      glBufferSubData(GL_ARRAY_BUFFER, byteOffset, byteSize, source + byteOffset);
+    }
+    return;
+  }
+
+  // every segment misses these ranges until it is next written
+  for (std::size_t s = 0; s < RING_SEGMENTS; ++s) {
+    if (staleEverything[s]) {
+      continue;
+    }
+    if (staleRanges[s].size() + ranges.size() > MAX_STALE_RANGES) {
+      staleEverything[s] = true;
+      staleRanges[s].clear();
+      continue;
+    }
+    staleRanges[s].insert(staleRanges[s].end(), ranges.begin(), ranges.end());
+  }
+
+  // move on to the oldest segment, waiting only if the GPU hasn't finished drawing from it
+  segment = (segment + 1) % RING_SEGMENTS;
+  if (GLsync fence = fences[segment]) {
+    const auto waitStart = std::chrono::steady_clock::now();
+    GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    while (status == GL_TIMEOUT_EXPIRED) {
+      status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+    }
+    const auto waitEnd = std::chrono::steady_clock::now();
+    fenceWaitMs += std::chrono::duration<double, std::milli>(waitEnd - waitStart).count();
+    glDeleteSync(fence);
+    fences[segment] = nullptr;
+  }
+
+  unsigned char *target = mapped + segment * segmentBytes;
+  if (staleEverything[segment]) {
+    std::memcpy(target, source, segmentBytes);
+    staleEverything[segment] = false;
+  } else {
+    for (const VertexRange &range : staleRanges[segment]) {
+      std::memcpy(target + range.first * stride, source + range.first * stride,
+                  range.count * stride);
+    }
+  }
+  staleRanges[segment].clear();
+}
+
+TerrainDrawStats TerrainRenderer::draw(Shader &shader, const glm::mat4 &vp, const glm::vec3 &eye) {
+  TerrainDrawStats stats = chunks.select(vp, eye, lodDistance, drawList);
+  shader.uniformInfo("mvp", vp);
+  shader.uniformInfo("objectColour", glm::vec3(0.55f, 0.36f, 0.2f));
+  glBindVertexArray(VAO);
+  const GLint firstVertex = static_cast<GLint>(segment) * vertexCount;
+  if (vertexFormat == VertexFormat::Height) {
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, heightTexture);
+    shader.uniformInfo("heights", 0);
+    shader.uniformInfo("gridSize", gridSize);
+    shader.uniformInfo("spacing", cellSpacing);
+    // gl_VertexID already includes the chunk's base vertex, the segment goes in as an offset
+    shader.uniformInfo("heightBase", firstVertex);
+  } else if (vertexFormat == VertexFormat::Packed) {
+    shader.uniformInfo("gridSize", gridSize);
+    shader.uniformInfo("spacing", cellSpacing);
+    // gl_VertexID includes the segment offset added below, the shader takes it back off
+    shader.uniformInfo("vertexBase", firstVertex);
+  }
+  if (vertexFormat != VertexFormat::Height && firstVertex != 0) {
+    // same indices for every segment, the base vertex also picks which copy is read
+    for (GLint &baseVertex : drawList.baseVertices) {
+      baseVertex += firstVertex;
+    }
+  }
+  if (!drawList.counts.empty()) {
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawList.counts.data(), GL_UNSIGNED_INT,
+                                  drawList.offsets.data(),
+                                  static_cast<GLsizei>(drawList.counts.size()),
+                                  drawList.baseVertices.data());
+  }
+  if (uploadPath == UploadPath::SubData) {
+    return stats;
+  }
+
+  if (fences[segment] != nullptr) {
+    glDeleteSync(fences[segment]);
+  }
+  fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  return stats;
+}
+
+double TerrainRenderer::takeFenceWaitMs() {
+  const double waited = fenceWaitMs;
+  fenceWaitMs = 0.0;
+  return waited;
+}
+
+GLint TerrainRenderer::maxHeightTexels() {
+  GLint texels = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &texels);
+  return texels;
+}
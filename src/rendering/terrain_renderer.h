@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "../simulation/terrain.h"
+#include "chunk_grid.h"
+#include "glad/gl.h"
+#include "shader.h"
+#include "upload_path.h"
+
+// owns the GPU side of a Terrain: vertex/index buffers and the draw call
+class TerrainRenderer {
+private:
+  // frames the GPU may still be reading while the CPU writes the next one
+  static constexpr std::size_t RING_SEGMENTS = 3;
+  // past this many queued ranges a segment is just recopied in full
+  static constexpr std::size_t MAX_STALE_RANGES = 256;
+
+  GLuint VBO; // vertex buffer object
+  GLuint VAO; // vertex array object (how to read the vbo)
+  GLuint EBO; // element buffer object
+  GLint vertexCount = 0;
+  VertexFormat vertexFormat;
+  std::size_t vertexBytes = 0;
+  // bytes per copy of the vertex data
+  std::size_t segmentBytes = 0;
+  // VertexFormat::Height reads the buffer through this instead of vertex attributes
+  GLuint heightTexture = 0;
+  GLint gridSize;
+  float cellSpacing;
+  ChunkGrid chunks;
+  // reused every frame, filled by ChunkGrid::select
+  ChunkDrawList drawList;
+  float lodDistance = ChunkGrid::defaultLodDistance();
+
+  UploadPath uploadPath = UploadPath::SubData;
+  // ring path: RING_SEGMENTS full copies of the vertex data back to back in one mapped buffer
+  unsigned char *mapped = nullptr;
+  std::size_t segment = 0;
+  std::array<GLsync, RING_SEGMENTS> fences{};
+  // ranges each segment is missing because they changed while another segment was current
+  std::array<std::vector<VertexRange>, RING_SEGMENTS> staleRanges;
+  std::array<bool, RING_SEGMENTS> staleEverything{};
+  double fenceWaitMs = 0.0;
+
+  bool createRing(const void *data);
+
+public:
+  // falls back to UploadPath::SubData when the ring path isn't supported
+  TerrainRenderer(const Terrain &terrain, UploadPath requested = UploadPath::SubData);
+  ~TerrainRenderer();
+  TerrainRenderer(const TerrainRenderer &) = delete;
+  TerrainRenderer &operator=(const TerrainRenderer &) = delete;
+  // copies the given vertex ranges from the terrain into the GPU buffer, one write per range
+  void upload(const Terrain &terrain, const std::vector<VertexRange> &ranges);
+  // same from a copy of the terrain's upload data and heights (see TerrainSnapshot)
+  void upload(const void *vertexData, const std::vector<float> &heights,
+              const std::vector<VertexRange> &ranges);
+  // draws the chunks inside the view frustum, eye picks each chunk's level of detail
+  TerrainDrawStats draw(Shader &, const glm::mat4 &vp, const glm::vec3 &eye);
+  // in chunk widths, 0 draws everything at full detail
+  void setLodDistance(float chunkWidths) { lodDistance = chunkWidths; }
+  UploadPath getUploadPath() const { return uploadPath; }
+  // time blocked on fences since the last call, always 0 on the SubData path
+  double takeFenceWaitMs();
+  // largest buffer texture the driver allows, VertexFormat::Height needs a texel per cell
+  // (three per cell with the ring path)
+  static GLint maxHeightTexels();
+};
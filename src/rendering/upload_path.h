@@ -0,0 +1,19 @@
+#pragma once
+
+// how vertex changes reach the GPU, kept GL-free so the options can name it
+enum class UploadPath {
+  // glBufferSubData into a single dynamic buffer, the driver may stall on in-flight frames
+  SubData,
+  // persistently mapped ring of buffer copies, fenced per frame (needs ARB_buffer_storage)
+  Ring,
+};
+
+inline const char *uploadPathName(UploadPath path) {
+  switch (path) {
+  case UploadPath::SubData:
+    return "subdata";
+  case UploadPath::Ring:
+    return "ring";
+  }
+  return "unknown";
+}
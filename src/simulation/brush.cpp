@@ -0,0 +1,227 @@
+#include "brush.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+#include <random>
+#include <utility>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define EXCAVATION_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace {
+// weight at normalized distance t from the centre (0 centre, 1 edge), full strength inside
+// 1 - falloff and a smoothstep down to 0 at the edge
+float falloffWeight(float t, float falloff) {
+  if (t >= 1.0f) {
+    return 0.0f;
+  }
+  if (falloff <= 0.0f || t <= 1.0f - falloff) {
+    return 1.0f;
+  }
+  const float s = (1.0f - t) / falloff;
+  return s * s * (3.0f - 2.0f * s);
+}
+
+// cell centre mapped to -1..1 across a footprint of n cells
+float normalizedCentre(std::size_t index, std::size_t n) {
+  return (static_cast<float>(index) + 0.5f) / static_cast<float>(n) * 2.0f - 1.0f;
+}
+
+inline void stampCells(float *heights, const float *weights, float scale, std::size_t begin,
+                       std::size_t end) {
+  for (std::size_t c = begin; c < end; ++c) {
+    heights[c] += weights[c] * scale;
+  }
+}
+
+void stampRowScalar(float *heights, const float *weights, std::size_t count, float scale) {
+  stampCells(heights, weights, scale, 0, count);
+}
+
+#ifdef EXCAVATION_X86_KERNELS
+__attribute__((target("sse2"))) void stampRowSse2(float *heights, const float *weights,
+                                                  std::size_t count, float scale) {
+  const __m128 vScale = _mm_set1_ps(scale);
+  std::size_t c = 0;
+  for (; c + 4 <= count; c += 4) {
+    const __m128 moved = _mm_mul_ps(_mm_loadu_ps(weights + c), vScale);
+    _mm_storeu_ps(heights + c, _mm_add_ps(_mm_loadu_ps(heights + c), moved));
+  }
+  stampCells(heights, weights, scale, c, count);
+}
+
+__attribute__((target("avx2"))) void stampRowAvx2(float *heights, const float *weights,
+                                                  std::size_t count, float scale) {
+  const __m256 vScale = _mm256_set1_ps(scale);
+  std::size_t c = 0;
+  for (; c + 8 <= count; c += 8) {
+    const __m256 moved = _mm256_mul_ps(_mm256_loadu_ps(weights + c), vScale);
+    _mm256_storeu_ps(heights + c, _mm256_add_ps(_mm256_loadu_ps(heights + c), moved));
+  }
+  stampCells(heights, weights, scale, c, count);
+}
+
+__attribute__((target("avx512f"))) void stampRowAvx512(float *heights, const float *weights,
+                                                       std::size_t count, float scale) {
+  const __m512 vScale = _mm512_set1_ps(scale);
+  std::size_t c = 0;
+  for (; c + 16 <= count; c += 16) {
+    const __m512 moved = _mm512_mul_ps(_mm512_loadu_ps(weights + c), vScale);
+    _mm512_storeu_ps(heights + c, _mm512_add_ps(_mm512_loadu_ps(heights + c), moved));
+  }
+  stampCells(heights, weights, scale, c, count);
+}
+#endif
+} // namespace
+
+Brush::Brush(std::size_t rows, std::size_t cols, std::vector<float> weights)
+    : footprintRows(rows), footprintCols(cols), weights(std::move(weights)), spans(rows) {
+  for (std::size_t r = 0; r < footprintRows; ++r) {
+    const float *row = rowWeights(r);
+    for (std::size_t c = 0; c < footprintCols; ++c) {
+      if (row[c] == 0.0f) {
+        continue;
+      }
+      ColumnSpan &span = spans[r];
+      if (span.empty()) {
+        span.first = static_cast<std::uint32_t>(c);
+      }
+      span.last = static_cast<std::uint32_t>(c);
+      totalWeight += row[c];
+      ++coveredCells;
+    }
+  }
+}
+
+Brush Brush::point() {
+  return Brush(3, 3, {0.0f, 0.5f, 0.0f, 0.5f, 1.0f, 0.5f, 0.0f, 0.5f, 0.0f});
+}
+
+Brush Brush::rectangle(std::size_t rows, std::size_t cols, float falloff, std::size_t teeth,
+                       std::size_t toothRows, float toothRelief) {
+  rows = std::max<std::size_t>(rows, 1);
+  cols = std::max<std::size_t>(cols, 1);
+  std::vector<float> weights(rows * cols);
+  for (std::size_t r = 0; r < rows; ++r) {
+    const float v = std::abs(normalizedCentre(r, rows));
+    for (std::size_t c = 0; c < cols; ++c) {
+      const float u = std::abs(normalizedCentre(c, cols));
+      float weight = falloffWeight(std::max(u, v), falloff);
+      if (teeth > 0 && r < toothRows) {
+        // each tooth takes the middle half of its share of the lip
+        const float slot = (static_cast<float>(c) + 0.5f) * static_cast<float>(teeth) /
+                           static_cast<float>(cols);
+        const float within = slot - std::floor(slot);
+        if (within < 0.25f || within >= 0.75f) {
+          weight *= toothRelief;
+        }
+      }
+      weights[r * cols + c] = weight;
+    }
+  }
+  return Brush(rows, cols, std::move(weights));
+}
+
+Brush Brush::ellipse(std::size_t rows, std::size_t cols, float falloff) {
+  rows = std::max<std::size_t>(rows, 1);
+  cols = std::max<std::size_t>(cols, 1);
+  std::vector<float> weights(rows * cols);
+  for (std::size_t r = 0; r < rows; ++r) {
+    const float v = normalizedCentre(r, rows);
+    for (std::size_t c = 0; c < cols; ++c) {
+      const float u = normalizedCentre(c, cols);
+      weights[r * cols + c] = falloffWeight(std::sqrt(u * u + v * v), falloff);
+    }
+  }
+  return Brush(rows, cols, std::move(weights));
+}
+
+Brush Brush::mask(std::size_t rows, std::size_t cols, std::vector<float> weights) {
+  weights.resize(rows * cols, 0.0f);
+  return Brush(rows, cols, std::move(weights));
+}
+
+Brush Brush::fromShape(BrushShape shape, std::size_t size) {
+  switch (shape) {
+  case BrushShape::Point:
+    break;
+  case BrushShape::Rectangle: {
+    // a lip twice as wide as it is deep, one tooth per 4 cells once there's room for them
+    const std::size_t rows = (size + 1) / 2;
+    const std::size_t teeth = size >= 8 ? size / 4 : 0;
+    return rectangle(rows, size, 0.25f, teeth, std::max<std::size_t>(rows / 4, 1));
+  }
+  case BrushShape::Ellipse:
+    return ellipse(size, size, 0.5f);
+  }
+  return point();
+}
+
+const char *brushShapeName(BrushShape shape) {
+  switch (shape) {
+  case BrushShape::Point:
+    return "point";
+  case BrushShape::Rectangle:
+    return "rect";
+  case BrushShape::Ellipse:
+    return "ellipse";
+  }
+  return "unknown";
+}
+
+StampRowKernel stampRowKernel(SimdLevel level) {
+#ifdef EXCAVATION_X86_KERNELS
+  switch (clampSimdLevel(level)) {
+  case SimdLevel::Avx512:
+    return stampRowAvx512;
+  case SimdLevel::Avx2:
+    return stampRowAvx2;
+  case SimdLevel::Sse2:
+    return stampRowSse2;
+  case SimdLevel::Scalar:
+    break;
+  }
+#else
+  (void)level;
+#endif
+  return stampRowScalar;
+}
+
+bool selfCheckStampKernels(std::ostream &out) {
+  constexpr int trials = 2000;
+  const SimdLevel best = detectSimdLevel();
+  std::mt19937 random(7);
+  std::uniform_int_distribution<std::size_t> widths(1, 300);
+  std::uniform_real_distribution<float> values(-1.0f, 1.0f);
+
+  out << "Brush stamp kernel self-check\n";
+  bool passed = true;
+  for (int level = static_cast<int>(SimdLevel::Sse2); level <= static_cast<int>(best); ++level) {
+    const StampRowKernel kernel = stampRowKernel(static_cast<SimdLevel>(level));
+    std::size_t mismatches = 0;
+    for (int trial = 0; trial < trials; ++trial) {
+      const std::size_t width = widths(random);
+      const float scale = values(random) / 60.0f;
+      std::vector<float> weights(width), expected(width);
+      for (std::size_t c = 0; c < width; ++c) {
+        weights[c] = values(random);
+        expected[c] = values(random);
+      }
+      std::vector<float> actual = expected;
+      stampRowScalar(expected.data(), weights.data(), width, scale);
+      kernel(actual.data(), weights.data(), width, scale);
+      if (std::memcmp(expected.data(), actual.data(), width * sizeof(float)) != 0) {
+        ++mismatches;
+      }
+    }
+    out << "  " << std::setw(6) << simdLevelName(static_cast<SimdLevel>(level)) << ": " << trials
+        << " random rows, " << (mismatches == 0 ? "bit-identical" : "MISMATCH") << '\n';
+    passed = passed && mismatches == 0;
+  }
+  return passed;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+#include <vector>
+
+#include "dirty_region.h"
+#include "settle_kernel.h"
+
+// footprint shapes for --brush
+enum class BrushShape {
+  // the original single-cell edit, the cell plus half as much on its four neighbours
+  Point,
+  // bucket lip: a rectangle whose leading rows are cut by teeth
+  Rectangle,
+  Ellipse,
+};
+
+// a bucket footprint, rasterized once into per-cell weights around the edited cell
+// an edit moves dt * weight of material per covered cell, so the full-strength cells match the
+// centre of a point edit
+class Brush {
+public:
+  // the legacy cross, weights 1 in the centre and 0.5 on the four neighbours
+  static Brush point();
+  // rows along the direction of travel, cols across the lip
+  // falloff is the fraction of each half-extent over which the weight fades to 0 at the edge,
+  // teeth > 0 cuts the first toothRows rows down to toothRelief between evenly spaced teeth
+  static Brush rectangle(std::size_t rows, std::size_t cols, float falloff, std::size_t teeth = 0,
+                         std::size_t toothRows = 0, float toothRelief = 0.25f);
+  static Brush ellipse(std::size_t rows, std::size_t cols, float falloff);
+  // custom height mask, row-major rows * cols weights, negative weights are allowed
+  static Brush mask(std::size_t rows, std::size_t cols, std::vector<float> weights);
+  // the --brush/--brush-size presets shared by the viewer and the headless benchmark
+  static Brush fromShape(BrushShape shape, std::size_t size);
+
+  std::size_t rows() const { return footprintRows; }
+  std::size_t cols() const { return footprintCols; }
+  // the footprint is centred on the edited cell, rounding towards the top/left
+  std::size_t centreRow() const { return footprintRows / 2; }
+  std::size_t centreCol() const { return footprintCols / 2; }
+  const float *rowWeights(std::size_t row) const { return &weights[row * footprintCols]; }
+  // first..last column with a nonzero weight per row, empty for rows that don't touch anything
+  const ColumnSpan &rowSpan(std::size_t row) const { return spans[row]; }
+  // sum of the weights, the material one edit moves per unit of dt before clipping at the grid
+  float volume() const { return totalWeight; }
+  // cells with a nonzero weight
+  std::size_t cellCount() const { return coveredCells; }
+
+private:
+  Brush(std::size_t rows, std::size_t cols, std::vector<float> weights);
+
+  std::size_t footprintRows;
+  std::size_t footprintCols;
+  std::vector<float> weights;
+  std::vector<ColumnSpan> spans;
+  float totalWeight = 0.0f;
+  std::size_t coveredCells = 0;
+};
+
+const char *brushShapeName(BrushShape shape);
+
+// heights[c] += weights[c] * scale over one footprint row, the product is rounded before the
+// add so every variant produces bit-identical heights
+using StampRowKernel = void (*)(float *heights, const float *weights, std::size_t count,
+                                float scale);
+
+// kernel for the requested level, clamped to what detectSimdLevel() allows
+StampRowKernel stampRowKernel(SimdLevel level);
+
+// runs every supported stamp kernel against the scalar one on random rows, false on a mismatch
+bool selfCheckStampKernels(std::ostream &out);
@@ -0,0 +1,74 @@
+#include "dirty_region.h"
+
+DirtyRegion::DirtyRegion(std::size_t gridSize) { resize(gridSize); }
+
+void DirtyRegion::resize(std::size_t gridSize) {
+  size = gridSize;
+  spans.assign(size, ColumnSpan{});
+  dirtyRows.clear();
+  dirtyRows.reserve(size);
+  original.clear();
+  original.reserve(size);
+}
+
+void DirtyRegion::dilate() {
+  if (dirtyRows.empty()) {
+    return;
+  }
+
+  // widen from a copy of the marked spans, the rows either side get merged into in place
+  original.clear();
+  for (std::uint32_t row : dirtyRows) {
+    original.push_back(spans[row]);
+  }
+  const std::size_t markedRows = dirtyRows.size();
+  for (std::size_t k = 0; k < markedRows; ++k) {
+    const std::size_t row = dirtyRows[k];
+    const std::size_t first = original[k].first > 0 ? original[k].first - 1 : 0;
+    const std::size_t last = std::min<std::size_t>(original[k].last + 1, size - 1);
+    if (row > 0) {
+      markSpan(row - 1, first, last);
+    }
+    markSpan(row, first, last);
+    if (row + 1 < size) {
+      markSpan(row + 1, first, last);
+    }
+  }
+  sortRows();
+}
+
+void DirtyRegion::clear() {
+  for (std::uint32_t row : dirtyRows) {
+    spans[row] = ColumnSpan{};
+  }
+  dirtyRows.clear();
+}
+
+std::size_t DirtyRegion::cellCount() const {
+  std::size_t count = 0;
+  for (std::uint32_t row : dirtyRows) {
+    count += spans[row].width();
+  }
+  return count;
+}
+
+std::size_t DirtyRegion::appendRanges(std::size_t maxGap, std::vector<VertexRange> &ranges) const {
+  std::size_t gapCells = 0;
+  bool merging = false;
+  for (std::uint32_t row : dirtyRows) {
+    const ColumnSpan &columns = spans[row];
+    const std::size_t first = row * size + columns.first;
+    if (merging) {
+      VertexRange &previous = ranges.back();
+      const std::size_t gap = first - (previous.first + previous.count);
+      if (gap <= maxGap) {
+        previous.count += gap + columns.width();
+        gapCells += gap;
+        continue;
+      }
+    }
+    ranges.push_back(VertexRange{first, columns.width()});
+    merging = true;
+  }
+  return gapCells;
+}
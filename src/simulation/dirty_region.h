@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// contiguous run of vertices that changed since the renderer last uploaded
+struct VertexRange {
+  std::size_t first = 0;
+  std::size_t count = 0;
+};
+
+// inclusive run of columns within one row
+struct ColumnSpan {
+  std::uint32_t first = 1;
+  std::uint32_t last = 0;
+
+  bool empty() const { return first > last; }
+  std::size_t width() const { return empty() ? 0 : last - first + 1; }
+};
+
+// cells changed since the last vertex rebuild, kept as one column span per row
+// every buffer is sized for the whole grid up front, so marking, dilating and clearing never
+// allocate, and clearing only touches the rows that were marked
+class DirtyRegion {
+public:
+  explicit DirtyRegion(std::size_t gridSize = 0);
+  void resize(std::size_t gridSize);
+
+  void mark(std::size_t row, std::size_t col) { markSpan(row, col, col); }
+  void markSpan(std::size_t row, std::size_t first, std::size_t last) {
+    ColumnSpan &span = spans[row];
+    if (span.empty()) {
+      span.first = static_cast<std::uint32_t>(first);
+      span.last = static_cast<std::uint32_t>(last);
+      dirtyRows.push_back(static_cast<std::uint32_t>(row));
+      return;
+    }
+    span.first = std::min(span.first, static_cast<std::uint32_t>(first));
+    span.last = std::max(span.last, static_cast<std::uint32_t>(last));
+  }
+
+  // grows the region by one cell in every direction (a vertex normal reads its neighbours)
+  // and leaves rows() sorted so iteration follows memory order
+  void dilate();
+  void sortRows() { std::sort(dirtyRows.begin(), dirtyRows.end()); }
+  void clear();
+
+  bool empty() const { return dirtyRows.empty(); }
+  // rows with a non-empty span, ascending after dilate()
+  const std::vector<std::uint32_t> &rows() const { return dirtyRows; }
+  const ColumnSpan &span(std::size_t row) const { return spans[row]; }
+  std::size_t cellCount() const;
+  // appends the marked cells as row-major index ranges, rows() must be sorted
+  // runs at most maxGap cells apart are merged into one range; returns how many cells the
+  // merged gaps between spans add (unmarked cells inside a span aren't known, so not counted)
+  std::size_t appendRanges(std::size_t maxGap, std::vector<VertexRange> &ranges) const;
+
+private:
+  std::size_t size = 0;
+  std::vector<ColumnSpan> spans;
+  std::vector<std::uint32_t> dirtyRows;
+  // spans as they were before dilate() started widening them
+  std::vector<ColumnSpan> original;
+};
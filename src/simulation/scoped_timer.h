@@ -0,0 +1,19 @@
+#pragma once
+
+#include <chrono>
+
+// adds the milliseconds between construction and destruction onto total
+class ScopedTimer {
+public:
+  explicit ScopedTimer(double &total) : total(total), start(std::chrono::steady_clock::now()) {}
+  ~ScopedTimer() {
+    total +=
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
+  ScopedTimer(const ScopedTimer &) = delete;
+  ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+  double &total;
+  std::chrono::steady_clock::time_point start;
+};
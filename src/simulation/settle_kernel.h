@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+
+// instruction sets the row kernel can be built for, in increasing order of width
+enum class SimdLevel { Scalar, Sse2, Avx2, Avx512 };
+
+// one row of a snapshot (jacobi) settle pass: every cell trades `step` with each of its four
+// neighbours whose height differs by more than maxDiff, reading only from the snapshot rows
+// above/below are null when that neighbour row doesn't take part in the pass
+// fluxes are summed in a fixed order (left, right, above, below) so every variant produces
+// bit-identical output
+using SettleRowKernel = void (*)(const float *above, const float *row, const float *below,
+                                 float *out, std::size_t width, float maxDiff, float step);
+
+void settleRowScalar(const float *above, const float *row, const float *below, float *out,
+                     std::size_t width, float maxDiff, float step);
+
+// widest level this CPU (and this build) supports
+SimdLevel detectSimdLevel();
+// kernel for the requested level, clamped to what detectSimdLevel() allows
+SettleRowKernel settleRowKernel(SimdLevel level);
+SimdLevel clampSimdLevel(SimdLevel level);
+const char *simdLevelName(SimdLevel level);
+
+// runs every supported kernel against the scalar reference on random heightfields and
+// times a full 1024x1024 pass per kernel; returns false on any mismatch
+bool selfCheckSettleKernels(std::ostream &out);
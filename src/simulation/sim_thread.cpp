@@ -0,0 +1,146 @@
+#include "sim_thread.h"
+
+#include <cstring>
+
+#include "../benchmark/workload.h"
+#include "../telemetry/telemetry.h"
+#include "../telemetry/trace.h"
+
+void SimulationThread::RangeBacklog::add(const std::vector<VertexRange> &more) {
+  if (everything) {
+    return;
+  }
+  if (ranges.size() + more.size() > MAX_BACKLOG_RANGES) {
+    everything = true;
+    ranges.clear();
+    return;
+  }
+  ranges.insert(ranges.end(), more.begin(), more.end());
+}
+
+void SimulationThread::RangeBacklog::clear() {
+  ranges.clear();
+  everything = false;
+}
+
+SimulationThread::SimulationThread(Terrain &terrain, float tickSeconds, std::size_t fleetSize)
+    : terrain(terrain), tickPeriod(tickSeconds), tickSeconds(tickSeconds), fleetSize(fleetSize) {
+  // every slot starts as a full copy, the renderer was built from the same terrain
+  const auto *vertexData = static_cast<const unsigned char *>(terrain.uploadData());
+  const std::size_t vertexBytes = terrain.cellCount() * terrain.uploadVertexBytes();
+  for (std::size_t s = 0; s < staleSlots.size(); ++s) {
+    TerrainSnapshot &slot = snapshots.slot(s);
+    slot.heights = terrain.heightData();
+    slot.vertices.assign(vertexData, vertexData + vertexBytes);
+    slot.uploads.reserve(MAX_BACKLOG_RANGES);
+    staleSlots[s].ranges.reserve(MAX_BACKLOG_RANGES);
+    if (fleetSize > 1) {
+      slot.fleet.resize(fleetSize);
+    }
+  }
+  fleetBatch.reserve(fleetSize);
+  unread.ranges.reserve(MAX_BACKLOG_RANGES);
+  // whatever was pending is already in the slots
+  terrain.takePendingUploads(tickRanges);
+  worker = std::thread([this] { run(); });
+}
+
+SimulationThread::~SimulationThread() {
+  running.store(false, std::memory_order_release);
+  worker.join();
+}
+
+void SimulationThread::run() {
+  TRACE_THREAD_NAME("simulation");
+  SimulationCommand latest;
+  auto nextTick = std::chrono::steady_clock::now();
+  while (running.load(std::memory_order_acquire)) {
+    SimulationCommand command;
+    while (commands.tryPop(command)) {
+      latest = command;
+    }
+    tick(latest);
+
+    // fixed schedule, a slow tick is caught up by running the next ones back to back
+    nextTick += std::chrono::duration_cast<std::chrono::steady_clock::duration>(tickPeriod);
+    const auto now = std::chrono::steady_clock::now();
+    if (now - nextTick > MAX_CATCH_UP_TICKS * tickPeriod) {
+      nextTick = now;
+    }
+    std::this_thread::sleep_until(nextTick);
+  }
+}
+
+void SimulationThread::tick(const SimulationCommand &command) {
+  TRACE_SCOPE("tick");
+  const auto tickStart = std::chrono::steady_clock::now();
+  TerrainUpdateStats tickStats;
+  if (fleetSize > 1) {
+    fleetEdits(terrain, fleetSize, tickIndex, fleetBatch);
+    accumulateTerrainStats(tickStats, terrain.modifyBatch(fleetBatch, tickSeconds));
+  } else {
+    const auto [row, col] = terrain.worldToGrid(command.bucket.x, command.bucket.y);
+    if (command.dig) {
+      accumulateTerrainStats(tickStats, terrain.modify(row, col, true, tickSeconds));
+    }
+    if (command.dump) {
+      accumulateTerrainStats(tickStats, terrain.modify(row, col, false, tickSeconds));
+    }
+  }
+  terrain.takePendingUploads(tickRanges);
+
+  // every slot lags the terrain by this tick's ranges until it is next written
+  for (RangeBacklog &stale : staleSlots) {
+    stale.add(tickRanges);
+  }
+  const std::size_t slotIndex = snapshots.writeSlot();
+  TerrainSnapshot &slot = snapshots.writeBuffer();
+  RangeBacklog &stale = staleSlots[slotIndex];
+  const auto *vertexData = static_cast<const unsigned char *>(terrain.uploadData());
+  const std::size_t vertexBytes = terrain.uploadVertexBytes();
+  const std::vector<float> &heights = terrain.heightData();
+  if (stale.everything) {
+    std::memcpy(slot.heights.data(), heights.data(), heights.size() * sizeof(float));
+    std::memcpy(slot.vertices.data(), vertexData, slot.vertices.size());
+  } else {
+    for (const VertexRange &range : stale.ranges) {
+      std::memcpy(slot.heights.data() + range.first, heights.data() + range.first,
+                  range.count * sizeof(float));
+      std::memcpy(slot.vertices.data() + range.first * vertexBytes,
+                  vertexData + range.first * vertexBytes, range.count * vertexBytes);
+    }
+  }
+  stale.clear();
+
+  const auto tickEnd = std::chrono::steady_clock::now();
+  const double tickMs = std::chrono::duration<double, std::milli>(tickEnd - tickStart).count();
+  unread.add(tickRanges);
+  accumulateTerrainStats(unreadStats, tickStats);
+  ++unreadTicks;
+  unreadTickMs += tickMs;
+
+  slot.uploads.clear();
+  if (unread.everything) {
+    slot.uploads.push_back({0, terrain.cellCount()});
+  } else {
+    slot.uploads.insert(slot.uploads.end(), unread.ranges.begin(), unread.ranges.end());
+  }
+  slot.terrainStats = unreadStats;
+  slot.ticks = unreadTicks;
+  slot.tickMs = unreadTickMs;
+  slot.publishedAt = tickEnd;
+  for (std::size_t bucket = 0; bucket < slot.fleet.size(); ++bucket) {
+    slot.fleet[bucket] = fleetBucketPosition(terrain, bucket, fleetSize, tickIndex);
+  }
+  ++tickIndex;
+
+  if (snapshots.publish()) {
+    // the render thread took the snapshot before this one, so from now on it only misses
+    // this tick; otherwise it still misses everything since the one it last took
+    unread.clear();
+    unread.add(tickRanges);
+    unreadStats = tickStats;
+    unreadTicks = 1;
+    unreadTickMs = tickMs;
+  }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <thread>
+#include <vector>
+
+#include "dirty_region.h"
+#include "spsc_queue.h"
+#include "terrain.h"
+#include "triple_buffer.h"
+
+// latest bucket state from the render thread, applied on every tick until the next one arrives
+struct SimulationCommand {
+  // world x/z
+  glm::vec2 bucket{0.0f};
+  bool dig = false;
+  bool dump = false;
+};
+
+// the terrain as of one tick, as handed to the render thread
+struct TerrainSnapshot {
+  std::vector<float> heights;
+  // Terrain::uploadData() bytes, uploadVertexBytes() per vertex
+  std::vector<unsigned char> vertices;
+  // vertices that changed since the snapshot the render thread took before this one
+  std::vector<VertexRange> uploads;
+  // everything below also covers every tick since that snapshot
+  TerrainUpdateStats terrainStats;
+  std::size_t ticks = 0;
+  double tickMs = 0.0;
+  std::chrono::steady_clock::time_point publishedAt;
+  // world x/z of every scripted bucket as of this tick, empty without a fleet
+  std::vector<glm::vec2> fleet;
+};
+
+// runs Terrain::modify at a fixed tick on its own thread, or with a fleet the scripted
+// --buckets edits through Terrain::modifyBatch, which ignores the submitted commands
+// the terrain belongs to this thread from construction until the destructor has joined it,
+// the render thread only sees it through snapshots
+class SimulationThread {
+public:
+  SimulationThread(Terrain &terrain, float tickSeconds, std::size_t fleetSize = 1);
+  ~SimulationThread();
+  SimulationThread(const SimulationThread &) = delete;
+  SimulationThread &operator=(const SimulationThread &) = delete;
+
+  // render thread side
+  // false if the tick thread is too far behind to take it, the next frame's command replaces it
+  bool submit(const SimulationCommand &command) { return commands.tryPush(command); }
+  // swaps in the newest snapshot, false if no tick finished since the last call
+  bool acquire() { return snapshots.acquire(); }
+  const TerrainSnapshot &snapshot() const { return snapshots.readBuffer(); }
+
+private:
+  static constexpr std::size_t COMMAND_CAPACITY = 64;
+  // past this many ranges a backlog is just the whole grid
+  static constexpr std::size_t MAX_BACKLOG_RANGES = 256;
+  // ticks run back to back after a stall before the schedule gives up and resets
+  static constexpr std::size_t MAX_CATCH_UP_TICKS = 4;
+
+  // vertex ranges someone has fallen behind on
+  struct RangeBacklog {
+    std::vector<VertexRange> ranges;
+    bool everything = false;
+
+    void add(const std::vector<VertexRange> &more);
+    void clear();
+  };
+
+  void run();
+  void tick(const SimulationCommand &command);
+
+  Terrain &terrain;
+  std::chrono::duration<double> tickPeriod;
+  float tickSeconds;
+  std::size_t fleetSize;
+  std::size_t tickIndex = 0;
+  SpscQueue<SimulationCommand, COMMAND_CAPACITY> commands;
+  TripleBuffer<TerrainSnapshot> snapshots;
+  // ranges each snapshot slot is missing because they changed while another slot was written
+  std::array<RangeBacklog, 3> staleSlots;
+  // what the render thread hasn't taken yet, since the last snapshot it did take
+  RangeBacklog unread;
+  TerrainUpdateStats unreadStats;
+  std::size_t unreadTicks = 0;
+  double unreadTickMs = 0.0;
+  // reused every tick
+  std::vector<VertexRange> tickRanges;
+  std::vector<TerrainEdit> fleetBatch;
+  std::atomic<bool> running{true};
+  std::thread worker;
+};
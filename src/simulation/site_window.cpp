@@ -0,0 +1,142 @@
+#include "site_window.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "terrain.h"
+
+SiteWindow::SiteWindow(TileStore &store, Terrain &terrain, glm::vec2 site)
+    : store(store), terrain(terrain), windowTiles(terrain.gridSize() / store.tileSize()),
+      scratch(terrain.cellCount()) {
+  const float tileWorld = static_cast<float>(store.tileSize()) * store.spacing();
+  load(originFor(site.x / tileWorld), originFor(site.y / tileWorld));
+}
+
+std::size_t SiteWindow::windowSize(std::size_t gridSize, const TileStore &store) {
+  const std::size_t tiles = (gridSize + store.tileSize() - 1) / store.tileSize();
+  return std::min(tiles, store.tileCount()) * store.tileSize();
+}
+
+glm::vec2 SiteWindow::update(glm::vec2 camera, glm::vec2 heading) {
+  const glm::vec2 tile = tilePosition(camera);
+  const float half = static_cast<float>(windowTiles) * 0.5f;
+  // a quarter of the window either way, and never less than a bit past the next tile edge, so
+  // hovering on a boundary doesn't reload the window every frame
+  const float slack = std::max(half * 0.5f, 0.75f);
+  glm::vec2 moved(0.0f);
+  if (std::abs(tile.x - (static_cast<float>(originRow) + half)) > slack ||
+      std::abs(tile.y - (static_cast<float>(originCol) + half)) > slack) {
+    const std::size_t row = originFor(tile.x);
+    const std::size_t col = originFor(tile.y);
+    // clamped at the site's edge, the window can't follow any further
+    if (row != originRow || col != originCol) {
+      const float tileWorld = static_cast<float>(store.tileSize()) * store.spacing();
+      moved = glm::vec2(static_cast<float>(row) - static_cast<float>(originRow),
+                        static_cast<float>(col) - static_cast<float>(originCol)) *
+              tileWorld;
+      writeBack();
+      load(row, col);
+      ++moves;
+    }
+  }
+  queuePrefetch(tilePosition(camera - moved), heading);
+  return moved;
+}
+
+void SiteWindow::writeBack() {
+  const DirtyRegion &unsaved = terrain.unsavedRegion();
+  if (unsaved.empty()) {
+    return;
+  }
+  const std::size_t tileSize = store.tileSize();
+  const std::size_t gridSize = terrain.gridSize();
+  // one flag per window tile, an edit near a corner dirties up to four
+  std::vector<unsigned char> edited(windowTiles * windowTiles, 0);
+  for (const std::uint32_t row : unsaved.rows()) {
+    const ColumnSpan &span = unsaved.span(row);
+    for (std::size_t tileCol = span.first / tileSize; tileCol <= span.last / tileSize;
+         ++tileCol) {
+      edited[(row / tileSize) * windowTiles + tileCol] = 1;
+    }
+  }
+  const float *heights = terrain.heightData().data();
+  for (std::size_t r = 0; r < windowTiles; ++r) {
+    for (std::size_t c = 0; c < windowTiles; ++c) {
+      if (edited[r * windowTiles + c]) {
+        store.write(originRow + r, originCol + c, heights + r * tileSize * gridSize + c * tileSize,
+                    gridSize);
+      }
+    }
+  }
+  terrain.markSaved();
+}
+
+glm::vec2 SiteWindow::origin() const {
+  const float tileWorld = static_cast<float>(store.tileSize()) * store.spacing();
+  return glm::vec2(static_cast<float>(originRow), static_cast<float>(originCol)) * tileWorld;
+}
+
+glm::vec2 SiteWindow::tilePosition(glm::vec2 local) const {
+  const float tileWorld = static_cast<float>(store.tileSize()) * store.spacing();
+  return glm::vec2(static_cast<float>(originRow), static_cast<float>(originCol)) +
+         local * (1.0f / tileWorld);
+}
+
+std::size_t SiteWindow::originFor(float tile) const {
+  const float last = static_cast<float>(store.tileCount() - windowTiles);
+  const float first = std::floor(tile - static_cast<float>(windowTiles) * 0.5f + 0.5f);
+  return static_cast<std::size_t>(std::clamp(first, 0.0f, last));
+}
+
+void SiteWindow::load(std::size_t tileRow, std::size_t tileCol) {
+  const std::size_t tileSize = store.tileSize();
+  const std::size_t gridSize = terrain.gridSize();
+  for (std::size_t r = 0; r < windowTiles; ++r) {
+    for (std::size_t c = 0; c < windowTiles; ++c) {
+      store.read(tileRow + r, tileCol + c, &scratch[r * tileSize * gridSize + c * tileSize],
+                 gridSize);
+    }
+  }
+  originRow = tileRow;
+  originCol = tileCol;
+  // every vertex is rebuilt and re-uploaded through the usual dirty ranges
+  terrain.setHeights(scratch);
+  terrain.markSaved();
+}
+
+void SiteWindow::queuePrefetch(glm::vec2 tile, glm::vec2 heading) {
+  // half a window ahead, the window the camera is on its way to
+  glm::vec2 predicted = tile;
+  if (glm::length(heading) > 0.0f) {
+    predicted = predicted + glm::normalize(heading) * (static_cast<float>(windowTiles) * 0.5f);
+  }
+  // that window and a ring of one tile around it, less what's loaded already
+  const std::size_t count = store.tileCount();
+  const std::size_t firstRow = originFor(predicted.x);
+  const std::size_t firstCol = originFor(predicted.y);
+  ahead.clear();
+  for (std::size_t r = firstRow > 0 ? firstRow - 1 : 0;
+       r < std::min(firstRow + windowTiles + 1, count); ++r) {
+    for (std::size_t c = firstCol > 0 ? firstCol - 1 : 0;
+         c < std::min(firstCol + windowTiles + 1, count); ++c) {
+      const bool inWindow = r >= originRow && r < originRow + windowTiles && c >= originCol &&
+                            c < originCol + windowTiles;
+      if (!inWindow) {
+        ahead.emplace_back(r, c);
+      }
+    }
+  }
+  const auto distance = [&](const TileCoord &coord) {
+    const glm::vec2 centre(static_cast<float>(coord.first) + 0.5f,
+                           static_cast<float>(coord.second) + 0.5f);
+    return glm::dot(centre - predicted, centre - predicted);
+  };
+  std::sort(ahead.begin(), ahead.end(), [&](const TileCoord &a, const TileCoord &b) {
+    return distance(a) < distance(b);
+  });
+  // only re-queued when the list or its order changes, not every frame
+  if (ahead != lastAhead) {
+    lastAhead = ahead;
+    store.prefetch(ahead);
+  }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "tile_store.h"
+
+class Terrain;
+
+// --site: the part of a TileStore that's simulated and drawn, a square of whole tiles copied
+// into a Terrain. x/z here are the Terrain's own world coordinates (x along rows, z along
+// columns), the window's corner sits at origin() in the site
+class SiteWindow {
+public:
+  // the terrain's grid must be a whole number of tiles no bigger than the site, see windowSize()
+  // loads the window centred on site (site world coordinates)
+  SiteWindow(TileStore &store, Terrain &terrain, glm::vec2 site);
+
+  // --grid rounded up to whole tiles and clamped to the site
+  static std::size_t windowSize(std::size_t gridSize, const TileStore &store);
+
+  // camera is where the viewer is in terrain coordinates and heading which way it's moving
+  // (any length, zero when it isn't). queues the tiles it's heading for with the I/O thread and
+  // moves the window once the camera has strayed far enough from its centre; returns how far
+  // the window moved, subtract it from anything kept in terrain coordinates
+  glm::vec2 update(glm::vec2 camera, glm::vec2 heading);
+  // stores every tile of the window that's been edited since it was loaded
+  void writeBack();
+
+  glm::vec2 origin() const;
+  std::size_t recentres() const { return moves; }
+
+private:
+  // tile coordinates (fractional) of a terrain position
+  glm::vec2 tilePosition(glm::vec2 local) const;
+  // first tile of the window that would be centred on a site tile position
+  std::size_t originFor(float tile) const;
+  void load(std::size_t tileRow, std::size_t tileCol);
+  void queuePrefetch(glm::vec2 tile, glm::vec2 heading);
+
+  TileStore &store;
+  Terrain &terrain;
+  std::size_t windowTiles;
+  std::size_t originRow = 0;
+  std::size_t originCol = 0;
+  std::size_t moves = 0;
+  // the window's heights as they're gathered, reused by every load
+  std::vector<float> scratch;
+  std::vector<TileCoord> ahead;
+  std::vector<TileCoord> lastAhead;
+};
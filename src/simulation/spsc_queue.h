@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// bounded single-producer single-consumer queue, no locks and no allocation after construction
+// exactly one thread may push and exactly one (other) thread may pop
+template <typename T, std::size_t Capacity> class SpscQueue {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "capacity must be a power of two");
+
+public:
+  // false when the queue is full, the value is dropped
+  bool tryPush(const T &value) {
+    const std::size_t tail = tailIndex.load(std::memory_order_relaxed);
+    if (tail - cachedHead == Capacity) {
+      cachedHead = headIndex.load(std::memory_order_acquire);
+      if (tail - cachedHead == Capacity) {
+        return false;
+      }
+    }
+    items[tail & (Capacity - 1)] = value;
+    tailIndex.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // false when the queue is empty
+  bool tryPop(T &value) {
+    const std::size_t head = headIndex.load(std::memory_order_relaxed);
+    if (head == cachedTail) {
+      cachedTail = tailIndex.load(std::memory_order_acquire);
+      if (head == cachedTail) {
+        return false;
+      }
+    }
+    value = items[head & (Capacity - 1)];
+    headIndex.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  // indices only ever grow, the slot is index & (Capacity - 1)
+  // each side keeps its own index and a stale copy of the other's on separate cache lines,
+  // so the shared atomics are only touched when the copy says full or empty
+  alignas(64) std::atomic<std::size_t> headIndex{0};
+  std::size_t cachedTail = 0;
+  alignas(64) std::atomic<std::size_t> tailIndex{0};
+  std::size_t cachedHead = 0;
+  alignas(64) std::array<T, Capacity> items{};
+};
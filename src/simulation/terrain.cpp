@@ -1,14 +1,36 @@
 #include "terrain.h"
 
 #include <algorithm>
+#include <array>
 #include <chrono>
 #include <cmath>
-#include <unordered_set>
+#include <cstring>
+#include <thread>
+
+#include "../telemetry/trace.h"
+#include "scoped_timer.h"
+#include "settle_kernel.h"
+#include "vertex_packing.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+// the pass that just ended, if it's the slowest so far, and when the next one starts
+void endSettlePass(Clock::time_point &passStart, double &slowestPassMs) {
+  const Clock::time_point now = Clock::now();
+  TRACE_COMPLETE("settle pass", passStart, now);
+  slowestPassMs =
+      std::max(slowestPassMs, std::chrono::duration<double, std::milli>(now - passStart).count());
+  passStart = now;
+}
+} // namespace
 
 // private functions
-float Terrain::heightFunction(size_t r, size_t c) {
-  float x = static_cast<float>(r);
-  float z = static_cast<float>(c);
+float Terrain::generatedHeight(size_t r, size_t c, float spacing) {
+  // sample in units of default-sized cells so hills keep their real-world size at any spacing
+  const float scale = spacing / DEFAULT_SPACING;
+  float x = static_cast<float>(r) * scale;
+  float z = static_cast<float>(c) * scale;
 
   // multiple octaves of sine waves to approximate natural terrain
   float h = 0.0f;
@@ -19,219 +41,902 @@ float Terrain::heightFunction(size_t r, size_t c) {
 }
 
 glm::vec3 Terrain::normalComputation(size_t i, size_t j) {
-  float left = i == 0 ? this->heights[i][j] : this->heights[i - 1][j];
-  float right = i == this->GRID_SIZE - 1 ? this->heights[i][j] : this->heights[i + 1][j];
-  float up = j == this->GRID_SIZE - 1 ? this->heights[i][j] : this->heights[i][j + 1];
-  float down = j == 0 ? this->heights[i][j] : this->heights[i][j - 1];
+  float left = i == 0 ? height(i, j) : height(i - 1, j);
+  float right = i == this->size - 1 ? height(i, j) : height(i + 1, j);
+  float up = j == this->size - 1 ? height(i, j) : height(i, j + 1);
+  float down = j == 0 ? height(i, j) : height(i, j - 1);
 
-  glm::vec3 tangentX = glm::vec3(2 * SPACING, right - left, 0);
-  glm::vec3 tangentZ = glm::vec3(0, up - down, 2 * SPACING);
+  glm::vec3 tangentX = glm::vec3(2 * cellSpacing, right - left, 0);
+  glm::vec3 tangentZ = glm::vec3(0, up - down, 2 * cellSpacing);
 
   glm::vec3 normal = glm::normalize(cross(tangentZ, tangentX));
   return normal;
 }
 
+void Terrain::writeVertex(size_t i, size_t j) {
+  glm::vec3 n = normalComputation(i, j);
+  if (vertexFormat == VertexFormat::Packed) {
+    packedVertices[i * size + j] = packTerrainVertex(height(i, j), n);
+    return;
+  }
+  size_t offset = (i * size + j) * 6;
+  vertices[offset] = i * cellSpacing;
+  vertices[offset + 1] = height(i, j);
+  vertices[offset + 2] = j * cellSpacing;
+  vertices[offset + 3] = n.x;
+  vertices[offset + 4] = n.y;
+  vertices[offset + 5] = n.z;
+}
+
 void Terrain::updateNeighbours(size_t r, size_t c, bool dig, float dt) {
   // the amount to change neighbouring terrain cells by
   float delta = dig ? -0.5f : 0.5f;
   delta *= dt;
   if (r != 0) {
-    heights[r - 1][c] += delta;
+    height(r - 1, c) += delta;
   }
   if (c != 0) {
-    heights[r][c - 1] += delta;
+    height(r, c - 1) += delta;
+  }
+  if (r != this->size - 1) {
+    height(r + 1, c) += delta;
+  }
+  if (c != this->size - 1) {
+    height(r, c + 1) += delta;
+  }
+}
+
+void Terrain::enqueueSettle(size_t idx) {
+  if (!settleQueued[idx]) {
+    settleQueued[idx] = 1;
+    settleQueue.push_back(static_cast<unsigned int>(idx));
+  }
+}
+
+void Terrain::stabilizeSoil(TerrainUpdateStats &stats) {
+  // worklist settle: only cells whose slope may exceed maxDiff are in the queue
+  // a cell that moves material re-queues itself and the neighbour it traded with,
+  // so the cost follows the disturbed area instead of the grid size
+  static constexpr std::pair<int, int> directions[] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+  const long n = static_cast<long>(this->size);
+  size_t head = 0;
+  // everything queued before roundEnd belongs to the current pass
+  size_t roundEnd = settleQueue.size();
+  if (roundEnd == 0) {
+    return;
+  }
+  ++stats.stabilizationPasses;
+  size_t passes = 1;
+  Clock::time_point passStart = Clock::now();
+
+  while (head < settleQueue.size()) {
+    if (head == roundEnd) {
+      // the rest stays queued, still flagged, for the next update
+      if (passes == MAX_SETTLE_PASSES) {
+        settleQueue.erase(settleQueue.begin(), settleQueue.begin() + static_cast<long>(head));
+        endSettlePass(passStart, stats.slowestPassMs);
+        return;
+      }
+      ++passes;
+      ++stats.stabilizationPasses;
+      roundEnd = settleQueue.size();
+      endSettlePass(passStart, stats.slowestPassMs);
+    }
+    const size_t idx = settleQueue[head++];
+    settleQueued[idx] = 0;
+    ++stats.cellsVisited;
+
+    const long i = static_cast<long>(idx / size);
+    const long j = static_cast<long>(idx % size);
+    bool moved = false;
+    for (const auto &[x, y] : directions) {
+      if (i + x >= 0 && i + x < n && j + y >= 0 && j + y < n) {
+        const size_t neighbour = static_cast<size_t>((i + x) * n + (j + y));
+        const float diff = heights[idx] - heights[neighbour];
+        if (diff > maxDiff) {
+          heights[idx] -= settleStep;
+          heights[neighbour] += settleStep;
+        } else if (-diff > maxDiff) {
+          heights[neighbour] -= settleStep;
+          heights[idx] += settleStep;
+        } else {
+          continue;
+        }
+        // both heights changed, and with VertexFormat::Height there's no dilation to cover
+        // the one that wasn't marked
+        modifiedCells.mark(static_cast<size_t>(i), static_cast<size_t>(j));
+        modifiedCells.mark(static_cast<size_t>(i + x), static_cast<size_t>(j + y));
+        moved = true;
+        enqueueSettle(neighbour);
+      }
+    }
+    if (moved) {
+      enqueueSettle(idx);
+    }
+    stats.queueHighWater = std::max(stats.queueHighWater, settleQueue.size() - head);
+
+    // drop the consumed prefix once it dominates so long cascades don't grow the buffer
+    if (head > 4096 && head * 2 > settleQueue.size()) {
+      settleQueue.erase(settleQueue.begin(), settleQueue.begin() + static_cast<long>(head));
+      roundEnd -= head;
+      head = 0;
+    }
   }
-  if (r != this->GRID_SIZE - 1) {
-    heights[r + 1][c] += delta;
+  settleQueue.clear();
+  endSettlePass(passStart, stats.slowestPassMs);
+}
+
+void Terrain::stabilizeSoilFlood(TerrainUpdateStats &stats) {
+  // priority flood: the highest unsettled cell always goes next and spills in one go, its
+  // lower neighbours water-filled until it stands FLOOD_REST of maxDiff above every one that
+  // took soil. whatever it loses they gain, so the volume is conserved and no receiver ends up
+  // above the cell it took soil from; with no fixed step a dump of any size settles in the
+  // one pass. a neighbour that took soil, or that now stands too far above the cell, goes
+  // back on the heap
+  static constexpr std::pair<int, int> directions[] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+  if (settleQueue.empty()) {
+    return;
   }
-  if (c != this->GRID_SIZE - 1) {
-    heights[r][c + 1] += delta;
+  ++stats.stabilizationPasses;
+  Clock::time_point passStart = Clock::now();
+  const auto higher = [](const FloodCell &a, const FloodCell &b) { return a.height < b.height; };
+  const auto push = [&](size_t idx) {
+    floodHeap.push_back({heights[idx], static_cast<unsigned int>(idx)});
+    std::push_heap(floodHeap.begin(), floodHeap.end(), higher);
+  };
+  const long n = static_cast<long>(this->size);
+  const float slack = maxDiff * FLOOD_SLACK;
+  const float rest = maxDiff * FLOOD_REST;
+  // only cells standing too far above a neighbour start on the heap, settleAll queues the
+  // whole grid and most of it is at rest already. a dig leaves the queued cells low, so an
+  // unqueued neighbour standing too far above one of them starts on the heap too
+  for (unsigned int idx : settleQueue) {
+    settleQueued[idx] = 0;
+    const long i = static_cast<long>(idx / size);
+    const long j = static_cast<long>(idx % size);
+    bool spills = false;
+    for (const auto &[x, y] : directions) {
+      if (i + x >= 0 && i + x < n && j + y >= 0 && j + y < n) {
+        const size_t neighbour = static_cast<size_t>((i + x) * n + (j + y));
+        const float diff = heights[idx] - heights[neighbour];
+        if (diff - maxDiff > slack) {
+          spills = true;
+        } else if (-diff - maxDiff > slack) {
+          push(neighbour);
+        }
+      }
+    }
+    if (spills) {
+      push(idx);
+    }
   }
+  settleQueue.clear();
+  // neighbours a cell stands too far above, by the height each starts taking soil at
+  std::array<std::pair<float, size_t>, 4> lower;
+  while (!floodHeap.empty()) {
+    stats.queueHighWater = std::max(stats.queueHighWater, floodHeap.size());
+    std::pop_heap(floodHeap.begin(), floodHeap.end(), higher);
+    const FloodCell next = floodHeap.back();
+    floodHeap.pop_back();
+    const size_t idx = next.cell;
+    if (heights[idx] != next.height) {
+      continue;
+    }
+    ++stats.cellsVisited;
+
+    const long i = static_cast<long>(idx / size);
+    const long j = static_cast<long>(idx % size);
+    size_t lowerCount = 0;
+    for (const auto &[x, y] : directions) {
+      if (i + x >= 0 && i + x < n && j + y >= 0 && j + y < n) {
+        const size_t neighbour = static_cast<size_t>((i + x) * n + (j + y));
+        if (heights[idx] - heights[neighbour] - maxDiff > slack) {
+          lower[lowerCount++] = {heights[neighbour] + rest, neighbour};
+        }
+      }
+    }
+    if (lowerCount == 0) {
+      continue;
+    }
+
+    // the level the cell drops to: the lowest neighbours fill first, and one whose floor is
+    // already above the level reached takes nothing
+    std::sort(lower.begin(), lower.begin() + static_cast<long>(lowerCount));
+    float total = heights[idx];
+    float level = total;
+    size_t receivers = 0;
+    while (receivers < lowerCount && lower[receivers].first < level) {
+      total += lower[receivers].first;
+      ++receivers;
+      level = total / static_cast<float>(receivers + 1);
+    }
+    float spilled = 0.0f;
+    for (size_t k = 0; k < receivers; ++k) {
+      const auto &[floor, neighbour] = lower[k];
+      const float gain = level - floor;
+      heights[neighbour] += gain;
+      spilled += gain;
+      modifiedCells.mark(neighbour / size, neighbour % size);
+      push(neighbour);
+    }
+    heights[idx] -= spilled;
+    modifiedCells.mark(static_cast<size_t>(i), static_cast<size_t>(j));
+
+    // the cell dropped, so a higher neighbour may now have to spill onto it
+    for (const auto &[x, y] : directions) {
+      if (i + x >= 0 && i + x < n && j + y >= 0 && j + y < n) {
+        const size_t neighbour = static_cast<size_t>((i + x) * n + (j + y));
+        if (heights[neighbour] - maxDiff - heights[idx] > slack) {
+          push(neighbour);
+        }
+      }
+    }
+  }
+  endSettlePass(passStart, stats.slowestPassMs);
 }
 
-void Terrain::stabilizeSoil() {
+void Terrain::settleStripe(size_t stripe) {
+  // the same transfers as stabilizeSoil, confined to one stripe's queue
+  // a transfer may still write the row just outside the stripe (nothing else touches it this
+  // phase), but that cell is only handed to its own stripe through the outbox
   static constexpr std::pair<int, int> directions[] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
-  for (int i = 0; i < this->GRID_SIZE; ++i) {
-    for (int j = 0; j < this->GRID_SIZE; ++j) {
-      for (const auto &[x, y] : directions) {
-        if (i + x >= 0 && i + x < this->GRID_SIZE && j + y >= 0 && j + y < this->GRID_SIZE) {
-          int ni = i + x, nj = j + y;
-          if (this->heights[i][j] - this->heights[ni][nj] > MAX_DIFF) {
-            this->modifiedVertices.insert(static_cast<size_t>(i) * GRID_SIZE + static_cast<size_t>(j));
-            this->heights[i][j] -= 0.005f;
-            this->heights[ni][nj] += 0.005f;
+  const long n = static_cast<long>(this->size);
+  const long firstRow = static_cast<long>(stripe * SETTLE_STRIPE_ROWS);
+  const long lastRow = std::min(firstRow + static_cast<long>(SETTLE_STRIPE_ROWS), n) - 1;
+  std::vector<unsigned int> &queue = stripeQueues[stripe];
+  std::vector<unsigned int> &outbox = stripeOutboxes[stripe];
+  TerrainUpdateStats &stats = stripeStats[stripe];
+  stats.updated = true;
+  const auto widen = [](ColumnSpan &span, long col) {
+    const uint32_t c = static_cast<uint32_t>(col);
+    if (span.empty()) {
+      span.first = c;
+      span.last = c;
+      return;
+    }
+    span.first = std::min(span.first, c);
+    span.last = std::max(span.last, c);
+  };
+  const auto enqueue = [&](size_t idx) {
+    if (!settleQueued[idx]) {
+      settleQueued[idx] = 1;
+      queue.push_back(static_cast<unsigned int>(idx));
+    }
+  };
+
+  size_t head = 0;
+  while (head < queue.size()) {
+    const size_t idx = queue[head++];
+    settleQueued[idx] = 0;
+    ++stats.cellsVisited;
+
+    const long i = static_cast<long>(idx / size);
+    const long j = static_cast<long>(idx % size);
+    bool moved = false;
+    for (const auto &[x, y] : directions) {
+      if (i + x >= 0 && i + x < n && j + y >= 0 && j + y < n) {
+        const size_t neighbour = static_cast<size_t>((i + x) * n + (j + y));
+        const float diff = heights[idx] - heights[neighbour];
+        if (diff > maxDiff) {
+          heights[idx] -= settleStep;
+          heights[neighbour] += settleStep;
+        } else if (-diff > maxDiff) {
+          heights[neighbour] -= settleStep;
+          heights[idx] += settleStep;
+        } else {
+          continue;
+        }
+        widen(settleRowChanges[static_cast<size_t>(i)], j);
+        widen(settleRowChanges[static_cast<size_t>(i + x)], j + y);
+        moved = true;
+        if (i + x < firstRow || i + x > lastRow) {
+          outbox.push_back(static_cast<unsigned int>(neighbour));
+        } else {
+          enqueue(neighbour);
+        }
+      }
+    }
+    if (moved) {
+      enqueue(idx);
+    }
+    stats.queueHighWater = std::max(stats.queueHighWater, queue.size() - head);
+
+    if (head > 4096 && head * 2 > queue.size()) {
+      queue.erase(queue.begin(), queue.begin() + static_cast<long>(head));
+      head = 0;
+    }
+  }
+  queue.clear();
+}
+
+void Terrain::stabilizeSoilStriped(TerrainUpdateStats &stats) {
+  // rows are cut into fixed stripes and even and odd stripes take turns: within a phase the
+  // running stripes are at least a stripe apart, so their worklists run on separate threads
+  // without sharing a cell. cells queued across a stripe edge wait for the next phase.
+  // the stripe layout and the processing order inside each stripe don't depend on the thread
+  // count, so neither does the result
+  if (!settlePool || settlePool->threadCount() != settleThreads) {
+    settlePool = std::make_unique<ThreadPool>(settleThreads);
+  }
+  const size_t stripes = (size + SETTLE_STRIPE_ROWS - 1) / SETTLE_STRIPE_ROWS;
+  stripeQueues.resize(stripes);
+  stripeOutboxes.resize(stripes);
+  stripeStats.resize(stripes);
+  settleRowChanges.assign(size, ColumnSpan{});
+  // the in-queue flags stay set, the cells just move to their stripe's queue
+  for (unsigned int idx : settleQueue) {
+    stripeQueues[idx / size / SETTLE_STRIPE_ROWS].push_back(idx);
+  }
+  settleQueue.clear();
+
+  bool ran = true;
+  for (size_t round = 0; ran; ++round) {
+    // backstop, same as stabilizeSoil: what's still queued goes back to the next update
+    if (round * 2 >= MAX_SETTLE_PASSES) {
+      for (std::vector<unsigned int> &queue : stripeQueues) {
+        settleQueue.insert(settleQueue.end(), queue.begin(), queue.end());
+        queue.clear();
+      }
+      return;
+    }
+    ran = false;
+    for (size_t parity = 0; parity < 2; ++parity) {
+      const size_t phaseStripes = (stripes + 1 - parity) / 2;
+      bool pending = false;
+      for (size_t k = 0; k < phaseStripes && !pending; ++k) {
+        pending = !stripeQueues[2 * k + parity].empty();
+      }
+      if (!pending) {
+        continue;
+      }
+
+      Clock::time_point passStart = Clock::now();
+      settlePool->parallelFor(phaseStripes, 1, [&](size_t begin, size_t end, size_t /*block*/) {
+        for (size_t k = begin; k < end; ++k) {
+          if (!stripeQueues[2 * k + parity].empty()) {
+            settleStripe(2 * k + parity);
+          }
+        }
+      });
+      ++stats.stabilizationPasses;
+      ran = true;
+
+      // back on one thread: collect what the stripes changed and hand over the edge cells
+      for (size_t k = 0; k < phaseStripes; ++k) {
+        const size_t stripe = 2 * k + parity;
+        TerrainUpdateStats &stripeResult = stripeStats[stripe];
+        if (!stripeResult.updated) {
+          continue;
+        }
+        const size_t firstRow = stripe * SETTLE_STRIPE_ROWS;
+        const size_t lastRow = std::min(firstRow + SETTLE_STRIPE_ROWS, size) - 1;
+        for (size_t r = firstRow > 0 ? firstRow - 1 : 0; r <= std::min(lastRow + 1, size - 1);
+             ++r) {
+          ColumnSpan &changed = settleRowChanges[r];
+          if (!changed.empty()) {
+            modifiedCells.markSpan(r, changed.first, changed.last);
+            changed = ColumnSpan{};
           }
         }
+        for (unsigned int idx : stripeOutboxes[stripe]) {
+          if (!settleQueued[idx]) {
+            settleQueued[idx] = 1;
+            stripeQueues[idx / size / SETTLE_STRIPE_ROWS].push_back(idx);
+          }
+        }
+        stripeOutboxes[stripe].clear();
+        stats.cellsVisited += stripeResult.cellsVisited;
+        stats.queueHighWater = std::max(stats.queueHighWater, stripeResult.queueHighWater);
+        stripeResult = TerrainUpdateStats{};
       }
+      endSettlePass(passStart, stats.slowestPassMs);
     }
   }
 }
 
-std::pair<std::size_t, std::size_t> Terrain::rebuildVertices() {
-  // expand dirty set to include neighbours (their normals depend on adjacent heights)
-  std::unordered_set<size_t> updateIndices;
-  for (size_t idx : modifiedVertices) {
-    size_t r = idx / GRID_SIZE;
-    size_t c = idx % GRID_SIZE;
-    for (int dr = -1; dr <= 1; ++dr) {
-      for (int dc = -1; dc <= 1; ++dc) {
-        int nr = static_cast<int>(r) + dr;
-        int nc = static_cast<int>(c) + dc;
-        if (nr >= 0 && nr < GRID_SIZE && nc >= 0 && nc < GRID_SIZE) {
-          updateIndices.insert(static_cast<size_t>(nr) * GRID_SIZE + static_cast<size_t>(nc));
+bool Terrain::rowsViolateRepose(size_t a, size_t b) const {
+  const float *rowA = &heights[a * size];
+  const float *rowB = &heights[b * size];
+  for (size_t c = 0; c < size; ++c) {
+    if (std::fabs(rowA[c] - rowB[c]) > maxDiff) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Terrain::stabilizeSoilParallel(size_t firstRow, size_t lastRow, TerrainUpdateStats &stats) {
+  // each pass computes every transfer from a snapshot taken at the start of the pass, so a
+  // cell's new height depends only on the snapshot: no scan-order effects, no races between
+  // threads, and the same result for any thread count. every pair transfer shows up once as a
+  // loss and once as a gain, so the volume is conserved like the serial path.
+  // rows outside [firstRow, lastRow] are left alone; a slope violation across either edge of
+  // the band widens it by a row for the next pass
+  if (!settlePool || settlePool->threadCount() != settleThreads) {
+    settlePool = std::make_unique<ThreadPool>(settleThreads);
+  }
+  settleSnapshot.resize(cellCount());
+  settleRowChanges.resize(size);
+
+  for (size_t passes = 0;; ++passes) {
+    // backstop: queueing a cell at each end of the band hands the same band to the next update
+    if (passes == MAX_SETTLE_PASSES) {
+      enqueueSettle(firstRow * size);
+      enqueueSettle(lastRow * size);
+      return;
+    }
+    Clock::time_point passStart = Clock::now();
+    // band plus one halo row either side, the halo rows are only read
+    const size_t copyFirst = firstRow > 0 ? firstRow - 1 : 0;
+    const size_t copyLast = std::min(lastRow + 1, size - 1);
+    std::memcpy(&settleSnapshot[copyFirst * size], &heights[copyFirst * size],
+                (copyLast - copyFirst + 1) * size * sizeof(float));
+
+    const size_t bandRows = lastRow - firstRow + 1;
+    settlePool->parallelFor(bandRows, 8, [&](size_t begin, size_t end, size_t /*block*/) {
+      for (size_t r = firstRow + begin; r < firstRow + end; ++r) {
+        const float *row = &settleSnapshot[r * size];
+        const float *above = r > firstRow ? row - size : nullptr;
+        const float *below = r < lastRow ? row + size : nullptr;
+        float *out = &heights[r * size];
+        settleRow(above, row, below, out, size, maxDiff, settleStep);
+        // only the outermost changed columns matter, the dirty region is one span per row
+        ColumnSpan changed;
+        size_t first = 0;
+        while (first < size && out[first] == row[first]) {
+          ++first;
         }
+        if (first < size) {
+          size_t last = size - 1;
+          while (out[last] == row[last]) {
+            --last;
+          }
+          changed.first = static_cast<uint32_t>(first);
+          changed.last = static_cast<uint32_t>(last);
+        }
+        settleRowChanges[r] = changed;
       }
+    });
+
+    ++stats.stabilizationPasses;
+    stats.cellsVisited += bandRows * size;
+    stats.queueHighWater = std::max(stats.queueHighWater, bandRows * size);
+
+    bool moved = false;
+    for (size_t r = firstRow; r <= lastRow; ++r) {
+      const ColumnSpan &changed = settleRowChanges[r];
+      if (!changed.empty()) {
+        modifiedCells.markSpan(r, changed.first, changed.last);
+        moved = true;
+      }
+    }
+
+    endSettlePass(passStart, stats.slowestPassMs);
+    bool widened = false;
+    if (firstRow > 0 && rowsViolateRepose(firstRow - 1, firstRow)) {
+      --firstRow;
+      widened = true;
+    }
+    if (lastRow + 1 < size && rowsViolateRepose(lastRow, lastRow + 1)) {
+      ++lastRow;
+      widened = true;
+    }
+    if (!moved && !widened) {
+      return;
+    }
+  }
+}
+
+void Terrain::runSettle(TerrainUpdateStats &stats) {
+  if (settleMode == SettleMode::Worklist) {
+    stabilizeSoil(stats);
+    return;
+  }
+  if (settleMode == SettleMode::Flood) {
+    stabilizeSoilFlood(stats);
+    return;
+  }
+
+  // the parallel path works on whole rows, so turn the worklist into a row band
+  if (settleQueue.empty()) {
+    return;
+  }
+  size_t firstRow = size;
+  size_t lastRow = 0;
+  for (unsigned int idx : settleQueue) {
+    settleQueued[idx] = 0;
+    firstRow = std::min<size_t>(firstRow, idx / size);
+    lastRow = std::max<size_t>(lastRow, idx / size);
+  }
+  settleQueue.clear();
+  stabilizeSoilParallel(firstRow, lastRow, stats);
+}
+
+void Terrain::rebuildVertices(TerrainUpdateStats &stats) {
+  if (modifiedCells.empty()) {
+    return;
+  }
+
+  const size_t vertexBytes = uploadVertexBytes();
+  if (vertexFormat == VertexFormat::Height) {
+    ScopedTimer timer(stats.rebuildMs);
+    TRACE_SCOPE("rebuild vertices");
+    // normals are rebuilt on the GPU, so only the changed heights themselves go up
+    modifiedCells.sortRows();
+    for (uint32_t r : modifiedCells.rows()) {
+      const ColumnSpan &span = modifiedCells.span(r);
+      pendingCells.markSpan(r, span.first, span.last);
+      unsavedCells.markSpan(r, span.first, span.last);
     }
+    updateRanges.clear();
+    const size_t gapCells = modifiedCells.appendRanges(uploadGap, updateRanges);
+    const size_t changed = modifiedCells.cellCount();
+    stats.dirtyVertices = changed;
+    stats.uploadBytes = (changed + gapCells) * vertexBytes;
+    stats.uploadRanges = updateRanges.size();
+    stats.uploadGapBytes = gapCells * vertexBytes;
+    return;
   }
 
-  if (updateIndices.empty()) {
-    return {0, 0};
+  // expand dirty cells to include neighbours (their normals depend on adjacent heights)
+  {
+    ScopedTimer timer(stats.dilateMs);
+    TRACE_SCOPE("dilate");
+    modifiedCells.dilate();
   }
 
-  // update only dirty vertices in-place
-  for (size_t idx : updateIndices) {
-    size_t i = idx / GRID_SIZE;
-    size_t j = idx % GRID_SIZE;
-    glm::vec3 n = normalComputation(i, j);
-    size_t offset = idx * 6;
-    vertices[offset] = i * SPACING;
-    vertices[offset + 1] = heights[i][j];
-    vertices[offset + 2] = j * SPACING;
-    vertices[offset + 3] = n.x;
-    vertices[offset + 4] = n.y;
-    vertices[offset + 5] = n.z;
+  ScopedTimer timer(stats.rebuildMs);
+  TRACE_SCOPE("rebuild vertices");
+  // update only dirty vertices in-place, row by row in memory order
+  size_t updated = 0;
+  for (uint32_t r : modifiedCells.rows()) {
+    const ColumnSpan &span = modifiedCells.span(r);
+    for (size_t c = span.first; c <= span.last; ++c) {
+      writeVertex(r, c);
+    }
+    pendingCells.markSpan(r, span.first, span.last);
+    unsavedCells.markSpan(r, span.first, span.last);
+    updated += span.width();
   }
 
-  // upload only the affected range to the GPU
-  auto [minIt, maxIt] = std::minmax_element(updateIndices.begin(), updateIndices.end());
-  size_t minIdx = *minIt;
-  size_t maxIdx = *maxIt;
-  size_t byteOffset = minIdx * 6 * sizeof(float);
-  size_t byteSize = (maxIdx - minIdx + 1) * 6 * sizeof(float);
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferSubData(GL_ARRAY_BUFFER, byteOffset, byteSize, &vertices[minIdx * 6]);
-  return {updateIndices.size(), byteSize};
+  // what this update alone would upload, the renderer drains pendingCells on its own schedule
+  updateRanges.clear();
+  const size_t gapCells = modifiedCells.appendRanges(uploadGap, updateRanges);
+  stats.dirtyVertices = updated;
+  stats.uploadBytes = (updated + gapCells) * vertexBytes;
+  stats.uploadRanges = updateRanges.size();
+  stats.uploadGapBytes = gapCells * vertexBytes;
 }
 
 // public functions
-Terrain::Terrain() {
-  vertices.reserve(static_cast<std::size_t>(GRID_SIZE) * GRID_SIZE * 6);
-  connections.reserve(static_cast<std::size_t>(GRID_SIZE - 1) * (GRID_SIZE - 1) * 6);
+Terrain::Terrain(std::size_t gridSize, float spacing, const float *initialHeights,
+                 VertexFormat format)
+    : size(std::max<std::size_t>(gridSize, 2)), cellSpacing(spacing),
+      maxDiff(DEFAULT_MAX_DIFF * (spacing / DEFAULT_SPACING)),
+      settleStep(std::min(SETTLE_STEP, maxDiff * SETTLE_STEP_FRACTION)), vertexFormat(format) {
+  // every pass below is a single linear walk over the grid so start-up scales with cell count
+  heights.resize(cellCount());
+  settleQueued.assign(cellCount(), 0);
+  modifiedCells.resize(size);
+  pendingCells.resize(size);
+  unsavedCells.resize(size);
+  updateRanges.reserve(size);
+  if (vertexFormat == VertexFormat::Full) {
+    vertices.resize(cellCount() * 6);
+  } else if (vertexFormat == VertexFormat::Packed) {
+    packedVertices.resize(cellCount());
+  }
 
   // set initial heights in terrain array
-  for (size_t i = 0; i < this->GRID_SIZE; ++i) {
-    for (size_t j = 0; j < this->GRID_SIZE; ++j) {
-      this->heights[i][j] = heightFunction(i, j);
+  if (initialHeights != nullptr) {
+    std::memcpy(heights.data(), initialHeights, cellCount() * sizeof(float));
+  } else {
+    for (size_t i = 0; i < this->size; ++i) {
+      for (size_t j = 0; j < this->size; ++j) {
+        height(i, j) = heightFunction(i, j);
+      }
     }
   }
 
   // set vectors
-  for (size_t i = 0; i < this->GRID_SIZE; ++i) {
-    for (size_t j = 0; j < this->GRID_SIZE; ++j) {
-      glm::vec3 n = normalComputation(i, j);
-      vertices.insert(vertices.end(),
-                      {i * SPACING, this->heights[i][j], j * SPACING, n.x, n.y, n.z});
+  if (vertexFormat != VertexFormat::Height) {
+    for (size_t i = 0; i < this->size; ++i) {
+      for (size_t j = 0; j < this->size; ++j) {
+        writeVertex(i, j);
+      }
     }
   }
+}
 
-  for (size_t i = 0; i < this->GRID_SIZE - 1; ++i) {
-    for (size_t j = 0; j < this->GRID_SIZE - 1; ++j) {
-      unsigned int top_left = i * this->GRID_SIZE + j;
-      unsigned int top_right = i * this->GRID_SIZE + (j + 1);
-      unsigned int bottom_left = (i + 1) * this->GRID_SIZE + j;
-      unsigned int bottom_right = (i + 1) * this->GRID_SIZE + (j + 1);
+void Terrain::applyEdit(size_t row, size_t col, bool dig, float dt) {
+  if (brush) {
+    applyBrush(row, col, *brush, dig, dt);
+    return;
+  }
+  float delta = dig ? -1.0f : 1.0f;
+  delta *= dt;
+  height(row, col) += delta;
+  updateNeighbours(row, col, dig, dt);
+
+  // the edited cell and the neighbours updateNeighbours touched seed the settle worklist
+  std::pair<size_t, size_t> touched[5] = {{row, col}};
+  size_t touchedCount = 1;
+  if (row > 0) touched[touchedCount++] = {row - 1, col};
+  if (row < size - 1) touched[touchedCount++] = {row + 1, col};
+  if (col > 0) touched[touchedCount++] = {row, col - 1};
+  if (col < size - 1) touched[touchedCount++] = {row, col + 1};
+  for (size_t t = 0; t < touchedCount; ++t) {
+    modifiedCells.mark(touched[t].first, touched[t].second);
+    enqueueSettle(touched[t].first * size + touched[t].second);
+  }
+}
+
+void Terrain::applyBrush(size_t row, size_t col, const Brush &footprint, bool dig, float dt) {
+  const float scale = dig ? -dt : dt;
+  const long n = static_cast<long>(size);
+  const long top = static_cast<long>(row) - static_cast<long>(footprint.centreRow());
+  const long left = static_cast<long>(col) - static_cast<long>(footprint.centreCol());
+  for (size_t r = 0; r < footprint.rows(); ++r) {
+    const long gridRow = top + static_cast<long>(r);
+    const ColumnSpan &span = footprint.rowSpan(r);
+    if (gridRow < 0 || gridRow >= n || span.empty()) {
+      continue;
+    }
+    const long first = std::max(left + static_cast<long>(span.first), 0L);
+    const long last = std::min(left + static_cast<long>(span.last), n - 1);
+    if (first > last) {
+      continue;
+    }
+    const float *weights = footprint.rowWeights(r) + (first - left);
+    const size_t count = static_cast<size_t>(last - first + 1);
+    const size_t rowStart = static_cast<size_t>(gridRow) * size;
+    stampRow(&heights[rowStart + static_cast<size_t>(first)], weights, count, scale);
 
-      connections.insert(connections.end(), {top_left, bottom_left, bottom_right});
-      connections.insert(connections.end(), {top_left, bottom_right, top_right});
+    // one span per row for the whole footprint, every cell the stamp moved seeds the settle
+    modifiedCells.markSpan(static_cast<size_t>(gridRow), static_cast<size_t>(first),
+                           static_cast<size_t>(last));
+    for (size_t c = 0; c < count; ++c) {
+      if (weights[c] != 0.0f) {
+        enqueueSettle(rowStart + static_cast<size_t>(first) + c);
+      }
     }
   }
+}
 
-  glGenVertexArrays(1, &this->VAO);
-  glBindVertexArray(this->VAO);
-  glGenBuffers(1, &this->EBO);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, connections.size() * sizeof(unsigned int),
-               connections.data(), GL_STATIC_DRAW);
-  // memory chunks fed from cpu to gpu to handle graphics rendering
-  glGenBuffers(1, &this->VBO);
-  // static draw tells the GPU data is set once and used multiple times
-  glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
-  // copies user defined data into bound buffer
-  // dynamic draw tells the gpu driver that this buffer will be updated frequently so allocate
-  // memory to optimize for this
-  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_DYNAMIC_DRAW);
+TerrainUpdateStats Terrain::modify(size_t row, size_t col, bool dig, float dt) {
+  TRACE_SCOPE("modify");
+  TerrainUpdateStats stats;
+  stats.updated = true;
+  const auto start = std::chrono::steady_clock::now();
 
-  // tells opengl how to read position data from the buffer
-  // we have the vector and its normal vector both stored so there is two calls to read
-  // one is standard vectors, the other is starting from the normals
+  {
+    ScopedTimer timer(stats.editMs);
+    TRACE_SCOPE("edit");
+    applyEdit(row, col, dig, dt);
+  }
+  {
+    ScopedTimer timer(stats.settleMs);
+    TRACE_SCOPE("settle");
+    runSettle(stats);
+  }
 
-  // position: attribute 0, offset 0
-  // index, component #, data type, normalize?, stride, offset
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
-  glEnableVertexAttribArray(0);
+  rebuildVertices(stats);
+  modifiedCells.clear();
 
-  // normal: attribute 1, offset 3 floats
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
-  glEnableVertexAttribArray(1);
+  const auto end = std::chrono::steady_clock::now();
+  stats.cpuMs = std::chrono::duration<double, std::milli>(end - start).count();
+  return stats;
 }
 
-Terrain::~Terrain() {}
+TerrainUpdateStats Terrain::modify(size_t row, size_t col, const Brush &footprint, bool dig,
+                                   float dt) {
+  TRACE_SCOPE("modify");
+  TerrainUpdateStats stats;
+  stats.updated = true;
+  const auto start = std::chrono::steady_clock::now();
 
-void Terrain::draw(Shader &shader, const glm::mat4 &vp) {
-  shader.uniformInfo("mvp", vp);
-  shader.uniformInfo("objectColour", glm::vec3(0.55f, 0.36f, 0.2f));
-  glBindVertexArray(VAO);
-  glDrawElements(GL_TRIANGLES, connections.size(), GL_UNSIGNED_INT, 0);
+  {
+    ScopedTimer timer(stats.editMs);
+    TRACE_SCOPE("edit");
+    applyBrush(row, col, footprint, dig, dt);
+  }
+  {
+    ScopedTimer timer(stats.settleMs);
+    TRACE_SCOPE("settle");
+    runSettle(stats);
+  }
+
+  rebuildVertices(stats);
+  modifiedCells.clear();
+
+  const auto end = std::chrono::steady_clock::now();
+  stats.cpuMs = std::chrono::duration<double, std::milli>(end - start).count();
+  return stats;
 }
 
-TerrainUpdateStats Terrain::modify(size_t row, size_t col, bool dig, float dt) {
+TerrainUpdateStats Terrain::modifyBatch(const std::vector<TerrainEdit> &edits, float dt) {
+  TRACE_SCOPE("modify batch");
   TerrainUpdateStats stats;
+  if (edits.empty()) {
+    return stats;
+  }
   stats.updated = true;
   const auto start = std::chrono::steady_clock::now();
 
-  float delta = dig ? -1.0f : 1.0f;
-  delta *= dt;
-  heights[row][col] += delta;
-  updateNeighbours(row, col, dig, dt);
-
-  size_t prevSize = this->modifiedVertices.size();
-  for (size_t iter = 0; iter < 10; ++iter) {
-    stabilizeSoil();
-    ++stats.stabilizationPasses;
-    if (prevSize == this->modifiedVertices.size()) {
-      break;
+  {
+    ScopedTimer timer(stats.editMs);
+    TRACE_SCOPE("edit");
+    for (const TerrainEdit &edit : edits) {
+      applyEdit(edit.row, edit.col, edit.dig, dt);
+    }
+  }
+  // one settle and one vertex rebuild for the whole tick
+  {
+    ScopedTimer timer(stats.settleMs);
+    TRACE_SCOPE("settle");
+    // every multi-edit worklist batch goes through the stripes, one thread just runs them in
+    // turn, so the heights are the same for any thread count
+    if (settleMode == SettleMode::Worklist && edits.size() > 1) {
+      stabilizeSoilStriped(stats);
+    } else {
+      runSettle(stats);
     }
-    prevSize = this->modifiedVertices.size();
   }
 
-  this->modifiedVertices.insert(row * GRID_SIZE + col);
-  if (row > 0) this->modifiedVertices.insert((row - 1) * GRID_SIZE + col);
-  if (row < GRID_SIZE - 1) this->modifiedVertices.insert((row + 1) * GRID_SIZE + col);
-  if (col > 0) this->modifiedVertices.insert(row * GRID_SIZE + (col - 1));
-  if (col < GRID_SIZE - 1) this->modifiedVertices.insert(row * GRID_SIZE + (col + 1));
+  rebuildVertices(stats);
+  modifiedCells.clear();
 
-  const auto [dirtyVertices, uploadBytes] = rebuildVertices();
-  stats.dirtyVertices = dirtyVertices;
-  stats.uploadBytes = uploadBytes;
-  this->modifiedVertices.clear();
+  const auto end = std::chrono::steady_clock::now();
+  stats.cpuMs = std::chrono::duration<double, std::milli>(end - start).count();
+  return stats;
+}
+
+void Terrain::setSettleMode(SettleMode mode, std::size_t threads) {
+  settleMode = mode;
+  settleThreads = threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : threads;
+}
+
+void Terrain::setSimdLevel(SimdLevel level) {
+  simdLevel = clampSimdLevel(level);
+  settleRow = settleRowKernel(simdLevel);
+  stampRow = stampRowKernel(simdLevel);
+}
+
+TerrainUpdateStats Terrain::settleAll() {
+  TRACE_SCOPE("settle all");
+  TerrainUpdateStats stats;
+  stats.updated = true;
+  const auto start = std::chrono::steady_clock::now();
+
+  {
+    ScopedTimer timer(stats.settleMs);
+    TRACE_SCOPE("settle");
+    if (settleMode != SettleMode::Parallel) {
+      for (size_t idx = 0; idx < cellCount(); ++idx) {
+        enqueueSettle(idx);
+      }
+      if (settleMode == SettleMode::Flood) {
+        stabilizeSoilFlood(stats);
+      } else {
+        stabilizeSoil(stats);
+      }
+    } else {
+      stabilizeSoilParallel(0, size - 1, stats);
+    }
+  }
+
+  rebuildVertices(stats);
+  modifiedCells.clear();
 
   const auto end = std::chrono::steady_clock::now();
   stats.cpuMs = std::chrono::duration<double, std::milli>(end - start).count();
   return stats;
 }
 
+void Terrain::setHeights(const std::vector<float> &values) {
+  if (values.size() != cellCount()) {
+    return;
+  }
+  heights = values;
+  if (vertexFormat != VertexFormat::Height) {
+    for (size_t i = 0; i < this->size; ++i) {
+      for (size_t j = 0; j < this->size; ++j) {
+        writeVertex(i, j);
+      }
+    }
+  }
+  for (size_t r = 0; r < size; ++r) {
+    pendingCells.markSpan(r, 0, size - 1);
+  }
+}
+
+float Terrain::steepestExcess() const {
+  float steepest = 0.0f;
+  for (size_t r = 0; r < size; ++r) {
+    for (size_t c = 0; c < size; ++c) {
+      const float here = heights[r * size + c];
+      if (c + 1 < size) {
+        steepest = std::max(steepest, std::fabs(here - heights[r * size + c + 1]));
+      }
+      if (r + 1 < size) {
+        steepest = std::max(steepest, std::fabs(here - heights[(r + 1) * size + c]));
+      }
+    }
+  }
+  return std::max(0.0f, steepest - maxDiff);
+}
+
 std::optional<float> Terrain::getHeight(size_t row, size_t col) {
-  if (row >= 0 && col >= 0 && row < this->GRID_SIZE && col < this->GRID_SIZE) {
-    return this->heights[row][col];
+  if (row < this->size && col < this->size) {
+    return height(row, col);
   }
   return std::nullopt;
 }
 
-std::pair<size_t, size_t> Terrain::worldToGrid(float x, float z) {
+std::pair<size_t, size_t> Terrain::worldToGrid(float x, float z) const {
   std::pair<size_t, size_t> coordinates = {0, 0};
+  const long last = static_cast<long>(this->size) - 1;
   coordinates.first =
-      static_cast<size_t>(std::clamp(static_cast<int>(x / this->SPACING), 0, this->GRID_SIZE - 1));
+      static_cast<size_t>(std::clamp(static_cast<long>(x / this->cellSpacing), 0L, last));
   coordinates.second =
-      static_cast<size_t>(std::clamp(static_cast<int>(z / this->SPACING), 0, this->GRID_SIZE - 1));
+      static_cast<size_t>(std::clamp(static_cast<long>(z / this->cellSpacing), 0L, last));
   return coordinates;
 }
+
+void Terrain::setVertexFormat(VertexFormat format) {
+  if (format == vertexFormat) {
+    return;
+  }
+  vertexFormat = format;
+  std::vector<float>().swap(vertices);
+  std::vector<std::uint32_t>().swap(packedVertices);
+  if (format == VertexFormat::Full) {
+    vertices.resize(cellCount() * 6);
+  } else if (format == VertexFormat::Packed) {
+    packedVertices.resize(cellCount());
+  }
+  if (format != VertexFormat::Height) {
+    for (size_t i = 0; i < this->size; ++i) {
+      for (size_t j = 0; j < this->size; ++j) {
+        writeVertex(i, j);
+      }
+    }
+  }
+  // whatever was pending is in the old layout, send everything again
+  pendingCells.clear();
+  for (size_t r = 0; r < size; ++r) {
+    pendingCells.markSpan(r, 0, size - 1);
+  }
+}
+
+const void *Terrain::uploadData() const {
+  switch (vertexFormat) {
+  case VertexFormat::Full:
+    return vertices.data();
+  case VertexFormat::Height:
+    return heights.data();
+  case VertexFormat::Packed:
+    return packedVertices.data();
+  }
+  return nullptr;
+}
+
+std::size_t Terrain::uploadVertexBytes() const {
+  switch (vertexFormat) {
+  case VertexFormat::Full:
+    return floatsPerVertex() * sizeof(float);
+  case VertexFormat::Height:
+    return sizeof(float);
+  case VertexFormat::Packed:
+    return sizeof(std::uint32_t);
+  }
+  return 0;
+}
+
+bool Terrain::takePendingUploads(std::vector<VertexRange> &ranges) {
+  ranges.clear();
+  pendingCells.sortRows();
+  pendingCells.appendRanges(uploadGap, ranges);
+  pendingCells.clear();
+  return !ranges.empty();
+}
@@ -1,54 +1,218 @@
 #pragma once
 
-#include <array>
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <glm/glm.hpp>
+#include <memory>
 #include <optional>
 #include <utility>
-#include <unordered_set>
 #include <vector>
 
-// FIXME
-#include "../rendering/shader.h"
-#include "glad/gl.h"
+#include "brush.h"
+#include "dirty_region.h"
+#include "settle_kernel.h"
+#include "terrain_modes.h"
+#include "thread_pool.h"
 
 struct TerrainUpdateStats {
   double cpuMs = 0.0;
   std::size_t dirtyVertices = 0;
   std::size_t uploadBytes = 0;
   std::size_t stabilizationPasses = 0;
+  // cells popped off the settle worklist and the most it held at once
+  std::size_t cellsVisited = 0;
+  std::size_t queueHighWater = 0;
+  // separate buffer writes the dirty vertices need, and bytes re-sent from the clean gaps
+  // merged between dirty spans; clean cells inside a row's span go up too but aren't tracked,
+  // so this is a lower bound on what's re-sent
+  std::size_t uploadRanges = 0;
+  std::size_t uploadGapBytes = 0;
+  // where cpuMs went: applying the edits, settling (and its slowest pass), widening the dirty
+  // set by the vertices whose normals changed, and rewriting those vertices
+  double editMs = 0.0;
+  double settleMs = 0.0;
+  double slowestPassMs = 0.0;
+  double dilateMs = 0.0;
+  double rebuildMs = 0.0;
+  // sending the vertices to the GPU, filled in by whoever does that
+  double uploadMs = 0.0;
   bool updated = false;
 };
 
+// one bucket's dig or dump for a tick, see Terrain::modifyBatch
+struct TerrainEdit {
+  std::size_t row = 0;
+  std::size_t col = 0;
+  bool dig = true;
+};
+
+// heightfield simulation, vertex building and soil stabilization
+// this has no GL dependency so it can run without a window (see TerrainRenderer for drawing)
 class Terrain {
 private:
-  static constexpr float SPACING = 0.1f;
-  // SPACING * tan(33) to determine the angle of repose for soil
-  static constexpr float MAX_DIFF = 0.065f;
-  static constexpr int GRID_SIZE = 64;
-  std::array<std::array<float, GRID_SIZE>, GRID_SIZE> heights{};
+  static constexpr float DEFAULT_SPACING = 0.1f;
+  // DEFAULT_SPACING * tan(33) to determine the angle of repose for soil
+  static constexpr float DEFAULT_MAX_DIFF = 0.065f;
+  static constexpr std::size_t DEFAULT_GRID_SIZE = 64;
+  // the settle queues hold cell indices as unsigned int, so size * size has to fit in one
+  static constexpr std::size_t MAX_GRID_SIZE = 65535;
+  // height moved between a pair of cells per settle transfer, at most this fraction of maxDiff:
+  // a snapshot pass can move both cells of a pair by four steps, and eight steps under maxDiff
+  // can't flip the pair's slope, so fine spacings settle instead of trading soil back and forth
+  static constexpr float SETTLE_STEP = 0.005f;
+  static constexpr float SETTLE_STEP_FRACTION = 0.125f;
+  // backstop on the passes one settle runs, anything still unsettled carries over to the next
+  // update; far above what even a large dump needs
+  static constexpr std::size_t MAX_SETTLE_PASSES = 16384;
+  // dirty runs this many clean vertices apart or closer are uploaded as one range
+  static constexpr std::size_t DEFAULT_UPLOAD_GAP = 64;
+  // rows per stripe of the striped worklist settle, fixed so the result never depends on the
+  // thread count; at least 2 so stripes of one phase never write the same row
+  static constexpr std::size_t SETTLE_STRIPE_ROWS = 32;
+  // slope excess, as a fraction of maxDiff, the flood settle leaves alone; float rounding
+  // would otherwise keep it trading crumbs between converged cells
+  static constexpr float FLOOD_SLACK = 1.0e-4f;
+  // a spilling cell stops this fraction of maxDiff above the neighbours it filled, a little
+  // under the repose slope so the next small dump doesn't run down a slope that's critical
+  // all the way
+  static constexpr float FLOOD_REST = 0.92f;
+  std::size_t size;
+  float cellSpacing;
+  // the repose height difference scales with spacing so the angle stays the same
+  float maxDiff;
+  // SETTLE_STEP, or less once the spacing makes maxDiff small
+  float settleStep;
+  // row-major, size * size cells
+  std::vector<float> heights;
   std::vector<float> vertices;
-  std::vector<unsigned int> connections;
-  std::unordered_set<size_t> modifiedVertices;
-  GLuint VBO; // vertex buffer object
-  GLuint VAO; // vertex array object (how to read the vbo)
-  GLuint EBO; // element buffer object
+  // VertexFormat::Packed, one packTerrainVertex() per cell
+  std::vector<std::uint32_t> packedVertices;
+  VertexFormat vertexFormat = VertexFormat::Full;
+  // cells whose height changed since the last vertex rebuild
+  DirtyRegion modifiedCells;
+  // cells whose slope may exceed maxDiff, FIFO with a per-cell in-queue flag
+  std::vector<unsigned int> settleQueue;
+  std::vector<unsigned char> settleQueued;
+  SettleMode settleMode = SettleMode::Worklist;
+  std::size_t settleThreads = 1;
+  std::unique_ptr<ThreadPool> settlePool;
+  // heights as they were at the start of the current parallel pass
+  std::vector<float> settleSnapshot;
+  // columns each row changed by in the current parallel pass, written by the row's block
+  std::vector<ColumnSpan> settleRowChanges;
+  // striped worklist settle: one FIFO per stripe, plus the cells each stripe queued for a
+  // neighbouring stripe during the current phase
+  std::vector<std::vector<unsigned int>> stripeQueues;
+  std::vector<std::vector<unsigned int>> stripeOutboxes;
+  std::vector<TerrainUpdateStats> stripeStats;
+  // flood settle max-heap of cells by their height when pushed, an entry is stale once the
+  // cell's height has moved on (the change pushed a newer one)
+  struct FloodCell {
+    float height;
+    unsigned int cell;
+  };
+  std::vector<FloodCell> floodHeap;
+  // row kernel used by the parallel passes, picked once from the cpu's instruction sets
+  SimdLevel simdLevel = detectSimdLevel();
+  SettleRowKernel settleRow = settleRowKernel(simdLevel);
+  StampRowKernel stampRow = stampRowKernel(simdLevel);
+  // footprint modify() and modifyBatch() stamp, empty keeps the original single-cell edit
+  std::optional<Brush> brush;
+  // vertices waiting to be uploaded by the renderer, across however many edits ran since
+  DirtyRegion pendingCells;
+  // cells changed since the last markSaved(), for whoever keeps the heights somewhere else
+  DirtyRegion unsavedCells;
+  std::size_t uploadGap = DEFAULT_UPLOAD_GAP;
+  // ranges of the current update, only kept to fill the stats
+  std::vector<VertexRange> updateRanges;
 
-  float heightFunction(size_t r, size_t c);
+  float &height(size_t r, size_t c) { return heights[r * size + c]; }
+  float heightFunction(size_t r, size_t c) { return generatedHeight(r, c, cellSpacing); }
   glm::vec3 normalComputation(size_t i, size_t j);
+  void writeVertex(size_t i, size_t j);
   void updateNeighbours(size_t r, size_t c, bool dig, float dt);
-  void stabilizeSoil();
-  std::pair<std::size_t, std::size_t> rebuildVertices();
+  void applyEdit(size_t row, size_t col, bool dig, float dt);
+  void applyBrush(size_t row, size_t col, const Brush &footprint, bool dig, float dt);
+  void enqueueSettle(size_t idx);
+  void stabilizeSoil(TerrainUpdateStats &stats);
+  void stabilizeSoilFlood(TerrainUpdateStats &stats);
+  void stabilizeSoilParallel(size_t firstRow, size_t lastRow, TerrainUpdateStats &stats);
+  void stabilizeSoilStriped(TerrainUpdateStats &stats);
+  void settleStripe(size_t stripe);
+  bool rowsViolateRepose(size_t a, size_t b) const;
+  void runSettle(TerrainUpdateStats &stats);
+  void rebuildVertices(TerrainUpdateStats &stats);
 
 public:
-  Terrain();
-  ~Terrain();
-  void draw(Shader &, const glm::mat4 &vp);
+  // initialHeights (row-major, gridSize * gridSize) replaces the generated hills, e.g. a
+  // TerrainFile's mapping; it's copied, so it only has to outlive the constructor
+  // vertices are only built in the given format, so no start-up time goes on a layout that
+  // setVertexFormat() would throw away
+  explicit Terrain(std::size_t gridSize = DEFAULT_GRID_SIZE, float spacing = DEFAULT_SPACING,
+                   const float *initialHeights = nullptr,
+                   VertexFormat format = VertexFormat::Full);
   TerrainUpdateStats modify(size_t row, size_t col, bool dig, float dt);
+  // one edit over a whole footprint centred on row/col, clipped at the grid edge: one stamp
+  // pass per covered row, then a single settle and vertex rebuild
+  TerrainUpdateStats modify(size_t row, size_t col, const Brush &footprint, bool dig, float dt);
+  // applies every edit of a tick, then settles and rebuilds vertices once for all of them
+  // with the worklist settle, a batch of several edits settles by fixed row stripes, alternate
+  // stripes running at the same time on however many threads there are
+  TerrainUpdateStats modifyBatch(const std::vector<TerrainEdit> &edits, float dt);
+  // threads = 0 picks one per hardware thread, used by SettleMode::Parallel and by
+  // modifyBatch's striped worklist settle
+  void setSettleMode(SettleMode mode, std::size_t threads = 0);
+  SettleMode getSettleMode() const { return settleMode; }
+  std::size_t getSettleThreads() const { return settleThreads; }
+  // clamped to what the cpu supports, every level gives bit-identical heights
+  void setSimdLevel(SimdLevel level);
+  SimdLevel getSimdLevel() const { return simdLevel; }
+  // footprint used by modify(row, col, dig, dt) and modifyBatch
+  void setBrush(std::optional<Brush> footprint) { brush = std::move(footprint); }
+  const std::optional<Brush> &getBrush() const { return brush; }
+  // relaxes every cell of the grid, not just the ones an edit touched
+  TerrainUpdateStats settleAll();
+  // replaces the whole heightfield (row-major, cellCount() values) and rebuilds every vertex
+  void setHeights(const std::vector<float> &values);
+  const std::vector<float> &heightData() const { return heights; }
+  // cells edited since the last markSaved(), setHeights() doesn't count as an edit
+  const DirtyRegion &unsavedRegion() const { return unsavedCells; }
+  void markSaved() { unsavedCells.clear(); }
   std::optional<float> getHeight(size_t row, size_t col);
-  std::pair<size_t, size_t> worldToGrid(float x, float z);
-  static constexpr int gridSize() { return GRID_SIZE; }
-  static constexpr float spacing() { return SPACING; }
-  static constexpr float worldExtent() { return (GRID_SIZE - 1) * SPACING; }
+  std::pair<size_t, size_t> worldToGrid(float x, float z) const;
+  // interleaved x, y, z, nx, ny, nz per vertex, empty unless VertexFormat::Full
+  const std::vector<float> &vertexData() const { return vertices; }
+  // empty unless VertexFormat::Packed
+  const std::vector<std::uint32_t> &packedVertexData() const { return packedVertices; }
+  // only the buffer the format needs is kept, switching rebuilds it from the heights
+  void setVertexFormat(VertexFormat format);
+  VertexFormat getVertexFormat() const { return vertexFormat; }
+  // what the renderer copies from: vertexData(), heightData() or packedVertexData(),
+  // uploadVertexBytes() bytes per vertex
+  const void *uploadData() const;
+  std::size_t uploadVertexBytes() const;
+  // fills ranges with the coalesced vertex ranges dirtied since the last call and clears them,
+  // returns false when nothing needs uploading
+  bool takePendingUploads(std::vector<VertexRange> &ranges);
+  // largest run of clean vertices merged into an upload range instead of splitting it
+  void setUploadGap(std::size_t vertices) { uploadGap = vertices; }
+  std::size_t getUploadGap() const { return uploadGap; }
+  static constexpr int floatsPerVertex() { return 6; }
+  static constexpr std::size_t defaultGridSize() { return DEFAULT_GRID_SIZE; }
+  static constexpr std::size_t maxGridSize() { return MAX_GRID_SIZE; }
+  static constexpr float defaultSpacing() { return DEFAULT_SPACING; }
+  static constexpr std::size_t defaultUploadGap() { return DEFAULT_UPLOAD_GAP; }
+  // the rolling hills a new terrain starts with, also used to generate tiled sites
+  static float generatedHeight(std::size_t row, std::size_t col, float spacing);
+  std::size_t gridSize() const { return size; }
+  std::size_t cellCount() const { return size * size; }
+  float spacing() const { return cellSpacing; }
+  float worldExtent() const { return (size - 1) * cellSpacing; }
+  // steepest height difference between neighbouring cells the soil holds at rest
+  float reposeDifference() const { return maxDiff; }
+  // how far the steepest neighbour pair stands past reposeDifference(), 0 when none does
+  float steepestExcess() const;
+  // no slope past the repose difference beyond the slack the flood settle leaves alone
+  bool settled() const { return steepestExcess() <= maxDiff * FLOOD_SLACK; }
 };
@@ -0,0 +1,353 @@
+#include "terrain_file.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define EXCAVATION_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "../telemetry/trace.h"
+#include "terrain.h"
+
+namespace {
+constexpr char MAGIC[8] = {'E', 'X', 'C', 'V', 'T', 'E', 'R', 'R'};
+constexpr std::uint32_t VERSION = 1;
+// reads back byte-swapped on a host of the other endianness
+constexpr std::uint32_t BYTE_ORDER_TAG = 0x01020304u;
+
+struct FileHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byteOrder;
+  std::uint64_t gridSize;
+  float spacing;
+  std::uint32_t compression;
+  std::uint64_t payloadBytes;
+  // room for later versions, written as zeros
+  std::uint8_t reserved[24];
+};
+// keeps the heights that follow 64-byte aligned in the mapping
+static_assert(sizeof(FileHeader) == 64, "terrain file header must stay 64 bytes");
+
+std::uint32_t floatBits(float value) {
+  std::uint32_t bits = 0;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+// TerrainCompression::DeltaPlanes
+// runs are a control byte, top bit set for (low 7 bits + 1) zero bytes, otherwise that many
+// literal bytes follow
+void encodeDeltaPlanes(const float *heights, std::size_t gridSize, std::vector<std::uint8_t> &out) {
+  const std::size_t count = gridSize * gridSize;
+  std::vector<std::uint8_t> planes(count * 4);
+  for (std::size_t r = 0; r < gridSize; ++r) {
+    std::uint32_t previous = 0;
+    for (std::size_t c = 0; c < gridSize; ++c) {
+      const std::size_t idx = r * gridSize + c;
+      const std::uint32_t bits = floatBits(heights[idx]);
+      const std::uint32_t difference = bits - previous;
+      // zigzag, so a small step down is as cheap as a small step up
+      const std::uint32_t delta = (difference << 1) ^ (0u - (difference >> 31));
+      previous = bits;
+      for (std::size_t b = 0; b < 4; ++b) {
+        planes[b * count + idx] = static_cast<std::uint8_t>(delta >> (8 * b));
+      }
+    }
+  }
+
+  out.clear();
+  out.reserve(planes.size() / 2);
+  std::size_t i = 0;
+  while (i < planes.size()) {
+    std::size_t run = 0;
+    if (planes[i] == 0) {
+      while (i + run < planes.size() && run < 128 && planes[i + run] == 0) {
+        ++run;
+      }
+      out.push_back(static_cast<std::uint8_t>(0x80u | (run - 1)));
+    } else {
+      while (i + run < planes.size() && run < 128 && planes[i + run] != 0) {
+        ++run;
+      }
+      out.push_back(static_cast<std::uint8_t>(run - 1));
+      out.insert(out.end(), planes.begin() + static_cast<long>(i),
+                 planes.begin() + static_cast<long>(i + run));
+    }
+    i += run;
+  }
+}
+
+bool decodeDeltaPlanes(const std::uint8_t *payload, std::size_t payloadBytes, std::size_t gridSize,
+                     std::vector<float> &heights) {
+  const std::size_t count = gridSize * gridSize;
+  std::vector<std::uint8_t> planes(count * 4);
+  std::size_t in = 0;
+  std::size_t out = 0;
+  while (in < payloadBytes && out < planes.size()) {
+    const std::uint8_t control = payload[in++];
+    const std::size_t run = (control & 0x7fu) + 1u;
+    if (out + run > planes.size()) {
+      return false;
+    }
+    if (control & 0x80u) {
+      // planes starts zeroed
+      out += run;
+      continue;
+    }
+    if (in + run > payloadBytes) {
+      return false;
+    }
+    std::memcpy(&planes[out], payload + in, run);
+    in += run;
+    out += run;
+  }
+  if (in != payloadBytes || out != planes.size()) {
+    return false;
+  }
+
+  heights.resize(count);
+  for (std::size_t r = 0; r < gridSize; ++r) {
+    std::uint32_t previous = 0;
+    for (std::size_t c = 0; c < gridSize; ++c) {
+      const std::size_t idx = r * gridSize + c;
+      std::uint32_t delta = 0;
+      for (std::size_t b = 0; b < 4; ++b) {
+        delta |= static_cast<std::uint32_t>(planes[b * count + idx]) << (8 * b);
+      }
+      previous += (delta >> 1) ^ (0u - (delta & 1u));
+      std::memcpy(&heights[idx], &previous, sizeof(float));
+    }
+  }
+  return true;
+}
+} // namespace
+
+TerrainFile::~TerrainFile() { close(); }
+
+void TerrainFile::close() {
+  release();
+  decoded = std::vector<float>();
+  data = nullptr;
+}
+
+void TerrainFile::release() {
+#ifdef EXCAVATION_MMAP
+  if (mapping != nullptr) {
+    munmap(mapping, mappingBytes);
+  }
+#else
+  ::operator delete(mapping);
+#endif
+  mapping = nullptr;
+  mappingBytes = 0;
+}
+
+bool TerrainFile::open(const std::string &path) {
+  close();
+
+#ifdef EXCAVATION_MMAP
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Failed to open terrain file: " << path << "\n";
+    return false;
+  }
+  struct stat info {};
+  if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(FileHeader))) {
+    std::cerr << "Not a terrain file (too short): " << path << "\n";
+    ::close(fd);
+    return false;
+  }
+  mappingBytes = static_cast<std::size_t>(info.st_size);
+  void *mapped = mmap(nullptr, mappingBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping keeps its own reference to the file
+  ::close(fd);
+  if (mapped == MAP_FAILED) {
+    std::cerr << "Failed to map terrain file: " << path << "\n";
+    mappingBytes = 0;
+    return false;
+  }
+  mapping = mapped;
+  // the heights are read front to back exactly once
+  madvise(mapping, mappingBytes, MADV_SEQUENTIAL);
+#else
+  // no mmap here, read the whole file instead
+  std::ifstream input(path, std::ios::binary | std::ios::ate);
+  if (!input.is_open()) {
+    std::cerr << "Failed to open terrain file: " << path << "\n";
+    return false;
+  }
+  mappingBytes = static_cast<std::size_t>(input.tellg());
+  if (mappingBytes < sizeof(FileHeader)) {
+    std::cerr << "Not a terrain file (too short): " << path << "\n";
+    mappingBytes = 0;
+    return false;
+  }
+  mapping = ::operator new(mappingBytes);
+  input.seekg(0);
+  input.read(static_cast<char *>(mapping), static_cast<std::streamsize>(mappingBytes));
+#endif
+
+  FileHeader header;
+  std::memcpy(&header, mapping, sizeof(header));
+  const auto reject = [&](const char *reason) {
+    std::cerr << "Can't load terrain file " << path << ": " << reason << "\n";
+    close();
+    return false;
+  };
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+    return reject("not a terrain file");
+  }
+  if (header.version != VERSION) {
+    return reject("unsupported version");
+  }
+  if (header.byteOrder != BYTE_ORDER_TAG) {
+    return reject("written on a host of the other byte order");
+  }
+  if (header.gridSize < 2 || header.gridSize > Terrain::maxGridSize() ||
+      !(header.spacing > 0.0f) || header.payloadBytes != mappingBytes - sizeof(FileHeader)) {
+    return reject("corrupt header");
+  }
+
+  const auto *payload = static_cast<const std::uint8_t *>(mapping) + sizeof(FileHeader);
+  const std::size_t count = static_cast<std::size_t>(header.gridSize * header.gridSize);
+  switch (static_cast<TerrainCompression>(header.compression)) {
+  case TerrainCompression::None:
+    if (header.payloadBytes != count * sizeof(float)) {
+      return reject("payload size doesn't match the grid");
+    }
+    data = reinterpret_cast<const float *>(payload);
+    break;
+  case TerrainCompression::DeltaPlanes:
+    if (!decodeDeltaPlanes(payload, header.payloadBytes, header.gridSize, decoded)) {
+      return reject("corrupt compressed payload");
+    }
+    data = decoded.data();
+    // everything needed is decoded, drop the mapping now
+    release();
+    break;
+  default:
+    return reject("unknown compression");
+  }
+
+  size = static_cast<std::size_t>(header.gridSize);
+  cellSpacing = header.spacing;
+  stored = static_cast<TerrainCompression>(header.compression);
+  return true;
+}
+
+bool saveTerrainFile(const std::string &path, std::size_t gridSize, float spacing,
+                     const float *heights, TerrainCompression compression) {
+  TRACE_SCOPE("save terrain");
+  std::vector<std::uint8_t> encoded;
+  const char *payload = reinterpret_cast<const char *>(heights);
+  std::size_t payloadBytes = gridSize * gridSize * sizeof(float);
+  if (compression == TerrainCompression::DeltaPlanes) {
+    encodeDeltaPlanes(heights, gridSize, encoded);
+    payload = reinterpret_cast<const char *>(encoded.data());
+    payloadBytes = encoded.size();
+  }
+
+  FileHeader header{};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.byteOrder = BYTE_ORDER_TAG;
+  header.gridSize = gridSize;
+  header.spacing = spacing;
+  header.compression = static_cast<std::uint32_t>(compression);
+  header.payloadBytes = payloadBytes;
+
+  const std::filesystem::path target(path);
+  if (!target.parent_path().empty()) {
+    std::error_code ignored;
+    std::filesystem::create_directories(target.parent_path(), ignored);
+  }
+  const std::string temporary = path + ".tmp";
+  {
+    std::ofstream output(temporary, std::ios::binary | std::ios::trunc);
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    output.write(payload, static_cast<std::streamsize>(payloadBytes));
+    output.close();
+    if (!output) {
+      std::cerr << "Failed to write terrain file: " << temporary << "\n";
+      return false;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temporary, target, error);
+  if (error) {
+    std::cerr << "Failed to replace terrain file " << path << ": " << error.message() << "\n";
+    return false;
+  }
+  return true;
+}
+
+std::uint64_t heightfieldChecksum(const float *heights, std::size_t count) {
+  constexpr std::uint64_t FNV_OFFSET = 0xcbf29ce484222325ull;
+  constexpr std::uint64_t FNV_PRIME = 0x100000001b3ull;
+  const auto *bytes = reinterpret_cast<const std::uint8_t *>(heights);
+  std::uint64_t hash = FNV_OFFSET;
+  for (std::size_t i = 0; i < count * sizeof(float); ++i) {
+    hash = (hash ^ bytes[i]) * FNV_PRIME;
+  }
+  return hash;
+}
+
+TerrainAutosaver::TerrainAutosaver(std::string path, std::size_t gridSize, float spacing,
+                                   TerrainCompression compression)
+    : path(std::move(path)), gridSize(gridSize), spacing(spacing), compression(compression),
+      writer([this] { run(); }) {}
+
+TerrainAutosaver::~TerrainAutosaver() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_one();
+  writer.join();
+}
+
+bool TerrainAutosaver::request(const std::vector<float> &heights) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (busy) {
+      return false;
+    }
+    // the writer is idle, so it isn't reading pending
+    pending.assign(heights.begin(), heights.end());
+    busy = true;
+  }
+  wake.notify_one();
+  return true;
+}
+
+std::size_t TerrainAutosaver::savesWritten() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return written;
+}
+
+void TerrainAutosaver::run() {
+  TRACE_THREAD_NAME("autosave");
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    wake.wait(lock, [this] { return busy || stopping; });
+    if (busy) {
+      lock.unlock();
+      const bool saved = saveTerrainFile(path, gridSize, spacing, pending.data(), compression);
+      lock.lock();
+      busy = false;
+      written += saved ? 1 : 0;
+      continue;
+    }
+    return;
+  }
+}
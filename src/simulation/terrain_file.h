@@ -0,0 +1,92 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// heightfield checkpoints (--load/--save)
+// a 64-byte header (magic, version, byte-order tag, grid size, spacing, compression, payload
+// size) followed by the heights, row-major. uncompressed payloads are the raw little-endian
+// floats, so a load maps the file and hands the heights straight to Terrain
+enum class TerrainCompression : std::uint32_t {
+  None = 0,
+  // each height's bits minus its left neighbour's, zigzag coded, split into 4 byte planes and
+  // zero bytes run-length coded; neighbouring heights on smooth terrain have close bit
+  // patterns, so the high planes are mostly zero
+  DeltaPlanes = 1,
+};
+
+// a checkpoint opened for reading, the file stays mapped until this is destroyed
+class TerrainFile {
+public:
+  TerrainFile() = default;
+  ~TerrainFile();
+  TerrainFile(const TerrainFile &) = delete;
+  TerrainFile &operator=(const TerrainFile &) = delete;
+
+  // maps path and checks the header, prints why and returns false if it can't be used
+  bool open(const std::string &path);
+  std::size_t gridSize() const { return size; }
+  float spacing() const { return cellSpacing; }
+  TerrainCompression compression() const { return stored; }
+  // gridSize() * gridSize() heights, straight out of the mapping unless the file is compressed
+  const float *heights() const { return data; }
+  // unmaps the file early, heights() is gone after this
+  void close();
+
+private:
+  void release();
+
+  void *mapping = nullptr;
+  std::size_t mappingBytes = 0;
+  // compressed files are decoded into here
+  std::vector<float> decoded;
+  const float *data = nullptr;
+  std::size_t size = 0;
+  float cellSpacing = 0.0f;
+  TerrainCompression stored = TerrainCompression::None;
+};
+
+// writes path + ".tmp" and renames it over path, so a crash mid-save never leaves a torn file
+// prints why and returns false on failure
+bool saveTerrainFile(const std::string &path, std::size_t gridSize, float spacing,
+                     const float *heights, TerrainCompression compression);
+
+// 64-bit FNV-1a over the heights' bytes, equal only for bit-identical heightfields
+std::uint64_t heightfieldChecksum(const float *heights, std::size_t count);
+
+// periodic --autosave: the frame thread copies the heights in, a writer thread of its own
+// encodes and writes them, so a save never stalls a frame on the disk
+class TerrainAutosaver {
+public:
+  TerrainAutosaver(std::string path, std::size_t gridSize, float spacing,
+                   TerrainCompression compression);
+  // finishes a save that's already under way, drops nothing it has accepted
+  ~TerrainAutosaver();
+  TerrainAutosaver(const TerrainAutosaver &) = delete;
+  TerrainAutosaver &operator=(const TerrainAutosaver &) = delete;
+
+  // copies heights for the writer, false (and no copy) while the previous save is still going
+  bool request(const std::vector<float> &heights);
+  std::size_t savesWritten() const;
+
+private:
+  void run();
+
+  std::string path;
+  std::size_t gridSize;
+  float spacing;
+  TerrainCompression compression;
+  mutable std::mutex mutex;
+  std::condition_variable wake;
+  // filled by request(), only read by the writer while busy is set
+  std::vector<float> pending;
+  bool busy = false;
+  bool stopping = false;
+  std::size_t written = 0;
+  std::thread writer;
+};
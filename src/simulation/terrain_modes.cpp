@@ -0,0 +1,25 @@
+#include "terrain_modes.h"
+
+const char *settleModeName(SettleMode mode) {
+  switch (mode) {
+  case SettleMode::Worklist:
+    return "worklist";
+  case SettleMode::Parallel:
+    return "parallel";
+  case SettleMode::Flood:
+    return "flood";
+  }
+  return "unknown";
+}
+
+const char *vertexFormatName(VertexFormat format) {
+  switch (format) {
+  case VertexFormat::Full:
+    return "full";
+  case VertexFormat::Height:
+    return "height";
+  case VertexFormat::Packed:
+    return "packed";
+  }
+  return "unknown";
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+// how slopes steeper than the angle of repose are relaxed after an edit
+enum class SettleMode {
+  // serial active-cell queue, cost follows the disturbed area
+  Worklist,
+  // snapshot passes over a band of rows split across threads, order independent
+  Parallel,
+  // serial priority flood, the highest disturbed cell spills straight to the angle of repose
+  // with no step size, so even a large dump settles in a single pass
+  Flood,
+};
+
+// what the renderer gets per vertex
+enum class VertexFormat {
+  // interleaved position and normal, built on the CPU
+  Full,
+  // the height alone, the vertex shader rebuilds position and normal from the grid
+  Height,
+  // half-float height and an octahedral snorm8 normal in 4 bytes, x/z come from the grid
+  Packed,
+};
+
+// the names --settle and --vertex-format take, also printed in reports
+const char *settleModeName(SettleMode mode);
+const char *vertexFormatName(VertexFormat format);
@@ -0,0 +1,87 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <string>
+
+#include "../telemetry/trace.h"
+
+ThreadPool::ThreadPool(std::size_t threadCount) {
+  const std::size_t extraThreads = threadCount > 1 ? threadCount - 1 : 0;
+  workers.reserve(extraThreads);
+  for (std::size_t i = 0; i < extraThreads; ++i) {
+    workers.emplace_back(&ThreadPool::workerLoop, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::runBlock(std::size_t block) {
+  TRACE_SCOPE("pool block");
+  const std::size_t begin = (jobCount * block) / jobBlocks;
+  const std::size_t end = (jobCount * (block + 1)) / jobBlocks;
+  (*job)(begin, end, block);
+}
+
+void ThreadPool::parallelFor(std::size_t count, std::size_t minBlock, const BlockFunction &fn) {
+  if (count == 0) {
+    return;
+  }
+
+  const std::size_t maxBlocks = std::max<std::size_t>(1, count / std::max<std::size_t>(minBlock, 1));
+  const std::size_t blocks = std::min(threadCount(), maxBlocks);
+  if (blocks == 1) {
+    fn(0, count, 0);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    job = &fn;
+    jobCount = count;
+    jobBlocks = blocks;
+    pending = blocks - 1;
+    ++generation;
+  }
+  wake.notify_all();
+
+  runBlock(0);
+
+  std::unique_lock<std::mutex> lock(mutex);
+  finished.wait(lock, [this] { return pending == 0; });
+  job = nullptr;
+}
+
+void ThreadPool::workerLoop(std::size_t worker) {
+  TRACE_THREAD_NAME("pool worker " + std::to_string(worker + 1));
+  std::size_t seenGeneration = 0;
+  while (true) {
+    std::unique_lock<std::mutex> lock(mutex);
+    wake.wait(lock, [&] { return stopping || generation != seenGeneration; });
+    if (stopping) {
+      return;
+    }
+    seenGeneration = generation;
+    // worker i owns block i + 1, block 0 belongs to the caller
+    const std::size_t block = worker + 1;
+    if (block >= jobBlocks) {
+      continue;
+    }
+    lock.unlock();
+
+    runBlock(block);
+
+    lock.lock();
+    if (--pending == 0) {
+      finished.notify_one();
+    }
+  }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// small fork-join pool, the calling thread always runs the first block itself
+class ThreadPool {
+public:
+  using BlockFunction = std::function<void(std::size_t begin, std::size_t end, std::size_t block)>;
+
+  explicit ThreadPool(std::size_t threadCount);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  std::size_t threadCount() const { return workers.size() + 1; }
+  // splits [0, count) into contiguous blocks of at least minBlock items, one per thread,
+  // and returns once every block has run; block indices are stable for a given count
+  void parallelFor(std::size_t count, std::size_t minBlock, const BlockFunction &fn);
+
+private:
+  void workerLoop(std::size_t worker);
+  void runBlock(std::size_t block);
+
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable finished;
+  const BlockFunction *job = nullptr;
+  std::size_t jobCount = 0;
+  std::size_t jobBlocks = 0;
+  std::size_t generation = 0;
+  std::size_t pending = 0;
+  bool stopping = false;
+};
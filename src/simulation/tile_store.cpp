@@ -0,0 +1,323 @@
+#include "tile_store.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+
+#include "../telemetry/trace.h"
+#include "terrain.h"
+
+namespace {
+constexpr char MAGIC[8] = {'E', 'X', 'C', 'V', 'T', 'I', 'L', 'E'};
+constexpr std::uint32_t VERSION = 1;
+// reads back byte-swapped on a host of the other endianness
+constexpr std::uint32_t BYTE_ORDER_TAG = 0x01020304u;
+// sanity bound so a corrupt header can't overflow the file offsets
+constexpr std::uint64_t MAX_TILES_PER_SIDE = 1u << 16;
+
+// followed by every tile's heights, tiles in row-major order and each tile row-major inside
+struct SiteHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byteOrder;
+  std::uint64_t tilesPerSide;
+  std::uint32_t tileSize;
+  float spacing;
+  // room for later versions, written as zeros
+  std::uint8_t reserved[32];
+};
+static_assert(sizeof(SiteHeader) == 64, "site header must stay 64 bytes");
+} // namespace
+
+TileStore::~TileStore() {
+  if (!worker.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    stopping = true;
+  }
+  wake.notify_one();
+  worker.join();
+  flush();
+}
+
+bool TileStore::create(const std::string &path, std::size_t siteSize, std::size_t tileSize,
+                       float spacing) {
+  const std::size_t perSide = (siteSize + tileSize - 1) / tileSize;
+  SiteHeader header{};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.byteOrder = BYTE_ORDER_TAG;
+  header.tilesPerSide = perSide;
+  header.tileSize = static_cast<std::uint32_t>(tileSize);
+  header.spacing = spacing;
+
+  const std::filesystem::path target(path);
+  if (!target.parent_path().empty()) {
+    std::error_code ignored;
+    std::filesystem::create_directories(target.parent_path(), ignored);
+  }
+  // same as saveTerrainFile, a half-written site is never left under the real name
+  const std::string temporary = path + ".tmp";
+  {
+    std::ofstream output(temporary, std::ios::binary | std::ios::trunc);
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    std::vector<float> tile(tileSize * tileSize);
+    for (std::size_t tileRow = 0; tileRow < perSide && output; ++tileRow) {
+      for (std::size_t tileCol = 0; tileCol < perSide; ++tileCol) {
+        for (std::size_t r = 0; r < tileSize; ++r) {
+          for (std::size_t c = 0; c < tileSize; ++c) {
+            tile[r * tileSize + c] = Terrain::generatedHeight(tileRow * tileSize + r,
+                                                              tileCol * tileSize + c, spacing);
+          }
+        }
+        output.write(reinterpret_cast<const char *>(tile.data()),
+                     static_cast<std::streamsize>(tile.size() * sizeof(float)));
+      }
+    }
+    output.close();
+    if (!output) {
+      std::cerr << "Failed to write site file: " << temporary << "\n";
+      return false;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temporary, target, error);
+  if (error) {
+    std::cerr << "Failed to create site file " << path << ": " << error.message() << "\n";
+    return false;
+  }
+  return true;
+}
+
+bool TileStore::open(const std::string &path, std::size_t budgetBytes) {
+  file.open(path, std::ios::binary | std::ios::in | std::ios::out);
+  if (!file.is_open()) {
+    std::cerr << "Failed to open site file: " << path << "\n";
+    return false;
+  }
+  SiteHeader header{};
+  file.read(reinterpret_cast<char *>(&header), sizeof(header));
+  const auto reject = [&](const char *reason) {
+    std::cerr << "Can't use site file " << path << ": " << reason << "\n";
+    file.close();
+    return false;
+  };
+  if (!file || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+    return reject("not a site file");
+  }
+  if (header.version != VERSION) {
+    return reject("unsupported version");
+  }
+  if (header.byteOrder != BYTE_ORDER_TAG) {
+    return reject("written on a host of the other byte order");
+  }
+  if (header.tilesPerSide == 0 || header.tilesPerSide > MAX_TILES_PER_SIDE ||
+      header.tileSize < 2 || !(header.spacing > 0.0f)) {
+    return reject("corrupt header");
+  }
+  tilesPerSide = static_cast<std::size_t>(header.tilesPerSide);
+  tileCells = header.tileSize;
+  cellSpacing = header.spacing;
+  const std::uintmax_t expected =
+      sizeof(SiteHeader) + static_cast<std::uintmax_t>(tilesPerSide * tilesPerSide) * tileBytes();
+  std::error_code error;
+  if (std::filesystem::file_size(path, error) != expected || error) {
+    return reject("size doesn't match the header");
+  }
+
+  capacity = std::max<std::size_t>(budgetBytes / tileBytes(), 1);
+  tiles.reserve(capacity + 1);
+  worker = std::thread([this] { run(); });
+  return true;
+}
+
+std::size_t TileStore::peakResidentBytes() const {
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  return peakTiles * tileBytes();
+}
+
+void TileStore::read(std::size_t tileRow, std::size_t tileCol, float *dst, std::size_t dstStride) {
+  const std::uint64_t tileKey = key(tileRow, tileCol);
+  std::unique_lock<std::mutex> lock(cacheMutex);
+  ++stats.requests;
+  auto found = tiles.find(tileKey);
+  if (found != tiles.end()) {
+    ++stats.hits;
+  } else {
+    const auto stallStart = std::chrono::steady_clock::now();
+    // loops because with a tiny budget the I/O thread can evict the tile again before this
+    // thread wakes up
+    while (found == tiles.end()) {
+      if (loading.count(tileKey) != 0) {
+        // the I/O thread is already on it
+        loaded.wait(lock, [&] { return loading.count(tileKey) == 0; });
+      } else {
+        loading.insert(tileKey);
+        lock.unlock();
+        std::vector<float> heights;
+        readFromDisk(tileKey, heights);
+        lock.lock();
+        loading.erase(tileKey);
+        insert(tileKey, std::move(heights), false);
+        loaded.notify_all();
+      }
+      found = tiles.find(tileKey);
+    }
+    stats.stallMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                               stallStart)
+                         .count();
+  }
+
+  Tile &tile = found->second;
+  touch(tile);
+  for (std::size_t r = 0; r < tileCells; ++r) {
+    std::memcpy(dst + r * dstStride, &tile.heights[r * tileCells], tileCells * sizeof(float));
+  }
+}
+
+void TileStore::write(std::size_t tileRow, std::size_t tileCol, const float *src,
+                      std::size_t srcStride) {
+  const std::uint64_t tileKey = key(tileRow, tileCol);
+  std::unique_lock<std::mutex> lock(cacheMutex);
+  // a read still in flight would land on top of this write
+  loaded.wait(lock, [&] { return loading.count(tileKey) == 0; });
+  auto found = tiles.find(tileKey);
+  if (found == tiles.end()) {
+    // the whole tile is replaced, so there's no need to read the old one first
+    insert(tileKey, std::vector<float>(tileCells * tileCells), true);
+    found = tiles.find(tileKey);
+  }
+  Tile &tile = found->second;
+  for (std::size_t r = 0; r < tileCells; ++r) {
+    std::memcpy(&tile.heights[r * tileCells], src + r * srcStride, tileCells * sizeof(float));
+  }
+  tile.dirty = true;
+  touch(tile);
+}
+
+void TileStore::prefetch(const std::vector<TileCoord> &coords) {
+  {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    wanted.clear();
+    wantedNext = 0;
+    const std::size_t limit = std::min(coords.size(), prefetchLimit());
+    // walked in reverse so the most wanted tile ends up most recently used
+    for (std::size_t i = limit; i-- > 0;) {
+      const std::uint64_t tileKey = key(coords[i].first, coords[i].second);
+      const auto found = tiles.find(tileKey);
+      if (found != tiles.end()) {
+        touch(found->second);
+      }
+    }
+    for (std::size_t i = 0; i < limit; ++i) {
+      const std::uint64_t tileKey = key(coords[i].first, coords[i].second);
+      if (tiles.count(tileKey) == 0) {
+        wanted.push_back(tileKey);
+      }
+    }
+  }
+  wake.notify_one();
+}
+
+void TileStore::flush() {
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  for (auto &[tileKey, tile] : tiles) {
+    if (tile.dirty) {
+      writeToDisk(tileKey, tile.heights);
+      tile.dirty = false;
+      ++stats.writebacks;
+    }
+  }
+  std::lock_guard<std::mutex> ioLock(ioMutex);
+  file.flush();
+}
+
+TileStreamStats TileStore::takeStats() {
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  const TileStreamStats taken = stats;
+  stats = TileStreamStats{};
+  return taken;
+}
+
+void TileStore::run() {
+  TRACE_THREAD_NAME("tile io");
+  std::unique_lock<std::mutex> lock(cacheMutex);
+  while (true) {
+    wake.wait(lock, [this] { return stopping || wantedNext < wanted.size(); });
+    if (stopping) {
+      return;
+    }
+    const std::uint64_t tileKey = wanted[wantedNext++];
+    if (tiles.count(tileKey) != 0 || loading.count(tileKey) != 0) {
+      continue;
+    }
+    loading.insert(tileKey);
+    lock.unlock();
+    std::vector<float> heights;
+    readFromDisk(tileKey, heights);
+    lock.lock();
+    loading.erase(tileKey);
+    insert(tileKey, std::move(heights), false);
+    ++stats.prefetched;
+    loaded.notify_all();
+  }
+}
+
+void TileStore::insert(std::uint64_t tileKey, std::vector<float> heights, bool dirty) {
+  while (tiles.size() >= capacity && !recency.empty()) {
+    const std::uint64_t victimKey = recency.back();
+    recency.pop_back();
+    const auto victim = tiles.find(victimKey);
+    if (victim->second.dirty) {
+      // kept simple: the write happens under the cache lock, so nobody can read the tile
+      // back from disk before it's there
+      writeToDisk(victimKey, victim->second.heights);
+      ++stats.writebacks;
+    }
+    tiles.erase(victim);
+    ++stats.evictions;
+  }
+  recency.push_front(tileKey);
+  Tile &tile = tiles[tileKey];
+  tile.heights = std::move(heights);
+  tile.dirty = dirty;
+  tile.recent = recency.begin();
+  peakTiles = std::max(peakTiles, tiles.size());
+}
+
+void TileStore::touch(Tile &tile) { recency.splice(recency.begin(), recency, tile.recent); }
+
+void TileStore::readFromDisk(std::uint64_t tileKey, std::vector<float> &heights) {
+  TRACE_SCOPE("tile read");
+  const std::size_t tileRow = static_cast<std::size_t>(tileKey >> 32);
+  const std::size_t tileCol = static_cast<std::size_t>(tileKey & 0xffffffffu);
+  heights.resize(tileCells * tileCells);
+  std::lock_guard<std::mutex> lock(ioMutex);
+  file.seekg(static_cast<std::streamoff>(sizeof(SiteHeader) +
+                                         (tileRow * tilesPerSide + tileCol) * tileBytes()));
+  file.read(reinterpret_cast<char *>(heights.data()), static_cast<std::streamsize>(tileBytes()));
+  if (!file) {
+    std::cerr << "Failed to read site tile " << tileRow << "," << tileCol << "\n";
+    file.clear();
+  }
+}
+
+void TileStore::writeToDisk(std::uint64_t tileKey, const std::vector<float> &heights) {
+  TRACE_SCOPE("tile write");
+  const std::size_t tileRow = static_cast<std::size_t>(tileKey >> 32);
+  const std::size_t tileCol = static_cast<std::size_t>(tileKey & 0xffffffffu);
+  std::lock_guard<std::mutex> lock(ioMutex);
+  file.seekp(static_cast<std::streamoff>(sizeof(SiteHeader) +
+                                         (tileRow * tilesPerSide + tileCol) * tileBytes()));
+  file.write(reinterpret_cast<const char *>(heights.data()),
+             static_cast<std::streamsize>(tileBytes()));
+  if (!file) {
+    std::cerr << "Failed to write site tile " << tileRow << "," << tileCol << "\n";
+    file.clear();
+  }
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// what a TileStore did since stats were last taken
+struct TileStreamStats {
+  // tiles the frame thread asked for, and how many of those were already in memory
+  std::size_t requests = 0;
+  std::size_t hits = 0;
+  // frame thread time spent waiting on the disk for the misses
+  double stallMs = 0.0;
+  // tiles the I/O thread read ahead of being asked for
+  std::size_t prefetched = 0;
+  std::size_t evictions = 0;
+  // dirty tiles written to disk, on eviction or flush
+  std::size_t writebacks = 0;
+};
+
+// row/col of a tile in the site's tile grid
+using TileCoord = std::pair<std::size_t, std::size_t>;
+
+// a site too big to keep in memory, as square tiles of heights in one file on disk
+// (--site). resident tiles are kept in an LRU cache bounded by a byte budget; a background
+// I/O thread reads tiles ahead of need, and edited tiles are written back when they're evicted
+// or flushed. everything here may be called from one thread besides the I/O thread
+class TileStore {
+public:
+  TileStore() = default;
+  // stops the I/O thread and writes every dirty tile back
+  ~TileStore();
+  TileStore(const TileStore &) = delete;
+  TileStore &operator=(const TileStore &) = delete;
+
+  // writes a site of generated hills, siteSize is rounded up to a whole number of tiles
+  // prints why and returns false on failure
+  static bool create(const std::string &path, std::size_t siteSize, std::size_t tileSize,
+                     float spacing);
+  // opens a site and starts the I/O thread, prints why and returns false if it can't be used
+  // at least one tile stays resident whatever the budget
+  bool open(const std::string &path, std::size_t budgetBytes);
+
+  // tile side --site creates new sites with, 256 KB of heights
+  static constexpr std::size_t defaultTileSize() { return 256; }
+  std::size_t siteSize() const { return tilesPerSide * tileCells; }
+  std::size_t tileSize() const { return tileCells; }
+  std::size_t tileCount() const { return tilesPerSide; }
+  float spacing() const { return cellSpacing; }
+  std::size_t budgetBytes() const { return capacity * tileBytes(); }
+  std::size_t peakResidentBytes() const;
+
+  // copies a tile into dst, rows dstStride floats apart; a tile that isn't resident is read on
+  // the calling thread and counted as a stall
+  void read(std::size_t tileRow, std::size_t tileCol, float *dst, std::size_t dstStride);
+  // replaces a tile's heights, it reaches the disk when it's evicted or flushed
+  void write(std::size_t tileRow, std::size_t tileCol, const float *src, std::size_t srcStride);
+  // replaces the I/O thread's queue, most wanted first; resident tiles just move to the front
+  // of the LRU so the reads don't evict them
+  void prefetch(const std::vector<TileCoord> &tiles);
+  // tiles prefetch() takes at most, so a queue never evicts what it loaded earlier
+  std::size_t prefetchLimit() const { return capacity / 2; }
+  void flush();
+  // everything counted since the last call
+  TileStreamStats takeStats();
+
+private:
+  struct Tile {
+    std::vector<float> heights;
+    bool dirty = false;
+    std::list<std::uint64_t>::iterator recent;
+  };
+
+  static std::uint64_t key(std::size_t tileRow, std::size_t tileCol) {
+    return (static_cast<std::uint64_t>(tileRow) << 32) | tileCol;
+  }
+  std::size_t tileBytes() const { return tileCells * tileCells * sizeof(float); }
+  void run();
+  // the calling thread must hold cacheMutex for all of these
+  void insert(std::uint64_t tileKey, std::vector<float> heights, bool dirty);
+  void touch(Tile &tile);
+  // file access, serialized by ioMutex
+  void readFromDisk(std::uint64_t tileKey, std::vector<float> &heights);
+  void writeToDisk(std::uint64_t tileKey, const std::vector<float> &heights);
+
+  std::size_t tilesPerSide = 0;
+  std::size_t tileCells = 0;
+  float cellSpacing = 0.0f;
+  // tiles the budget allows
+  std::size_t capacity = 1;
+
+  std::mutex ioMutex;
+  std::fstream file;
+
+  mutable std::mutex cacheMutex;
+  std::unordered_map<std::uint64_t, Tile> tiles;
+  // most recently used first
+  std::list<std::uint64_t> recency;
+  // being read from disk right now, by either thread
+  std::unordered_set<std::uint64_t> loading;
+  std::condition_variable loaded;
+  std::vector<std::uint64_t> wanted;
+  std::size_t wantedNext = 0;
+  std::condition_variable wake;
+  TileStreamStats stats;
+  std::size_t peakTiles = 0;
+  bool stopping = false;
+  std::thread worker;
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// lock-free handoff of the newest value from one writer thread to one reader thread
+// the writer fills its back buffer and publishes it, the reader picks up whatever was published
+// last; neither side ever waits for the other, unread values are simply overtaken
+template <typename T> class TripleBuffer {
+public:
+  // writer side
+  T &writeBuffer() { return slots[back]; }
+  std::size_t writeSlot() const { return back; }
+  // hands the back buffer to the reader and takes the spare one back
+  // returns false when the previous publish was overtaken before the reader picked it up
+  bool publish() {
+    const std::uint8_t previous = middle.exchange(static_cast<std::uint8_t>(back | FRESH),
+                                                  std::memory_order_acq_rel);
+    back = previous & INDEX;
+    return (previous & FRESH) == 0;
+  }
+
+  // reader side
+  // swaps in the newest published buffer, false if nothing was published since the last call
+  bool acquire() {
+    if ((middle.load(std::memory_order_relaxed) & FRESH) == 0) {
+      return false;
+    }
+    const std::uint8_t previous = middle.exchange(front, std::memory_order_acq_rel);
+    front = previous & INDEX;
+    return true;
+  }
+  const T &readBuffer() const { return slots[front]; }
+
+  // for filling every slot before the threads start
+  T &slot(std::size_t index) { return slots[index]; }
+
+private:
+  static constexpr std::uint8_t INDEX = 3;
+  static constexpr std::uint8_t FRESH = 4;
+
+  std::array<T, 3> slots;
+  // spare slot index, plus FRESH while it holds a publish the reader hasn't taken
+  alignas(64) std::atomic<std::uint8_t> middle{1};
+  // each owned by one side only
+  alignas(64) std::uint8_t back = 0;
+  alignas(64) std::uint8_t front = 2;
+};
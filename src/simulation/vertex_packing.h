@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <glm/glm.hpp>
+
+// encoders for VertexFormat::Packed, decoded again in shaders/terrain_packed.vert
+
+// IEEE half float, round to nearest even, overflow goes to infinity
+inline std::uint16_t packHalf(float value) {
+  std::uint32_t bits = 0;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const std::uint32_t sign = (bits >> 16) & 0x8000u;
+  const std::uint32_t magnitude = bits & 0x7fffffffu;
+  if (magnitude >= 0x7f800000u) {
+    // infinity stays infinity, NaN stays a (quiet) NaN
+    return static_cast<std::uint16_t>(sign | 0x7c00u | (magnitude > 0x7f800000u ? 0x200u : 0u));
+  }
+  if (magnitude >= 0x477ff000u) {
+    // 65520 and up round past the largest half
+    return static_cast<std::uint16_t>(sign | 0x7c00u);
+  }
+
+  std::uint32_t mantissa = 0;
+  std::uint32_t shift = 0;
+  if (magnitude >= 0x38800000u) {
+    // normal half: rebias the exponent and drop 13 mantissa bits
+    mantissa = magnitude - 0x38000000u;
+    shift = 13;
+  } else if (magnitude > 0x33000000u) {
+    // subnormal half, the implicit leading bit becomes explicit
+    mantissa = (magnitude & 0x7fffffu) | 0x800000u;
+    shift = 126 - (magnitude >> 23);
+  } else {
+    return static_cast<std::uint16_t>(sign);
+  }
+  const std::uint32_t truncated = mantissa >> shift;
+  const std::uint32_t remainder = mantissa & ((1u << shift) - 1);
+  const std::uint32_t halfway = 1u << (shift - 1);
+  const std::uint32_t roundUp = remainder > halfway || (remainder == halfway && (truncated & 1u));
+  // a carry out of the mantissa correctly bumps the exponent
+  return static_cast<std::uint16_t>(sign | (truncated + roundUp));
+}
+
+// unit normal as two snorm8 octahedral coordinates, x in the low byte and z in the high one
+// y is the folded axis, heightfield normals always point up so terrain never takes the fold
+inline std::uint16_t packOctahedral(const glm::vec3 &normal) {
+  const float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+  float u = normal.x / length;
+  float v = normal.z / length;
+  if (normal.y < 0.0f) {
+    const float foldedU = (1.0f - std::abs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+    const float foldedV = (1.0f - std::abs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+    u = foldedU;
+    v = foldedV;
+  }
+  const auto snorm8 = [](float f) {
+    const long q = std::lround(glm::clamp(f, -1.0f, 1.0f) * 127.0f);
+    return static_cast<std::uint16_t>(static_cast<std::uint8_t>(static_cast<std::int8_t>(q)));
+  };
+  return static_cast<std::uint16_t>(snorm8(u) | (snorm8(v) << 8));
+}
+
+// 4 bytes, on a little-endian host they sit in memory as the half height, then the
+// octahedral x and z bytes
+inline std::uint32_t packTerrainVertex(float height, const glm::vec3 &normal) {
+  return static_cast<std::uint32_t>(packHalf(height)) |
+         (static_cast<std::uint32_t>(packOctahedral(normal)) << 16);
+}
@@ -0,0 +1,118 @@
+#include "histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr std::size_t SUB_BUCKETS = StreamingHistogram::SUB_BUCKETS;
+constexpr int MIN_EXPONENT = StreamingHistogram::MIN_EXPONENT;
+constexpr int MAX_EXPONENT = StreamingHistogram::MAX_EXPONENT;
+constexpr std::size_t OCTAVES = static_cast<std::size_t>(MAX_EXPONENT - MIN_EXPONENT + 1);
+// bucket 0 holds zero and everything below the smallest octave
+constexpr std::size_t BUCKET_COUNT = 1 + OCTAVES * SUB_BUCKETS;
+
+std::size_t bucketIndex(double value) {
+  int exponent = 0;
+  // value = mantissa * 2^exponent with mantissa in [0.5, 1)
+  const double mantissa = std::frexp(value, &exponent);
+  if (!(value > 0.0) || exponent < MIN_EXPONENT) {
+    return 0;
+  }
+  if (exponent > MAX_EXPONENT) {
+    return BUCKET_COUNT - 1;
+  }
+  const std::size_t octave = static_cast<std::size_t>(exponent - MIN_EXPONENT);
+  const std::size_t sub =
+      static_cast<std::size_t>((mantissa * 2.0 - 1.0) * static_cast<double>(SUB_BUCKETS));
+  return 1 + octave * SUB_BUCKETS + sub;
+}
+
+double bucketLowerBound(std::size_t index) {
+  if (index == 0) {
+    return 0.0;
+  }
+  const std::size_t octave = (index - 1) / SUB_BUCKETS;
+  const std::size_t sub = (index - 1) % SUB_BUCKETS;
+  const int exponent = static_cast<int>(octave) + MIN_EXPONENT;
+  return std::ldexp(1.0 + static_cast<double>(sub) / static_cast<double>(SUB_BUCKETS),
+                    exponent - 1);
+}
+} // namespace
+
+void StreamingHistogram::add(double value) {
+  if (counts.empty()) {
+    counts.assign(BUCKET_COUNT, 0);
+  }
+  const std::size_t index = bucketIndex(value);
+  ++counts[index];
+  if (total == 0) {
+    lowest = value;
+    highest = value;
+    firstUsed = index;
+    lastUsed = index;
+  } else {
+    lowest = std::min(lowest, value);
+    highest = std::max(highest, value);
+    firstUsed = std::min(firstUsed, index);
+    lastUsed = std::max(lastUsed, index);
+  }
+  ++total;
+  sum += value;
+}
+
+void StreamingHistogram::merge(const StreamingHistogram &other) {
+  if (other.empty()) {
+    return;
+  }
+  if (counts.empty()) {
+    counts.assign(BUCKET_COUNT, 0);
+  }
+  for (std::size_t index = other.firstUsed; index <= other.lastUsed; ++index) {
+    counts[index] += other.counts[index];
+  }
+  if (empty()) {
+    lowest = other.lowest;
+    highest = other.highest;
+    firstUsed = other.firstUsed;
+    lastUsed = other.lastUsed;
+  } else {
+    lowest = std::min(lowest, other.lowest);
+    highest = std::max(highest, other.highest);
+    firstUsed = std::min(firstUsed, other.firstUsed);
+    lastUsed = std::max(lastUsed, other.lastUsed);
+  }
+  total += other.total;
+  sum += other.sum;
+}
+
+void StreamingHistogram::clear() {
+  if (!empty()) {
+    std::fill(counts.begin() + static_cast<long>(firstUsed),
+              counts.begin() + static_cast<long>(lastUsed) + 1, 0);
+  }
+  total = 0;
+  sum = 0.0;
+}
+
+double StreamingHistogram::average() const {
+  return empty() ? 0.0 : sum / static_cast<double>(total);
+}
+
+double StreamingHistogram::percentile(double fraction) const {
+  if (empty()) {
+    return 0.0;
+  }
+  const double clamped = std::clamp(fraction, 0.0, 1.0);
+  const std::uint64_t rank = static_cast<std::uint64_t>(clamped * static_cast<double>(total - 1));
+  if (rank == total - 1) {
+    return highest;
+  }
+  std::uint64_t seen = 0;
+  for (std::size_t index = firstUsed; index <= lastUsed; ++index) {
+    seen += counts[index];
+    if (seen > rank) {
+      return std::clamp(bucketLowerBound(index), lowest, highest);
+    }
+  }
+  return highest;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// log-linear histogram of non-negative samples (HDR histogram style): every power of two is
+// split into SUB_BUCKETS equal buckets, so a percentile comes back within 1/SUB_BUCKETS of the
+// true sample however long the run, in fixed memory and with an O(1) add
+// integers below 2 * SUB_BUCKETS, like most of the per-update counts, land in buckets of their
+// own and come back exact; so do the minimum, maximum and average
+class StreamingHistogram {
+public:
+  static constexpr std::size_t SUB_BUCKETS = 128;
+  // frexp exponents covered, about 5e-7 up to 1.7e13; anything smaller counts as 0 and
+  // anything larger lands in the top bucket
+  static constexpr int MIN_EXPONENT = -20;
+  static constexpr int MAX_EXPONENT = 44;
+
+  void add(double value);
+  // adds everything other recorded, as if each of its samples had been added here
+  void merge(const StreamingHistogram &other);
+  void clear();
+
+  bool empty() const { return total == 0; }
+  std::size_t size() const { return static_cast<std::size_t>(total); }
+  double average() const;
+  double minimum() const { return empty() ? 0.0 : lowest; }
+  double maximum() const { return empty() ? 0.0 : highest; }
+  // the sample at fraction of the way through the sorted samples, the same pick as sorting
+  // them and taking index fraction * (size - 1), to within a bucket
+  double percentile(double fraction) const;
+
+private:
+  // 64 KiB once the first sample arrives, nothing before
+  std::vector<std::uint64_t> counts;
+  std::uint64_t total = 0;
+  double sum = 0.0;
+  double lowest = 0.0;
+  double highest = 0.0;
+  // range of buckets holding anything, so percentile only walks those
+  std::size_t firstUsed = 0;
+  std::size_t lastUsed = 0;
+};
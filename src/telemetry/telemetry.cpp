@@ -0,0 +1,318 @@
+#include "telemetry.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "trace.h"
+
+void RollingMetric::add(double value) {
+  if (count < values.size()) {
+    values[next] = value;
+    sum += value;
+    ++count;
+    next = (next + 1) % values.size();
+    return;
+  }
+
+  sum -= values[next];
+  values[next] = value;
+  sum += value;
+  next = (next + 1) % values.size();
+}
+
+double RollingMetric::average() const {
+  if (count == 0) {
+    return 0.0;
+  }
+  return sum / static_cast<double>(count);
+}
+
+double RollingMetric::percentile(double percentileValue) const {
+  if (count == 0) {
+    return 0.0;
+  }
+
+  // partitioned on the stack rather than sorted, this runs for every title update
+  std::array<double, METRIC_WINDOW> samples;
+  std::copy(values.begin(), values.begin() + static_cast<long>(count), samples.begin());
+  const double clamped = std::clamp(percentileValue, 0.0, 1.0);
+  const std::size_t index = static_cast<std::size_t>(clamped * static_cast<double>(count - 1));
+  std::nth_element(samples.begin(), samples.begin() + static_cast<long>(index),
+                   samples.begin() + static_cast<long>(count));
+  return samples[index];
+}
+
+void RuntimeTelemetry::enableHistory() { captureHistory = true; }
+
+void RuntimeTelemetry::enableIntervals(std::size_t frames) { intervalFrames = frames; }
+
+void RuntimeTelemetry::recordFrame(double sampleMs) {
+  TRACE_COUNTER("frame ms", sampleMs);
+  frameMs.add(sampleMs);
+  ++framesSinceTitleUpdate;
+  if (captureHistory) {
+    frameHistogram.add(sampleMs);
+  }
+  if (intervalFrames > 0) {
+    intervalFrameHistogram.add(sampleMs);
+    ++intervalFramesSeen;
+  }
+}
+
+void RuntimeTelemetry::recordTerrainUpdate(const TerrainUpdateStats &stats) {
+  if (!stats.updated) {
+    return;
+  }
+
+  TRACE_COUNTER("dirty vertices", stats.dirtyVertices);
+  TRACE_COUNTER("upload bytes", stats.uploadBytes);
+  TRACE_COUNTER("stabilization passes", stats.stabilizationPasses);
+  TRACE_COUNTER("cells visited", stats.cellsVisited);
+  terrainMs.add(stats.cpuMs);
+  dirtyVertices.add(static_cast<double>(stats.dirtyVertices));
+  uploadBytes.add(static_cast<double>(stats.uploadBytes));
+  uploadRanges.add(static_cast<double>(stats.uploadRanges));
+  stabilizationPasses.add(static_cast<double>(stats.stabilizationPasses));
+  cellsVisited.add(static_cast<double>(stats.cellsVisited));
+  editMs.add(stats.editMs);
+  settleMs.add(stats.settleMs);
+  slowestPassMs.add(stats.slowestPassMs);
+  dilateMs.add(stats.dilateMs);
+  rebuildMs.add(stats.rebuildMs);
+  uploadMs.add(stats.uploadMs);
+  if (intervalFrames > 0) {
+    intervalTerrainHistogram.add(stats.cpuMs);
+  }
+  if (captureHistory) {
+    terrainHistogram.add(stats.cpuMs);
+    dirtyVertexHistogram.add(static_cast<double>(stats.dirtyVertices));
+    uploadByteHistogram.add(static_cast<double>(stats.uploadBytes));
+    stabilizationPassHistogram.add(static_cast<double>(stats.stabilizationPasses));
+    cellsVisitedHistogram.add(static_cast<double>(stats.cellsVisited));
+    queueHighWaterHistogram.add(static_cast<double>(stats.queueHighWater));
+    uploadRangeHistogram.add(static_cast<double>(stats.uploadRanges));
+    uploadGapByteHistogram.add(static_cast<double>(stats.uploadGapBytes));
+    editHistogram.add(stats.editMs);
+    settleHistogram.add(stats.settleMs);
+    slowestPassHistogram.add(stats.slowestPassMs);
+    dilateHistogram.add(stats.dilateMs);
+    rebuildHistogram.add(stats.rebuildMs);
+    uploadHistogram.add(stats.uploadMs);
+  }
+}
+
+void RuntimeTelemetry::recordFenceWait(double waitMs) {
+  TRACE_COUNTER("fence wait ms", waitMs);
+  fenceWaitMs.add(waitMs);
+  if (captureHistory) {
+    fenceWaitHistogram.add(waitMs);
+  }
+}
+
+void RuntimeTelemetry::recordTerrainDraw(const TerrainDrawStats &stats) {
+  chunksDrawn.add(static_cast<double>(stats.chunksDrawn));
+  trianglesDrawn.add(static_cast<double>(stats.triangles));
+  cullMs.add(stats.cullMs);
+  chunksTotal = stats.chunksTotal;
+  if (captureHistory) {
+    chunksDrawnHistogram.add(static_cast<double>(stats.chunksDrawn));
+    triangleHistogram.add(static_cast<double>(stats.triangles));
+    cullHistogram.add(stats.cullMs);
+  }
+}
+
+void RuntimeTelemetry::recordRender(double sampleMs) {
+  renderMs.add(sampleMs);
+  if (captureHistory) {
+    renderHistogram.add(sampleMs);
+  }
+}
+
+void RuntimeTelemetry::recordSimSnapshot(std::size_t ticks, double tickMs, double latencyMs) {
+  if (ticks == 0) {
+    return;
+  }
+
+  const double perTick = tickMs / static_cast<double>(ticks);
+  simTickMs.add(perTick);
+  snapshotLatencyMs.add(latencyMs);
+  if (captureHistory) {
+    simTickHistogram.add(perTick);
+    snapshotLatencyHistogram.add(latencyMs);
+  }
+}
+
+void RuntimeTelemetry::recordTileStream(const TileStreamStats &stats) {
+  tileRequests.add(static_cast<double>(stats.requests));
+  tileHits.add(static_cast<double>(stats.hits));
+  TRACE_COUNTER("tile stall ms", stats.stallMs);
+  tileStallMs.add(stats.stallMs);
+  tileTotals.requests += stats.requests;
+  tileTotals.hits += stats.hits;
+  tileTotals.stallMs += stats.stallMs;
+  tileTotals.prefetched += stats.prefetched;
+  tileTotals.evictions += stats.evictions;
+  tileTotals.writebacks += stats.writebacks;
+  if (captureHistory) {
+    tileStallHistogram.add(stats.stallMs);
+  }
+}
+
+void RuntimeTelemetry::recordGpuTerrain(double sampleMs) {
+  gpuTerrainMs.add(sampleMs);
+  if (captureHistory) {
+    gpuTerrainHistogram.add(sampleMs);
+  }
+}
+
+void RuntimeTelemetry::recordGpuBucket(double sampleMs) {
+  gpuBucketMs.add(sampleMs);
+  if (captureHistory) {
+    gpuBucketHistogram.add(sampleMs);
+  }
+}
+
+std::optional<std::string> RuntimeTelemetry::pollWindowTitle(double now,
+                                                             std::string_view titlePrefix) {
+  if (lastTitleUpdateTime == 0.0) {
+    lastTitleUpdateTime = now;
+    return std::nullopt;
+  }
+
+  const double elapsed = now - lastTitleUpdateTime;
+  if (elapsed < 1.0 || framesSinceTitleUpdate == 0) {
+    return std::nullopt;
+  }
+
+  const double fps = static_cast<double>(framesSinceTitleUpdate) / elapsed;
+  std::ostringstream title;
+  title << std::fixed << std::setprecision(1);
+  title << titlePrefix << " | " << fps << " FPS";
+  title << " | frame " << frameMs.average() << " ms avg / " << frameMs.percentile(0.95) << " p95";
+  if (!renderMs.empty()) {
+    title << " | render " << renderMs.average() << " ms";
+  }
+  if (!simTickMs.empty()) {
+    title << " | sim " << std::setprecision(2) << simTickMs.average() << " ms/tick | latency "
+          << std::setprecision(1) << snapshotLatencyMs.average() << " ms";
+  }
+
+  if (terrainMs.empty()) {
+    title << " | terrain idle";
+  } else {
+    title << " | terrain " << terrainMs.average() << " ms (edit " << std::setprecision(2)
+          << editMs.average() << " settle " << settleMs.average() << " dilate "
+          << dilateMs.average() << " rebuild " << rebuildMs.average() << " upload "
+          << uploadMs.average() << ")";
+    title << " | dirty " << std::setprecision(0) << dirtyVertices.average();
+    title << " | upload " << formatBytes(uploadBytes.average()) << " in " << std::setprecision(1)
+          << uploadRanges.average() << " ranges";
+    title << " | passes " << std::setprecision(1) << stabilizationPasses.average()
+          << ", slowest " << std::setprecision(2) << slowestPassMs.average() << " ms";
+    title << " | visited " << std::setprecision(0) << cellsVisited.average();
+  }
+  if (!chunksDrawn.empty()) {
+    title << " | chunks " << std::setprecision(0) << chunksDrawn.average() << "/" << chunksTotal;
+    title << " | tris " << trianglesDrawn.average();
+    title << " | cull " << std::setprecision(2) << cullMs.average() << " ms";
+  }
+  if (!gpuTerrainMs.empty()) {
+    title << " | gpu terrain " << std::setprecision(2) << gpuTerrainMs.average() << " ms bucket "
+          << gpuBucketMs.average() << " ms";
+  }
+  if (!fenceWaitMs.empty()) {
+    title << " | fence " << std::setprecision(2) << fenceWaitMs.average() << " ms";
+  }
+  if (!tileStallMs.empty()) {
+    // frames that asked for no tiles count as all hits
+    const double hitRate = tileRequests.sum > 0.0 ? tileHits.sum / tileRequests.sum : 1.0;
+    title << " | tiles " << std::setprecision(0) << hitRate * 100.0 << "% hit | stall "
+          << std::setprecision(2) << tileStallMs.average() << " ms";
+  }
+
+  lastTitleUpdateTime = now;
+  framesSinceTitleUpdate = 0;
+  return title.str();
+}
+
+std::optional<std::string> RuntimeTelemetry::pollIntervalReport() {
+  if (intervalFrames == 0 || intervalFramesSeen < intervalFrames) {
+    return std::nullopt;
+  }
+
+  const std::size_t first = intervalsReported * intervalFrames + 1;
+  std::ostringstream report;
+  report << "Frames " << first << "-" << first + intervalFramesSeen - 1 << ": frame "
+         << formatPercentiles(intervalFrameHistogram, " ms");
+  if (!intervalTerrainHistogram.empty()) {
+    report << " || terrain " << formatPercentiles(intervalTerrainHistogram, " ms");
+  }
+  intervalFrameHistogram.clear();
+  intervalTerrainHistogram.clear();
+  intervalFramesSeen = 0;
+  ++intervalsReported;
+  return report.str();
+}
+
+std::string formatBytes(double bytes) {
+  std::ostringstream formatted;
+  formatted << std::fixed;
+
+  if (bytes >= 1024.0 * 1024.0) {
+    formatted << std::setprecision(2) << (bytes / (1024.0 * 1024.0)) << " MiB";
+    return formatted.str();
+  }
+
+  if (bytes >= 1024.0) {
+    formatted << std::setprecision(1) << (bytes / 1024.0) << " KiB";
+    return formatted.str();
+  }
+
+  formatted << std::setprecision(0) << bytes << " B";
+  return formatted.str();
+}
+
+void accumulateTerrainStats(TerrainUpdateStats &aggregate, const TerrainUpdateStats &sample) {
+  if (!sample.updated) {
+    return;
+  }
+
+  aggregate.updated = true;
+  aggregate.cpuMs += sample.cpuMs;
+  aggregate.dirtyVertices += sample.dirtyVertices;
+  aggregate.uploadBytes += sample.uploadBytes;
+  aggregate.uploadRanges += sample.uploadRanges;
+  aggregate.uploadGapBytes += sample.uploadGapBytes;
+  aggregate.stabilizationPasses += sample.stabilizationPasses;
+  aggregate.cellsVisited += sample.cellsVisited;
+  aggregate.editMs += sample.editMs;
+  aggregate.settleMs += sample.settleMs;
+  aggregate.slowestPassMs = std::max(aggregate.slowestPassMs, sample.slowestPassMs);
+  aggregate.dilateMs += sample.dilateMs;
+  aggregate.rebuildMs += sample.rebuildMs;
+  aggregate.uploadMs += sample.uploadMs;
+  aggregate.queueHighWater = std::max(aggregate.queueHighWater, sample.queueHighWater);
+}
+
+MetricSummary summarizeSamples(const StreamingHistogram &samples) {
+  MetricSummary summary;
+  summary.average = samples.average();
+  summary.p50 = samples.percentile(0.5);
+  summary.p90 = samples.percentile(0.9);
+  summary.p95 = samples.percentile(0.95);
+  summary.p99 = samples.percentile(0.99);
+  summary.p999 = samples.percentile(0.999);
+  summary.maximum = samples.maximum();
+  return summary;
+}
+
+std::string formatPercentiles(const StreamingHistogram &samples, std::string_view unit) {
+  const MetricSummary summary = summarizeSamples(samples);
+  std::ostringstream formatted;
+  formatted << std::fixed << std::setprecision(3);
+  formatted << "p50 " << summary.p50 << unit << " | p90 " << summary.p90 << unit << " | p99 "
+            << summary.p99 << unit << " | p99.9 " << summary.p999 << unit << " | max "
+            << summary.maximum << unit;
+  return formatted.str();
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "../rendering/chunk_grid.h"
+#include "../simulation/terrain.h"
+#include "../simulation/tile_store.h"
+#include "histogram.h"
+
+constexpr std::size_t METRIC_WINDOW = 240;
+
+struct MetricSummary {
+  double average = 0.0;
+  double p50 = 0.0;
+  double p90 = 0.0;
+  double p95 = 0.0;
+  double p99 = 0.0;
+  double p999 = 0.0;
+  double maximum = 0.0;
+};
+
+struct RollingMetric {
+  std::array<double, METRIC_WINDOW> values{};
+  std::size_t count = 0;
+  std::size_t next = 0;
+  double sum = 0.0;
+
+  void add(double value);
+  bool empty() const { return count == 0; }
+  double average() const;
+  double percentile(double percentileValue) const;
+};
+
+struct RuntimeTelemetry {
+  RollingMetric frameMs;
+  RollingMetric terrainMs;
+  RollingMetric dirtyVertices;
+  RollingMetric uploadBytes;
+  RollingMetric uploadRanges;
+  RollingMetric stabilizationPasses;
+  RollingMetric cellsVisited;
+  RollingMetric fenceWaitMs;
+  RollingMetric chunksDrawn;
+  RollingMetric trianglesDrawn;
+  RollingMetric cullMs;
+  RollingMetric renderMs;
+  RollingMetric simTickMs;
+  RollingMetric snapshotLatencyMs;
+  RollingMetric tileRequests;
+  RollingMetric tileHits;
+  RollingMetric tileStallMs;
+  // where the terrain update time went, see TerrainUpdateStats
+  RollingMetric editMs;
+  RollingMetric settleMs;
+  RollingMetric slowestPassMs;
+  RollingMetric dilateMs;
+  RollingMetric rebuildMs;
+  RollingMetric uploadMs;
+  RollingMetric gpuTerrainMs;
+  RollingMetric gpuBucketMs;
+  std::size_t chunksTotal = 0;
+  // --site totals over the whole run
+  TileStreamStats tileTotals;
+  // whole-run distributions, kept in benchmark runs only
+  bool captureHistory = false;
+  StreamingHistogram frameHistogram;
+  StreamingHistogram terrainHistogram;
+  StreamingHistogram dirtyVertexHistogram;
+  StreamingHistogram uploadByteHistogram;
+  StreamingHistogram stabilizationPassHistogram;
+  StreamingHistogram cellsVisitedHistogram;
+  StreamingHistogram queueHighWaterHistogram;
+  StreamingHistogram uploadRangeHistogram;
+  StreamingHistogram uploadGapByteHistogram;
+  StreamingHistogram fenceWaitHistogram;
+  StreamingHistogram chunksDrawnHistogram;
+  StreamingHistogram triangleHistogram;
+  StreamingHistogram cullHistogram;
+  StreamingHistogram renderHistogram;
+  StreamingHistogram simTickHistogram;
+  StreamingHistogram snapshotLatencyHistogram;
+  StreamingHistogram tileStallHistogram;
+  StreamingHistogram editHistogram;
+  StreamingHistogram settleHistogram;
+  StreamingHistogram slowestPassHistogram;
+  StreamingHistogram dilateHistogram;
+  StreamingHistogram rebuildHistogram;
+  StreamingHistogram uploadHistogram;
+  StreamingHistogram gpuTerrainHistogram;
+  StreamingHistogram gpuBucketHistogram;
+  std::size_t framesSinceTitleUpdate = 0;
+  double lastTitleUpdateTime = 0.0;
+  // --report-interval: frame and terrain update times over the last intervalFrames frames,
+  // 0 keeps none
+  std::size_t intervalFrames = 0;
+  std::size_t intervalFramesSeen = 0;
+  std::size_t intervalsReported = 0;
+  StreamingHistogram intervalFrameHistogram;
+  StreamingHistogram intervalTerrainHistogram;
+
+  void enableHistory();
+  void enableIntervals(std::size_t frames);
+  void recordFrame(double sampleMs);
+  void recordTerrainUpdate(const TerrainUpdateStats &stats);
+  // only recorded by the ring upload path, once per frame
+  void recordFenceWait(double waitMs);
+  // once per drawn frame, the headless binary never records these
+  void recordTerrainDraw(const TerrainDrawStats &stats);
+  // CPU time the render thread spent on a frame before swapping
+  void recordRender(double sampleMs);
+  // once per snapshot taken from the simulation thread: how many ticks it covers, their total
+  // time, and how old it was when the render thread picked it up
+  void recordSimSnapshot(std::size_t ticks, double tickMs, double latencyMs);
+  // once per frame with --site, what the tile store did during it
+  void recordTileStream(const TileStreamStats &stats);
+  // GPU time of the terrain and bucket draws, whenever a timer query comes back (so a few
+  // frames late, and not every frame), the headless binary never records these
+  void recordGpuTerrain(double sampleMs);
+  void recordGpuBucket(double sampleMs);
+  // returns a new window title roughly once per second, nothing in between
+  std::optional<std::string> pollWindowTitle(double now, std::string_view titlePrefix);
+  // a line of percentiles for the interval that just ended, once every intervalFrames frames
+  std::optional<std::string> pollIntervalReport();
+};
+
+std::string formatBytes(double bytes);
+void accumulateTerrainStats(TerrainUpdateStats &aggregate, const TerrainUpdateStats &sample);
+MetricSummary summarizeSamples(const StreamingHistogram &samples);
+// "p50 X | p90 X | p99 X | p99.9 X | max X" followed by unit after each value
+std::string formatPercentiles(const StreamingHistogram &samples, std::string_view unit);
@@ -0,0 +1,185 @@
+#include "trace.h"
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> tracingActive{false};
+
+namespace {
+constexpr std::size_t BLOCK_EVENTS = 4096;
+// 64 MiB of events a thread, anything past that is dropped and counted
+constexpr std::size_t MAX_BLOCKS = 512;
+
+enum class TracePhase : char { Begin = 'B', End = 'E', Complete = 'X', Counter = 'C' };
+
+struct TraceEvent {
+  const char *name;
+  // since startTracing()
+  std::int64_t timestampNs;
+  // the duration in ns of a Complete event, the value of a Counter
+  double value;
+  TracePhase phase;
+};
+
+struct TraceBlock {
+  std::array<TraceEvent, BLOCK_EVENTS> events;
+};
+
+// only the owning thread writes, writeTrace reads up to count, which is published after the
+// event it covers
+struct ThreadTrace {
+  std::size_t id = 0;
+  std::string name;
+  std::array<std::unique_ptr<TraceBlock>, MAX_BLOCKS> blocks;
+  std::atomic<std::size_t> count{0};
+  std::atomic<std::size_t> dropped{0};
+};
+
+TraceClock::time_point traceStart;
+std::mutex registryMutex;
+std::vector<std::unique_ptr<ThreadTrace>> threadTraces;
+thread_local ThreadTrace *localTrace = nullptr;
+
+// the first event on a thread registers its buffer, the only time recording takes a lock
+ThreadTrace &threadTrace() {
+  if (localTrace == nullptr) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    threadTraces.push_back(std::make_unique<ThreadTrace>());
+    localTrace = threadTraces.back().get();
+    localTrace->id = threadTraces.size();
+    localTrace->name = "thread " + std::to_string(localTrace->id);
+  }
+  return *localTrace;
+}
+
+std::int64_t sinceStart(TraceClock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(time - traceStart).count();
+}
+
+void record(const char *name, std::int64_t timestampNs, double value, TracePhase phase) {
+  ThreadTrace &trace = threadTrace();
+  const std::size_t index = trace.count.load(std::memory_order_relaxed);
+  const std::size_t block = index / BLOCK_EVENTS;
+  if (block == MAX_BLOCKS) {
+    trace.dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  if (index % BLOCK_EVENTS == 0) {
+    trace.blocks[block] = std::make_unique<TraceBlock>();
+  }
+  trace.blocks[block]->events[index % BLOCK_EVENTS] = {name, timestampNs, value, phase};
+  trace.count.store(index + 1, std::memory_order_release);
+}
+
+// trace event timestamps are microseconds
+void writeMicroseconds(std::ostream &output, double nanoseconds) {
+  output << std::fixed << std::setprecision(3) << nanoseconds / 1000.0;
+}
+} // namespace
+
+bool startTracing() {
+#if EXCAVATION_TRACING
+  traceStart = TraceClock::now();
+  tracingActive.store(true, std::memory_order_relaxed);
+  setTraceThreadName("main");
+  return true;
+#else
+  std::cerr << "--trace needs a build with tracing, configure with -DEXCAVATION_TRACING=ON\n";
+  return false;
+#endif
+}
+
+void setTraceThreadName(const std::string &name) {
+  if (!tracingEnabled()) {
+    return;
+  }
+  ThreadTrace &trace = threadTrace();
+  std::lock_guard<std::mutex> lock(registryMutex);
+  trace.name = name;
+}
+
+void traceBegin(const char *name) {
+  record(name, sinceStart(TraceClock::now()), 0.0, TracePhase::Begin);
+}
+
+void traceEnd() { record(nullptr, sinceStart(TraceClock::now()), 0.0, TracePhase::End); }
+
+void traceComplete(const char *name, TraceClock::time_point start, TraceClock::time_point end) {
+  record(name, sinceStart(start), static_cast<double>(sinceStart(end) - sinceStart(start)),
+         TracePhase::Complete);
+}
+
+void traceCounter(const char *name, double value) {
+  record(name, sinceStart(TraceClock::now()), value, TracePhase::Counter);
+}
+
+bool writeTrace(const std::string &path) {
+  tracingActive.store(false, std::memory_order_relaxed);
+
+  const std::filesystem::path tracePath(path);
+  if (!tracePath.parent_path().empty()) {
+    std::filesystem::create_directories(tracePath.parent_path());
+  }
+  std::ofstream output(tracePath);
+  if (!output.is_open()) {
+    std::cerr << "Failed to open trace output: " << path << "\n";
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(registryMutex);
+  std::size_t events = 0;
+  std::size_t dropped = 0;
+  output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  bool first = true;
+  const auto separate = [&] {
+    output << (first ? "" : ",\n");
+    first = false;
+  };
+  for (const std::unique_ptr<ThreadTrace> &trace : threadTraces) {
+    separate();
+    output << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << trace->id
+           << ",\"args\":{\"name\":\"" << trace->name << "\"}}";
+
+    const std::size_t count = trace->count.load(std::memory_order_acquire);
+    for (std::size_t index = 0; index < count; ++index) {
+      const TraceEvent &event = trace->blocks[index / BLOCK_EVENTS]->events[index % BLOCK_EVENTS];
+      separate();
+      output << "{\"ph\":\"" << static_cast<char>(event.phase) << "\",\"pid\":1,\"tid\":"
+             << trace->id << ",\"ts\":";
+      writeMicroseconds(output, static_cast<double>(event.timestampNs));
+      if (event.name != nullptr) {
+        output << ",\"name\":\"" << event.name << "\"";
+      }
+      if (event.phase == TracePhase::Complete) {
+        output << ",\"dur\":";
+        writeMicroseconds(output, event.value);
+      } else if (event.phase == TracePhase::Counter) {
+        output << ",\"args\":{\"value\":" << std::defaultfloat << std::setprecision(17)
+               << event.value << "}";
+      }
+      output << "}";
+    }
+    events += count;
+    dropped += trace->dropped.load(std::memory_order_relaxed);
+  }
+  output << "\n]}\n";
+  if (!output) {
+    std::cerr << "Failed to write trace output: " << path << "\n";
+    return false;
+  }
+
+  std::cout << "Wrote " << events << " trace events from " << threadTraces.size()
+            << " threads to " << path;
+  if (dropped > 0) {
+    std::cout << " (" << dropped << " dropped once a thread's buffer was full)";
+  }
+  std::cout << '\n';
+  return true;
+}
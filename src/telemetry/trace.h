@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+// timeline tracing for --trace, written as Chrome trace event JSON (opens in the Perfetto UI
+// and chrome://tracing)
+// every thread appends to a buffer of its own, so recording takes no locks and never waits on
+// another thread; until startTracing() each TRACE_ macro is one relaxed load and a branch, and
+// configuring with -DEXCAVATION_TRACING=OFF compiles them away entirely
+// event names are kept by pointer, so they have to be string literals
+
+#ifndef EXCAVATION_TRACING
+#define EXCAVATION_TRACING 1
+#endif
+
+using TraceClock = std::chrono::steady_clock;
+
+extern std::atomic<bool> tracingActive;
+
+inline bool tracingEnabled() { return tracingActive.load(std::memory_order_relaxed); }
+
+// starts recording on every thread, naming the calling one "main"
+// prints why and returns false in a build without tracing
+bool startTracing();
+// stops recording and writes everything recorded so far, events of threads still running
+// included
+bool writeTrace(const std::string &path);
+
+// what the trace viewer calls the calling thread, nothing unless tracing has started
+void setTraceThreadName(const std::string &name);
+
+// the recorders behind the macros below, only call these while tracingEnabled()
+void traceBegin(const char *name);
+void traceEnd();
+void traceComplete(const char *name, TraceClock::time_point start, TraceClock::time_point end);
+void traceCounter(const char *name, double value);
+
+// a span from construction to the end of the enclosing scope
+class TraceScope {
+public:
+  explicit TraceScope(const char *name) : active(tracingEnabled()) {
+    if (active) {
+      traceBegin(name);
+    }
+  }
+  ~TraceScope() {
+    if (active) {
+      traceEnd();
+    }
+  }
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+  bool active;
+};
+
+#if EXCAVATION_TRACING
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) const TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+// a span that doesn't fit a scope, every TRACE_BEGIN needs a TRACE_END on the same thread
+#define TRACE_BEGIN(name)                                                                          \
+  do {                                                                                             \
+    if (tracingEnabled()) {                                                                        \
+      traceBegin(name);                                                                            \
+    }                                                                                              \
+  } while (false)
+#define TRACE_END()                                                                                \
+  do {                                                                                             \
+    if (tracingEnabled()) {                                                                        \
+      traceEnd();                                                                                  \
+    }                                                                                              \
+  } while (false)
+// a span already timed by the caller
+#define TRACE_COMPLETE(name, start, end)                                                           \
+  do {                                                                                             \
+    if (tracingEnabled()) {                                                                        \
+      traceComplete(name, start, end);                                                             \
+    }                                                                                              \
+  } while (false)
+#define TRACE_COUNTER(name, value)                                                                 \
+  do {                                                                                             \
+    if (tracingEnabled()) {                                                                        \
+      traceCounter(name, static_cast<double>(value));                                              \
+    }                                                                                              \
+  } while (false)
+#define TRACE_THREAD_NAME(name)                                                                    \
+  do {                                                                                             \
+    if (tracingEnabled()) {                                                                        \
+      setTraceThreadName(name);                                                                    \
+    }                                                                                              \
+  } while (false)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_BEGIN(name) ((void)0)
+#define TRACE_END() ((void)0)
+#define TRACE_COMPLETE(name, start, end) ((void)0)
+#define TRACE_COUNTER(name, value) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
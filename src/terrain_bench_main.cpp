@@ -0,0 +1,38 @@
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "benchmark/kernel_bench.h"
+#include "options.h"
+
+// times the terrain kernels on their own, without the frame loop around them
+// CTest runs it with the default sweep, so every change gets real numbers
+int main(int argc, char **argv) {
+  KernelBenchOptions options;
+  const ParseResult parseResult = parseKernelBenchArguments(argc, argv, options);
+  if (parseResult == ParseResult::ExitSuccess) {
+    return EXIT_SUCCESS;
+  }
+  if (parseResult == ParseResult::ExitFailure) {
+    return EXIT_FAILURE;
+  }
+
+  const std::vector<KernelBenchResult> results = runKernelBenchmarks(options);
+  if (!options.jsonPath.empty() && !writeKernelBenchJson(options.jsonPath, options, results)) {
+    return EXIT_FAILURE;
+  }
+  if (!options.csvPath.empty() && !writeKernelBenchCsv(options.csvPath, options, results)) {
+    return EXIT_FAILURE;
+  }
+
+  // a zero or broken timing means the kernel was optimised away or the clock misbehaved
+  for (const KernelBenchResult &result : results) {
+    if (!std::isfinite(result.medianMs) || result.medianMs <= 0.0) {
+      std::cerr << result.kernel << " (" << result.pattern << ", " << result.gridSize
+                << ") measured no time at all\n";
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}